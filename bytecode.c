@@ -0,0 +1,120 @@
+#include "bytecode.h"
+
+#include <stdbool.h>
+
+#include "intrinsics.h"
+#include "jvm.h"
+
+/**
+ * Reads one 4-byte operand of a switch instruction.
+ *
+ * @param operands the switch's 4-byte-aligned operands
+ * @param index which operand to read
+ * @param quick whether the switch has been quickened, which converts its
+ *   operands to host byte order
+ */
+int32_t read_switch_operand(const u1 *operands, size_t index, bool quick) {
+    if (quick) {
+        return ((const int32_t *) operands)[index];
+    }
+    const u1 *bytes = &operands[4 * index];
+    return (int32_t) ((u4) bytes[0] << 24 | (u4) bytes[1] << 16 | (u4) bytes[2] << 8 |
+                      bytes[3]);
+}
+
+size_t instruction_length(const code_t *code, size_t pc) {
+    u1 opcode = code->code[pc];
+    switch (opcode) {
+        case 0x10:           // bipush
+        case 0x12:           // ldc
+        case 0x15 ... 0x19:  // iload, lload, fload, dload, aload
+        case 0x36 ... 0x3a:  // istore, lstore, fstore, dstore, astore
+        case 0xa9:           // ret
+        case 0xbc:           // newarray
+        case i_ldc_string:
+        case i_newarray_local:
+            return 2;
+        case 0x11:           // sipush
+        case 0x13:           // ldc_w
+        case 0x14:           // ldc2_w
+        case 0x84:           // iinc
+        case 0x99 ... 0xa8:  // if<cond>, if_icmp<cond>, if_acmp<cond>, goto, jsr
+        case 0xb2 ... 0xb8:  // getstatic, putstatic, getfield, putfield, invoke*
+        case 0xbb:           // new
+        case 0xbd:           // anewarray
+        case 0xc0:           // checkcast
+        case 0xc1:           // instanceof
+        case 0xc6:           // ifnull
+        case 0xc7:           // ifnonnull
+        case i_invokestatic_quick:
+        case i_invokestatic_intrinsic:
+        case i_math_abs ... i_integer_leading_zeros:
+        case i_getstatic_quick ... i_println_int:
+        case i_println_string:
+        case i_ldc_w_string:
+        case i_putfield_reference:
+            return 3;
+        case 0xc5:  // multianewarray
+            return 4;
+        case 0xb9:  // invokeinterface
+        case 0xba:  // invokedynamic
+        case 0xc8:  // goto_w
+        case 0xc9:  // jsr_w
+        case i_invokeinterface_quick:
+            return 5;
+        case 0xc4:  // wide
+            return code->code[pc + 1] == i_iinc ? 6 : 4;
+        case i_copy_loop:
+            // It replaced the loop's first instruction, the iload of the index
+            return get_copy_loop(code, pc)->index_load_length;
+        case i_tableswitch:
+        case i_tableswitch_quick:
+        case i_lookupswitch:
+        case i_lookupswitch_quick: {
+            // Operands are padded to start at a multiple of 4 bytes
+            size_t start = (pc + 4) & ~(size_t) 3;
+            const u1 *operands = &code->code[start];
+            bool quick = opcode == i_tableswitch_quick || opcode == i_lookupswitch_quick;
+            if (opcode == i_lookupswitch || opcode == i_lookupswitch_quick) {
+                // default, npairs, then npairs match-offset pairs
+                size_t npairs = read_switch_operand(operands, 1, quick);
+                return start - pc + 8 + 8 * npairs;
+            }
+            // default, low, high, then high - low + 1 offsets
+            int32_t low = read_switch_operand(operands, 1, quick);
+            int32_t high = read_switch_operand(operands, 2, quick);
+            return start - pc + 12 + 4 * (size_t) (high - low + 1);
+        }
+        case 0x00 ... 0x0f:  // nop, aconst_null, <t>const_<n>
+        case 0x1a ... 0x35:  // <t>load_<n>, <t>aload
+        case 0x3b ... 0x83:  // <t>store_<n>, <t>astore, stack and arithmetic
+        case 0x85 ... 0x98:  // conversions and comparisons
+        case 0xac ... 0xb1:  // <t>return, return
+        case 0xbe:           // arraylength
+        case 0xbf:           // athrow
+        case 0xc2:           // monitorenter
+        case 0xc3:           // monitorexit
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+int16_t read_s2_operand(const code_t *code, size_t index) {
+    return (int16_t) (code->code[index] << 8 | code->code[index + 1]);
+}
+
+u2 read_u2_operand(const code_t *code, size_t index) {
+    return (u2) (code->code[index] << 8 | code->code[index + 1]);
+}
+
+void write_u2_operand(code_t *code, size_t index, u2 value) {
+    code->code[index] = value >> 8;
+    code->code[index + 1] = value & 0xff;
+}
+
+int32_t read_s4_operand(const code_t *code, size_t index) {
+    const u1 *bytes = &code->code[index];
+    return (int32_t) ((u4) bytes[0] << 24 | (u4) bytes[1] << 16 | (u4) bytes[2] << 8 |
+                      bytes[3]);
+}
@@ -0,0 +1,56 @@
+#ifndef BYTECODE_H
+#define BYTECODE_H
+
+#include <stddef.h>
+
+#include "class_file.h"
+
+/**
+ * Computes the length of the instruction at the given index of a method's code,
+ * including its opcode and all of its operands.
+ * This works for every instruction in the JVM specification,
+ * even the ones this VM can't execute, so that a method's code can be scanned
+ * from start to end.
+ *
+ * @param code the method's code
+ * @param pc the index of the instruction's opcode
+ * @return the length of the instruction in bytes,
+ *   or 0 if the opcode is not a valid JVM instruction
+ */
+size_t instruction_length(const code_t *code, size_t pc);
+
+/**
+ * Reads a signed 2-byte operand of an instruction, e.g. a branch offset.
+ *
+ * @param code the method's code
+ * @param index the index of the operand's first byte
+ */
+int16_t read_s2_operand(const code_t *code, size_t index);
+
+/**
+ * Reads an unsigned 2-byte operand of an instruction, e.g. a constant pool index.
+ *
+ * @param code the method's code
+ * @param index the index of the operand's first byte
+ */
+u2 read_u2_operand(const code_t *code, size_t index);
+
+/**
+ * Overwrites an unsigned 2-byte operand of an instruction,
+ * e.g. when a quick form replaces a constant pool index with a resolved value.
+ *
+ * @param code the method's code
+ * @param index the index of the operand's first byte
+ * @param value the new operand
+ */
+void write_u2_operand(code_t *code, size_t index, u2 value);
+
+/**
+ * Reads a signed 4-byte operand of an instruction, e.g. a switch offset.
+ *
+ * @param code the method's code
+ * @param index the index of the operand's first byte
+ */
+int32_t read_s4_operand(const code_t *code, size_t index);
+
+#endif /* BYTECODE_H */
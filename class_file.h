@@ -11,6 +11,8 @@
  */
 
 #include <inttypes.h>
+#include <stdbool.h>
+#include <stddef.h>
 
 /* Integer type aliases used in the JVM documentation.
  * You may use these aliases or the corresponding inttypes.h types. */
@@ -42,6 +44,30 @@ typedef struct {
     u4 attribute_length;
 } attribute_info;
 
+/** Bits of the access flags of a class, field, or method */
+typedef enum {
+    IS_PRIVATE = 0x0002,
+    IS_STATIC = 0x0008,
+    IS_NATIVE = 0x0100,
+    IS_INTERFACE = 0x0200,
+    IS_ABSTRACT = 0x0400,
+} access_flag_t;
+
+/** An entry of a method's exception table, i.e. one catch or finally block */
+typedef struct {
+    /** The start (inclusive) of the range of bytecode the handler covers */
+    u2 start_pc;
+    /** The end (exclusive) of the range of bytecode the handler covers */
+    u2 end_pc;
+    /** The index in the bytecode of the handler's first instruction */
+    u2 handler_pc;
+    /**
+     * The constant pool index of the CONSTANT_Class the handler catches
+     * (and its subclasses), or 0 to catch every exception, as for finally
+     */
+    u2 catch_type;
+} exception_handler_t;
+
 /** The JVM's representation of a Java method's code */
 typedef struct {
     /** The maximum number of ints that will be on the operand stack */
@@ -53,8 +79,47 @@ typedef struct {
     /**
      * The method's bytecode, a list of JVM instructions represented as bytes.
      * See the project01 spec for how to interpret these bytes.
+     * This is NULL until the method is first invoked (see `load_method_code()`).
      */
     u1 *code;
+    /** The position of the bytecode in the class file, where it is decoded from */
+    u4 code_offset;
+    /**
+     * The method's exception handlers, in the order they are searched.
+     * Like `code`, these are decoded the first time the method is invoked.
+     */
+    exception_handler_t *exception_table;
+    /** The number of entries in `exception_table` */
+    u2 exception_table_length;
+    /**
+     * The element-copy loops found in the bytecode, which the interpreter runs
+     * as a single array copy (see `copy_loop_t` in intrinsics.h).
+     */
+    struct copy_loop *copy_loops;
+    /** The number of entries in `copy_loops` */
+    u2 copy_loops_count;
+    /**
+     * The allocations of arrays that never leave the method, which are
+     * allocated in the frame (see `local_array_t` in escape.h).
+     */
+    struct local_array *local_arrays;
+    /** The number of entries in `local_arrays` */
+    u2 local_arrays_count;
+    /** The number of ints of a frame's memory the local arrays take up */
+    u2 local_arrays_memory;
+    /**
+     * The allocation site of each instruction that allocates, indexed by pc,
+     * or NULL if no allocating instruction was found (see find_allocation_sites()).
+     * Read through allocation_site(), which gives 0 for a missing site.
+     */
+    u2 *allocation_sites;
+    /**
+     * The inline caches of the method's virtual call sites
+     * (see `inline_cache_t` in dispatch.h), which quickened calls index.
+     */
+    struct inline_cache *inline_caches;
+    /** The number of entries in `inline_caches` */
+    u2 inline_caches_count;
 } code_t;
 
 /** A Java method */
@@ -73,20 +138,44 @@ typedef struct {
      * https://docs.oracle.com/javase/specs/jvms/se12/html/jvms-4.html#jvms-4.3.2.
      */
     char *descriptor;
+    /** The method's access flags, e.g. whether it is static */
+    u2 access_flags;
     /** The method's bytecode (see the comments for `code_t`) */
     code_t code;
+    /** The method's index in the vtables of its class and subclasses, if it is virtual */
+    u2 vtable_index;
+    /** The class that declares the method */
+    struct class_file *class;
 } method_t;
 
+/** A Java field */
+typedef struct {
+    /** The field name, e.g. "count" */
+    char *name;
+    /** The field descriptor, e.g. "I" or "[I", which gives the field's type */
+    char *descriptor;
+    /** The field's access flags, e.g. whether it is static */
+    u2 access_flags;
+    /**
+     * The index of a static field's value in its class's `statics`,
+     * or of an instance field's value in the objects of its class
+     */
+    u2 slot;
+    /** The class that declares the field */
+    struct class_file *class;
+} field_t;
+
 /**
  * Magic numbers the JVM uses to identify the types of constant pool entry.
- * You will only need to handle the CONSTANT_Integer case.
  */
 typedef enum {
     CONSTANT_Utf8 = 1,
     CONSTANT_Integer = 3,
     CONSTANT_Class = 7,
+    CONSTANT_String = 8,
     CONSTANT_Fieldref = 9,
     CONSTANT_Methodref = 10,
+    CONSTANT_InterfaceMethodref = 11,
     CONSTANT_NameAndType = 12
 } cp_tag_t;
 
@@ -94,6 +183,10 @@ typedef struct {
     u2 string_index;
 } CONSTANT_Class_info;
 
+typedef struct {
+    u2 string_index;
+} CONSTANT_String_info;
+
 typedef struct {
     u2 class_index;
     u2 name_and_type_index;
@@ -119,10 +212,33 @@ typedef struct {
      * For example, an integer constant's `info` points to a CONSTANT_Integer_info struct.
      */
     void *info;
+    /**
+     * What the constant resolves to at runtime, or NULL if it hasn't been used yet.
+     * For example, an invoked Methodref resolves to the method_t it calls.
+     */
+    const void *resolved;
 } cp_info;
 
-/** A class file, consisting of an array of constants and an array of methods */
+/** The methods a class implements an interface's methods with */
 typedef struct {
+    /** The interface */
+    const struct class_file *interface;
+    /** The class's method for each of the interface's methods, in vtable order */
+    method_t **methods;
+} itable_t;
+
+/** A class file, consisting of an array of constants and an array of methods */
+typedef struct class_file {
+    /** The internal name of the class, e.g. "Foo" or "java/lang/Object" */
+    char *name;
+    /** The internal name of the class's superclass, or NULL for java/lang/Object */
+    char *super_name;
+    /** The class's access flags, e.g. whether it is an interface */
+    u2 access_flags;
+    /** The internal names of the interfaces the class implements */
+    char **interfaces;
+    /** The number of entries in `interfaces` */
+    u2 interfaces_count;
     /**
      * The class's array of constants.
      * Note that this array is 0-indexed, but the bytecode refers to 1-indexed constants.
@@ -134,6 +250,55 @@ typedef struct {
      * The array is "null-terminated": `methods[length].name == NULL`.
      */
     method_t *methods;
+    /**
+     * The class's fields, in the order they are declared.
+     * The array is "null-terminated": `fields[length].name == NULL`.
+     */
+    field_t *fields;
+    /**
+     * The values of the class's static fields. Every value fits in an int,
+     * since fields hold ints or references (indices into the heap).
+     */
+    int32_t *statics;
+    /** The number of entries in `statics` */
+    u2 statics_count;
+    /** Whether the class's static initializer <clinit> has been run */
+    bool initialized;
+    /** The class's index among the loaded classes, which its objects store */
+    int32_t id;
+    /** The number of ints in an object of the class, including the header */
+    u2 instance_size;
+    /**
+     * The slots of the class's objects that hold references, including inherited
+     * fields, so the garbage collector can follow them
+     */
+    u2 *reference_slots;
+    /** The number of entries in `reference_slots` */
+    u2 reference_slots_count;
+    /**
+     * The methods that calls to virtual methods on the class's objects run,
+     * including inherited ones. An overriding method replaces the method it
+     * overrides, so a method has the same index in all subclasses.
+     */
+    method_t **vtable;
+    /** The number of entries in `vtable` */
+    u2 vtable_size;
+    /**
+     * The class's itables for the interfaces it has been called through so far.
+     * An interface's methods are in the interface's vtable, so calls through the
+     * interface look up the itable for the interface and then index it.
+     */
+    itable_t *itables;
+    /** The number of entries in `itables` */
+    u2 itables_count;
+    /** Whether the class's fields have been laid out and its vtable built */
+    bool linked;
+    /** The contents of the class file, which method bodies are decoded from */
+    const u1 *bytes;
+    /** The number of bytes in the class file */
+    size_t length;
+    /** Whether `bytes` belongs to the class, rather than to a mapped JAR */
+    bool owns_bytes;
 } class_file_t;
 
 #endif /* CLASS_FILE_H */
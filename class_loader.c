@@ -0,0 +1,619 @@
+#include "class_loader.h"
+
+#include <assert.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "escape.h"
+#include "exceptions.h"
+#include "hash.h"
+#include "intrinsics.h"
+#include "jar.h"
+#include "profiler.h"
+#include "read_class.h"
+
+/** The file extension of class files */
+const char CLASS_EXTENSION[] = ".class";
+const size_t CLASS_EXTENSION_LENGTH = sizeof(CLASS_EXTENSION) - 1;
+/** The file extension of JARs */
+const char JAR_EXTENSION[] = ".jar";
+
+/** A directory or JAR to search for class files */
+typedef struct {
+    /** The directory's path, or NULL if this is a JAR */
+    char *directory;
+    /** The opened JAR, or NULL if this is a directory */
+    jar_t *jar;
+} classpath_entry_t;
+
+typedef struct class_loader {
+    /** The directories and JARs to search for class files, in order */
+    classpath_entry_t *classpath;
+    /** The number of entries in the classpath */
+    size_t classpath_count;
+    /**
+     * The loaded classes, in a hash table keyed by class name
+     * that resolves collisions by linear probing. Empty slots are NULL.
+     */
+    class_file_t **classes;
+    /** The number of slots in `classes`, which is always a power of 2 */
+    size_t capacity;
+    /** The number of loaded classes */
+    size_t count;
+    /** The loaded classes, indexed by their ids */
+    class_file_t **by_id;
+} class_loader_t;
+
+/**
+ * Finds the slot of the class table that holds a class,
+ * or the empty slot where it would be inserted.
+ */
+class_file_t **find_slot(class_file_t **classes, size_t capacity, const char *name) {
+    size_t index = hash_bytes(name, strlen(name)) & (capacity - 1);
+    while (classes[index] != NULL && strcmp(classes[index]->name, name) != 0) {
+        index = (index + 1) & (capacity - 1);
+    }
+    return &classes[index];
+}
+
+class_loader_t *class_loader_init() {
+    class_loader_t *loader = malloc(sizeof(*loader));
+    assert(loader != NULL && "Failed to allocate class loader");
+    loader->classpath = NULL;
+    loader->classpath_count = 0;
+    loader->capacity = 16;
+    loader->count = 0;
+    loader->classes = calloc(loader->capacity, sizeof(class_file_t *));
+    assert(loader->classes != NULL && "Failed to allocate class table");
+    loader->by_id = NULL;
+    return loader;
+}
+
+void class_loader_add_path(class_loader_t *loader, const char *classpath) {
+    while (true) {
+        const char *end = strchr(classpath, ':');
+        size_t length = end == NULL ? strlen(classpath) : (size_t) (end - classpath);
+        if (length > 0) {
+            classpath_entry_t entry = {.directory = strndup(classpath, length),
+                                       .jar = NULL};
+            size_t extension_length = sizeof(JAR_EXTENSION) - 1;
+            if (length > extension_length &&
+                strcmp(&entry.directory[length - extension_length], JAR_EXTENSION) == 0) {
+                // Like java, ignore JARs that don't exist
+                entry.jar = jar_open(entry.directory);
+                free(entry.directory);
+                entry.directory = NULL;
+            }
+            if (entry.directory != NULL || entry.jar != NULL) {
+                loader->classpath =
+                    realloc(loader->classpath,
+                            sizeof(classpath_entry_t[loader->classpath_count + 1]));
+                assert(loader->classpath != NULL && "Failed to allocate classpath");
+                loader->classpath[loader->classpath_count] = entry;
+                loader->classpath_count++;
+            }
+        }
+        if (end == NULL) {
+            break;
+        }
+        classpath = end + 1;
+    }
+}
+
+void load_method_code(method_t *method) {
+    if (read_method_code(method)) {
+        find_local_arrays(&method->code);
+        find_allocation_sites(method);
+        find_copy_loops(&method->code);
+    }
+}
+
+/** Decodes all of a class's methods up front, instead of when they're first invoked */
+void prepare_class(class_file_t *class) {
+    for (method_t *method = class->methods; method->name != NULL; method++) {
+        load_method_code(method);
+    }
+}
+
+void class_loader_add(class_loader_t *loader, class_file_t *class) {
+    // Keep the table at most half full so probe sequences stay short
+    if (2 * (loader->count + 1) > loader->capacity) {
+        size_t capacity = 2 * loader->capacity;
+        class_file_t **classes = calloc(capacity, sizeof(class_file_t *));
+        assert(classes != NULL && "Failed to allocate class table");
+        for (size_t i = 0; i < loader->capacity; i++) {
+            if (loader->classes[i] != NULL) {
+                *find_slot(classes, capacity, loader->classes[i]->name) =
+                    loader->classes[i];
+            }
+        }
+        free(loader->classes);
+        loader->classes = classes;
+        loader->capacity = capacity;
+    }
+
+    class_file_t **slot = find_slot(loader->classes, loader->capacity, class->name);
+    assert(*slot == NULL && "Class loaded twice");
+    *slot = class;
+    loader->by_id = realloc(loader->by_id, sizeof(class_file_t *[loader->count + 1]));
+    assert(loader->by_id != NULL && "Failed to allocate class table");
+    class->id = loader->count;
+    loader->by_id[class->id] = class;
+    loader->count++;
+}
+
+class_file_t *get_class_by_id(const class_loader_t *loader, int32_t id) {
+    assert(0 <= id && (size_t) id < loader->count && "Invalid class id");
+    return loader->by_id[id];
+}
+
+/** Checks whether a field holds a reference, i.e. an object or an array */
+bool is_reference_field(const field_t *field) {
+    return field->descriptor[0] == 'L' || field->descriptor[0] == '[';
+}
+
+/**
+ * Lays out a class's instance fields after those of its superclass,
+ * and lists the slots that hold references
+ */
+void layout_instance_fields(class_file_t *class, const class_file_t *super_class) {
+    // An object starts with its header, then the fields of its superclasses
+    u2 size = super_class == NULL ? 1 : super_class->instance_size;
+    u2 inherited_slots = super_class == NULL ? 0 : super_class->reference_slots_count;
+    size_t field_count = 0;
+    while (class->fields[field_count].name != NULL) {
+        field_count++;
+    }
+    class->reference_slots = malloc(sizeof(u2[inherited_slots + field_count + 1]));
+    assert(class->reference_slots != NULL && "Failed to allocate reference slots");
+    if (inherited_slots > 0) {
+        memcpy(class->reference_slots, super_class->reference_slots,
+               sizeof(u2[inherited_slots]));
+    }
+    class->reference_slots_count = inherited_slots;
+    // Group the class's int fields, followed by its reference fields
+    for (int references = 0; references < 2; references++) {
+        for (field_t *field = class->fields; field->name != NULL; field++) {
+            if ((field->access_flags & IS_STATIC) == 0 &&
+                is_reference_field(field) == (references == 1)) {
+                field->slot = size;
+                if (references == 1) {
+                    class->reference_slots[class->reference_slots_count] = size;
+                    class->reference_slots_count++;
+                }
+                size++;
+            }
+        }
+    }
+    class->instance_size = size;
+}
+
+/** Builds a class's vtable by extending its superclass's */
+void build_vtable(class_file_t *class, const class_file_t *super_class) {
+    size_t method_count = 0;
+    while (class->methods[method_count].name != NULL) {
+        method_count++;
+    }
+    size_t inherited = super_class == NULL ? 0 : super_class->vtable_size;
+    class->vtable = malloc(sizeof(method_t *[inherited + method_count + 1]));
+    assert(class->vtable != NULL && "Failed to allocate vtable");
+    if (inherited > 0) {
+        memcpy(class->vtable, super_class->vtable, sizeof(method_t *[inherited]));
+    }
+    class->vtable_size = inherited;
+
+    for (method_t *method = class->methods; method->name != NULL; method++) {
+        // Static and private methods and constructors are never called virtually
+        if ((method->access_flags & (IS_STATIC | IS_PRIVATE)) != 0 ||
+            method->name[0] == '<') {
+            continue;
+        }
+        // An overriding method takes the index of the method it overrides
+        u2 index = 0;
+        while (index < inherited &&
+               (strcmp(class->vtable[index]->name, method->name) != 0 ||
+                strcmp(class->vtable[index]->descriptor, method->descriptor) != 0)) {
+            index++;
+        }
+        if (index == inherited) {
+            index = class->vtable_size;
+            class->vtable_size++;
+        }
+        class->vtable[index] = method;
+        method->vtable_index = index;
+    }
+}
+
+void link_class(class_loader_t *loader, class_file_t *class) {
+    if (class->linked) {
+        return;
+    }
+    class->linked = true;
+    class_file_t *super_class =
+        class->super_name == NULL ? NULL : load_class(loader, class->super_name);
+    // Library superclasses like java/lang/Object have no fields or virtual methods here
+    if (super_class != NULL) {
+        link_class(loader, super_class);
+    }
+    layout_instance_fields(class, super_class);
+    build_vtable(class, super_class);
+}
+
+/**
+ * Parses a class file in a directory.
+ *
+ * @param class set to the parsed class, or NULL if the class file is malformed
+ * @return whether the file could be opened
+ */
+bool read_class_file(const char *path, class_file_t **class) {
+    FILE *class_file = fopen(path, "r");
+    if (class_file == NULL) {
+        return false;
+    }
+    *class = get_class(class_file);
+    int error = fclose(class_file);
+    assert(error == 0 && "Failed to close file");
+    return true;
+}
+
+class_file_t *load_class(class_loader_t *loader, const char *name) {
+    class_file_t *class = *find_slot(loader->classes, loader->capacity, name);
+    if (class != NULL) {
+        return class;
+    }
+
+    // <name>.class, relative to a directory or the root of a JAR
+    size_t file_name_length = strlen(name) + sizeof(CLASS_EXTENSION);
+    char file_name[file_name_length];
+    snprintf(file_name, file_name_length, "%s%s", name, CLASS_EXTENSION);
+    for (size_t i = 0; i < loader->classpath_count; i++) {
+        classpath_entry_t *entry = &loader->classpath[i];
+        if (entry->jar != NULL) {
+            // Parse classes directly out of the mapped archive, or out of
+            // the inflated entries the JAR keeps
+            const u1 *bytes;
+            size_t length;
+            if (!jar_find(entry->jar, file_name, &bytes, &length)) {
+                continue;
+            }
+            class = get_class_in_place(bytes, length);
+        }
+        else {
+            size_t path_length = strlen(entry->directory) + 1 + file_name_length;
+            char path[path_length];
+            snprintf(path, path_length, "%s/%s", entry->directory, file_name);
+            if (!read_class_file(path, &class)) {
+                continue;
+            }
+        }
+        assert(class != NULL && "Malformed class file");
+        assert(strcmp(class->name, name) == 0 && "Class file has the wrong class name");
+        class_loader_add(loader, class);
+        return class;
+    }
+
+    // The VM provides the library's exception classes
+    class = get_builtin_class(name);
+    if (class != NULL) {
+        class_loader_add(loader, class);
+    }
+    return class;
+}
+
+/** A class file on the classpath, which a preload worker parses */
+typedef struct {
+    /** The path of a class file in a directory, or NULL for a class in a JAR */
+    char *path;
+    /** The JAR containing the class, or NULL for a class file in a directory */
+    jar_t *jar;
+    /** The index of the class's entry in `jar` */
+    size_t entry;
+    /** The name the class must have, given where its class file is, e.g. "pkg/Foo" */
+    char *name;
+    /** The parsed class, or NULL if it couldn't be read */
+    class_file_t *class;
+} preload_job_t;
+
+/** The class files for the preload workers to parse, in classpath order */
+typedef struct {
+    preload_job_t *jobs;
+    size_t count;
+    /** The index of the next job that hasn't been taken by a worker */
+    atomic_size_t next;
+} preload_queue_t;
+
+void add_preload_job(preload_queue_t *queue, preload_job_t job) {
+    queue->jobs = realloc(queue->jobs, sizeof(preload_job_t[queue->count + 1]));
+    assert(queue->jobs != NULL && "Failed to allocate preload jobs");
+    queue->jobs[queue->count] = job;
+    queue->count++;
+}
+
+/** Checks whether a name (which need not be null-terminated) ends in ".class" */
+bool is_class_file_name(const char *name, size_t length) {
+    return length > CLASS_EXTENSION_LENGTH &&
+           memcmp(&name[length - CLASS_EXTENSION_LENGTH], CLASS_EXTENSION,
+                  CLASS_EXTENSION_LENGTH) == 0;
+}
+
+/**
+ * Adds a job for every class file in a directory and its subdirectories
+ *
+ * @param directory a directory on the classpath or one of its subdirectories
+ * @param root_length the length of the classpath directory's path,
+ *   which the class file's path relative to it follows
+ */
+void add_directory_jobs(preload_queue_t *queue, const char *directory,
+                        size_t root_length) {
+    DIR *dir = opendir(directory);
+    if (dir == NULL) {
+        return;
+    }
+    struct dirent *file;
+    while ((file = readdir(dir)) != NULL) {
+        if (strcmp(file->d_name, ".") == 0 || strcmp(file->d_name, "..") == 0) {
+            continue;
+        }
+        size_t path_length = strlen(directory) + 1 + strlen(file->d_name) + 1;
+        char *path = malloc(path_length);
+        assert(path != NULL && "Failed to allocate path");
+        snprintf(path, path_length, "%s/%s", directory, file->d_name);
+        struct stat stats;
+        if (stat(path, &stats) == 0 && S_ISDIR(stats.st_mode)) {
+            add_directory_jobs(queue, path, root_length);
+            free(path);
+        }
+        else if (is_class_file_name(path, strlen(path))) {
+            // pkg/Foo.class must hold pkg/Foo
+            const char *file_name = &path[root_length];
+            while (*file_name == '/') {
+                file_name++;
+            }
+            char *name = strndup(file_name, strlen(file_name) - CLASS_EXTENSION_LENGTH);
+            assert(name != NULL && "Failed to allocate class name");
+            add_preload_job(queue, (preload_job_t){.path = path, .name = name});
+        }
+        else {
+            free(path);
+        }
+    }
+    closedir(dir);
+}
+
+/** Adds a job for every class file in a JAR */
+void add_jar_jobs(preload_queue_t *queue, jar_t *jar) {
+    for (size_t entry = 0; entry < jar_entry_count(jar); entry++) {
+        size_t length;
+        const char *name = jar_entry_name(jar, entry, &length);
+        if (is_class_file_name(name, length)) {
+            char *class_name = strndup(name, length - CLASS_EXTENSION_LENGTH);
+            assert(class_name != NULL && "Failed to allocate class name");
+            add_preload_job(queue, (preload_job_t){
+                                       .jar = jar, .entry = entry, .name = class_name});
+        }
+    }
+}
+
+/** Parses and prepares classes from the queue until it is empty */
+void *preload_worker(void *arg) {
+    preload_queue_t *queue = arg;
+    while (true) {
+        size_t index = atomic_fetch_add(&queue->next, 1);
+        if (index >= queue->count) {
+            return NULL;
+        }
+        preload_job_t *job = &queue->jobs[index];
+        if (job->jar != NULL) {
+            const u1 *bytes;
+            size_t length;
+            // Malformed class files are skipped instead of failing on them
+            if (jar_read_entry(job->jar, job->entry, &bytes, &length)) {
+                job->class = get_class_in_place(bytes, length);
+            }
+        }
+        else {
+            read_class_file(job->path, &job->class);
+        }
+        // A class file in the wrong place can't be loaded lazily either
+        if (job->class != NULL && strcmp(job->class->name, job->name) != 0) {
+            free_class(job->class);
+            job->class = NULL;
+        }
+        if (job->class != NULL) {
+            prepare_class(job->class);
+        }
+    }
+}
+
+void class_loader_preload(class_loader_t *loader, size_t threads) {
+    preload_queue_t queue = {.jobs = NULL, .count = 0};
+    atomic_init(&queue.next, 0);
+    for (size_t i = 0; i < loader->classpath_count; i++) {
+        if (loader->classpath[i].jar != NULL) {
+            add_jar_jobs(&queue, loader->classpath[i].jar);
+        }
+        else {
+            const char *directory = loader->classpath[i].directory;
+            add_directory_jobs(&queue, directory, strlen(directory));
+        }
+    }
+
+    // This thread works too, alongside threads - 1 others
+    pthread_t workers[threads > 1 ? threads - 1 : 1];
+    size_t started = 0;
+    for (; started + 1 < threads; started++) {
+        if (pthread_create(&workers[started], NULL, preload_worker, &queue) != 0) {
+            break;
+        }
+    }
+    preload_worker(&queue);
+    for (size_t i = 0; i < started; i++) {
+        pthread_join(workers[i], NULL);
+    }
+
+    /* Publish the classes in classpath order, so that when a class is in
+     * several places, the first one is used, just as when loading lazily. */
+    for (size_t i = 0; i < queue.count; i++) {
+        preload_job_t *job = &queue.jobs[i];
+        if (job->class != NULL) {
+            if (*find_slot(loader->classes, loader->capacity, job->class->name) == NULL) {
+                class_loader_add(loader, job->class);
+            }
+            else {
+                free_class(job->class);
+            }
+        }
+        free(job->path);
+        free(job->name);
+    }
+    free(queue.jobs);
+}
+
+/**
+ * Finds a method declared by one of a class's interfaces or their superinterfaces.
+ *
+ * @param needs_code whether to skip abstract methods, e.g. to find a default method
+ */
+method_t *find_superinterface_method(class_loader_t *loader, const class_file_t *class,
+                                     const char *name, const char *descriptor,
+                                     bool needs_code) {
+    for (u2 i = 0; i < class->interfaces_count; i++) {
+        // Library interfaces aren't on the classpath
+        class_file_t *interface = load_class(loader, class->interfaces[i]);
+        if (interface == NULL) {
+            continue;
+        }
+        method_t *method = find_method(name, descriptor, interface);
+        if (method == NULL || (needs_code && (method->access_flags & IS_ABSTRACT) != 0)) {
+            method = find_superinterface_method(loader, interface, name, descriptor,
+                                                needs_code);
+        }
+        if (method != NULL) {
+            return method;
+        }
+    }
+    return NULL;
+}
+
+method_t *find_inherited_method(class_loader_t *loader, const class_file_t *class,
+                                const char *name, const char *descriptor) {
+    for (const class_file_t *super_class = class; super_class != NULL;) {
+        method_t *method = find_method(name, descriptor, super_class);
+        if (method != NULL) {
+            return method;
+        }
+        // Library superclasses like java/lang/Object aren't on the classpath
+        super_class = super_class->super_name == NULL
+                          ? NULL
+                          : load_class(loader, super_class->super_name);
+    }
+    // Otherwise, the method is declared by an interface
+    for (const class_file_t *super_class = class; super_class != NULL;) {
+        method_t *method =
+            find_superinterface_method(loader, super_class, name, descriptor, false);
+        if (method != NULL) {
+            return method;
+        }
+        super_class = super_class->super_name == NULL
+                          ? NULL
+                          : load_class(loader, super_class->super_name);
+    }
+    return NULL;
+}
+
+field_t *find_inherited_field(class_loader_t *loader, const class_file_t *class,
+                              const char *name, const char *descriptor) {
+    while (class != NULL) {
+        field_t *field = find_field(name, descriptor, class);
+        if (field != NULL) {
+            return field;
+        }
+        // Interfaces can declare static fields
+        for (u2 i = 0; i < class->interfaces_count; i++) {
+            class_file_t *interface = load_class(loader, class->interfaces[i]);
+            if (interface != NULL) {
+                field = find_inherited_field(loader, interface, name, descriptor);
+                if (field != NULL) {
+                    return field;
+                }
+            }
+        }
+        class = class->super_name == NULL ? NULL : load_class(loader, class->super_name);
+    }
+    return NULL;
+}
+
+/** Builds the itable of a class for an interface, which must be linked */
+itable_t *build_itable(class_loader_t *loader, class_file_t *class,
+                       const class_file_t *interface) {
+    class->itables =
+        realloc(class->itables, sizeof(itable_t[class->itables_count + 1]));
+    assert(class->itables != NULL && "Failed to allocate itables");
+    itable_t *itable = &class->itables[class->itables_count];
+    class->itables_count++;
+    itable->interface = interface;
+    itable->methods = malloc(sizeof(method_t *[interface->vtable_size + 1]));
+    assert(itable->methods != NULL && "Failed to allocate itable");
+
+    for (u2 i = 0; i < interface->vtable_size; i++) {
+        const method_t *interface_method = interface->vtable[i];
+        // The class's own or inherited method, or else a default method
+        method_t *method = NULL;
+        for (u2 j = 0; j < class->vtable_size && method == NULL; j++) {
+            method_t *candidate = class->vtable[j];
+            if ((candidate->access_flags & IS_ABSTRACT) == 0 &&
+                strcmp(candidate->name, interface_method->name) == 0 &&
+                strcmp(candidate->descriptor, interface_method->descriptor) == 0) {
+                method = candidate;
+            }
+        }
+        for (const class_file_t *super_class = class;
+             super_class != NULL && method == NULL;) {
+            method = find_superinterface_method(loader, super_class,
+                                                interface_method->name,
+                                                interface_method->descriptor, true);
+            super_class = super_class->super_name == NULL
+                              ? NULL
+                              : load_class(loader, super_class->super_name);
+        }
+        assert(method != NULL && "AbstractMethodError");
+        itable->methods[i] = method;
+    }
+    return itable;
+}
+
+method_t *find_interface_implementation(class_loader_t *loader, class_file_t *class,
+                                        const method_t *interface_method) {
+    const class_file_t *interface = interface_method->class;
+    for (u2 i = 0; i < class->itables_count; i++) {
+        if (class->itables[i].interface == interface) {
+            return class->itables[i].methods[interface_method->vtable_index];
+        }
+    }
+    itable_t *itable = build_itable(loader, class, interface);
+    return itable->methods[interface_method->vtable_index];
+}
+
+void class_loader_free(class_loader_t *loader) {
+    for (size_t i = 0; i < loader->capacity; i++) {
+        if (loader->classes[i] != NULL) {
+            free_class(loader->classes[i]);
+        }
+    }
+    free(loader->classes);
+    free(loader->by_id);
+    for (size_t i = 0; i < loader->classpath_count; i++) {
+        free(loader->classpath[i].directory);
+        if (loader->classpath[i].jar != NULL) {
+            jar_close(loader->classpath[i].jar);
+        }
+    }
+    free(loader->classpath);
+    free(loader);
+}
@@ -0,0 +1,126 @@
+#ifndef CLASS_LOADER_H
+#define CLASS_LOADER_H
+
+#include <stddef.h>
+
+#include "class_file.h"
+
+/**
+ * Finds, parses, and keeps track of the classes a program uses.
+ * Classes are loaded lazily, the first time they are referenced.
+ */
+typedef struct class_loader class_loader_t;
+
+/**
+ * Initializes a class loader with an empty classpath and no loaded classes.
+ */
+class_loader_t *class_loader_init();
+
+/**
+ * Adds directories and JARs to search for class files, after the ones already added.
+ * JARs are opened and indexed immediately.
+ *
+ * @param classpath a list of directories and JARs separated by ':', as for `java -cp`
+ */
+void class_loader_add_path(class_loader_t *loader, const char *classpath);
+
+/**
+ * Adds a class that has already been parsed to the loaded classes.
+ * The loader takes ownership of the class and frees it in class_loader_free().
+ *
+ * @param class the parsed class, which must not already be loaded
+ */
+void class_loader_add(class_loader_t *loader, class_file_t *class);
+
+/**
+ * Finds a loaded class from its id, e.g. the class of an object.
+ *
+ * @param id the class's id, which is assigned when the class is loaded
+ * @return the class
+ */
+class_file_t *get_class_by_id(const class_loader_t *loader, int32_t id);
+
+/**
+ * Links a class, if it hasn't been already, so that it can be instantiated.
+ * This loads and links the class's superclasses, then:
+ * - Assigns the instance fields their offsets in the class's objects.
+ *   Every field takes one int: an object is a header holding its class id,
+ *   then its superclasses' fields, then the class's own int fields,
+ *   then its own reference fields.
+ * - Builds the class's vtable (see `class_file_t`).
+ *
+ * @param class the class, whose `instance_size`, field slots, and vtable are set
+ */
+void link_class(class_loader_t *loader, class_file_t *class);
+
+/**
+ * Prepares a method to run the first time it is invoked,
+ * decoding its bytecode and finding the loops that can run as intrinsics.
+ *
+ * @param method a method of a loaded class
+ */
+void load_method_code(method_t *method);
+
+/**
+ * Finds a class, loading it from the classpath if it hasn't been loaded yet.
+ * Library exception classes that aren't on the classpath are generated
+ * (see `get_builtin_class()`).
+ *
+ * @param name the internal name of the class, e.g. "com/example/Foo"
+ * @return the class, or NULL if it isn't on the classpath or built in
+ */
+class_file_t *load_class(class_loader_t *loader, const char *name);
+
+/**
+ * Loads every class on the classpath up front, instead of lazily.
+ * The classes, including all their method bodies, are parsed on a pool of
+ * threads, then added to the loaded classes, which speeds up starting programs
+ * made of many classes.
+ * Classes that were already loaded are kept.
+ *
+ * @param threads the number of threads to parse classes on, including this one
+ */
+void class_loader_preload(class_loader_t *loader, size_t threads);
+
+/**
+ * Finds a method declared by a class or inherited from one of its superclasses
+ * or interfaces, loading them as needed.
+ *
+ * @param class the class to start searching from
+ * @param name the method name
+ * @param descriptor the method descriptor
+ * @return the method if it was found, NULL otherwise
+ */
+method_t *find_inherited_method(class_loader_t *loader, const class_file_t *class,
+                                const char *name, const char *descriptor);
+
+/**
+ * Finds a field declared by a class or inherited from one of its superclasses
+ * or interfaces, loading them as needed.
+ *
+ * @param class the class to start searching from
+ * @param name the field name
+ * @param descriptor the field descriptor
+ * @return the field if it was found, NULL otherwise
+ */
+field_t *find_inherited_field(class_loader_t *loader, const class_file_t *class,
+                              const char *name, const char *descriptor);
+
+/**
+ * Finds the method a class implements an interface method with.
+ * The first call for each interface builds the class's itable for the interface,
+ * so later calls just find the itable and index it.
+ *
+ * @param class the linked class of the object the method is called on
+ * @param interface_method a method of a linked interface
+ * @return the class's method, or a default method of one of its interfaces
+ */
+method_t *find_interface_implementation(class_loader_t *loader, class_file_t *class,
+                                        const method_t *interface_method);
+
+/**
+ * Frees a class loader and every class it loaded.
+ */
+void class_loader_free(class_loader_t *loader);
+
+#endif /* CLASS_LOADER_H */
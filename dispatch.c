@@ -0,0 +1,90 @@
+#include "dispatch.h"
+
+#include <assert.h>
+#include <inttypes.h>
+#include <stdlib.h>
+
+#include "read_class.h"
+
+/** Counts of how virtual and interface calls were dispatched, for -stats */
+typedef struct {
+    /** Calls at monomorphic sites whose receiver class was cached */
+    uint64_t monomorphic_hits;
+    /** Calls at polymorphic sites whose receiver class was cached */
+    uint64_t polymorphic_hits;
+    /** Calls whose receiver class wasn't cached yet, which added it to the cache */
+    uint64_t misses;
+    /** Calls at megamorphic sites, which look in the vtable or itable */
+    uint64_t megamorphic_calls;
+    /** Lookups of interface methods in itables, on misses and megamorphic calls */
+    uint64_t itable_lookups;
+} dispatch_stats_t;
+
+dispatch_stats_t dispatch_stats = {0};
+
+u2 add_inline_cache(code_t *code, const method_t *callee) {
+    code->inline_caches = realloc(code->inline_caches,
+                                  sizeof(inline_cache_t[code->inline_caches_count + 1]));
+    assert(code->inline_caches != NULL && "Failed to allocate inline cache");
+    inline_cache_t *cache = &code->inline_caches[code->inline_caches_count];
+    cache->parameters = get_number_of_parameters(callee);
+    cache->vtable_index = callee->vtable_index;
+    cache->interface_method =
+        (callee->class->access_flags & IS_INTERFACE) != 0 ? callee : NULL;
+    cache->megamorphic = false;
+    cache->count = 0;
+    return code->inline_caches_count++;
+}
+
+/** Finds the method a call runs without using the cache */
+method_t *find_target(class_loader_t *loader, const inline_cache_t *cache,
+                      class_file_t *receiver_class) {
+    if (cache->interface_method != NULL) {
+        dispatch_stats.itable_lookups++;
+        return find_interface_implementation(loader, receiver_class,
+                                             cache->interface_method);
+    }
+    assert(cache->vtable_index < receiver_class->vtable_size && "Invalid vtable index");
+    return receiver_class->vtable[cache->vtable_index];
+}
+
+method_t *dispatch_method(class_loader_t *loader, inline_cache_t *cache,
+                          class_file_t *receiver_class) {
+    if (cache->megamorphic) {
+        dispatch_stats.megamorphic_calls++;
+        return find_target(loader, cache, receiver_class);
+    }
+    for (u2 i = 0; i < cache->count; i++) {
+        if (cache->class_ids[i] == receiver_class->id) {
+            if (cache->count == 1) {
+                dispatch_stats.monomorphic_hits++;
+            }
+            else {
+                dispatch_stats.polymorphic_hits++;
+            }
+            return cache->methods[i];
+        }
+    }
+
+    dispatch_stats.misses++;
+    method_t *method = find_target(loader, cache, receiver_class);
+    if (cache->count < POLYMORPHIC_LIMIT) {
+        cache->class_ids[cache->count] = receiver_class->id;
+        cache->methods[cache->count] = method;
+        cache->count++;
+    }
+    else {
+        cache->megamorphic = true;
+    }
+    return method;
+}
+
+void print_dispatch_stats(FILE *stream) {
+    fprintf(stream, "inline cache monomorphic hits: %" PRIu64 "\n",
+            dispatch_stats.monomorphic_hits);
+    fprintf(stream, "inline cache polymorphic hits: %" PRIu64 "\n",
+            dispatch_stats.polymorphic_hits);
+    fprintf(stream, "inline cache misses: %" PRIu64 "\n", dispatch_stats.misses);
+    fprintf(stream, "megamorphic calls: %" PRIu64 "\n", dispatch_stats.megamorphic_calls);
+    fprintf(stream, "itable lookups: %" PRIu64 "\n", dispatch_stats.itable_lookups);
+}
@@ -0,0 +1,65 @@
+#ifndef DISPATCH_H
+#define DISPATCH_H
+
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "class_file.h"
+#include "class_loader.h"
+
+/** The most receiver classes an inline cache remembers before it goes megamorphic */
+#define POLYMORPHIC_LIMIT 4
+
+/**
+ * The inline cache of a virtual or interface call site, which remembers the
+ * method that each receiver class it has seen dispatched to. A site that sees
+ * one class is monomorphic; one that sees up to POLYMORPHIC_LIMIT is polymorphic.
+ * Past that, it is megamorphic and looks in the receiver's vtable or itable
+ * on every call.
+ */
+typedef struct inline_cache {
+    /** The number of parameters the method takes, not counting the receiver */
+    u2 parameters;
+    /** The called method's index in the receiver's vtable, for a virtual call */
+    u2 vtable_index;
+    /** The called interface method, or NULL for a virtual call */
+    const method_t *interface_method;
+    /** Whether the site has seen more than POLYMORPHIC_LIMIT receiver classes */
+    bool megamorphic;
+    /** The number of receiver classes in the cache */
+    u2 count;
+    /** The ids of the receiver classes in the cache */
+    int32_t class_ids[POLYMORPHIC_LIMIT];
+    /** The method that each receiver class dispatched to */
+    method_t *methods[POLYMORPHIC_LIMIT];
+} inline_cache_t;
+
+/**
+ * Adds an empty inline cache to a method for one of its call sites.
+ *
+ * @param code the calling method's code
+ * @param callee the method the call site names, which must be in the vtable of
+ *   its linked class. The call is an interface call if the class is an interface.
+ * @return the index of the new cache in `code->inline_caches`
+ */
+u2 add_inline_cache(code_t *code, const method_t *callee);
+
+/**
+ * Finds the method a virtual or interface call runs,
+ * using and updating the site's cache.
+ *
+ * @param cache the call site's inline cache
+ * @param receiver_class the class of the object the method is called on
+ * @return the method to run
+ */
+method_t *dispatch_method(class_loader_t *loader, inline_cache_t *cache,
+                          class_file_t *receiver_class);
+
+/**
+ * Prints how often calls hit their inline caches.
+ *
+ * @param stream the stream to print to, e.g. stderr
+ */
+void print_dispatch_stats(FILE *stream);
+
+#endif /* DISPATCH_H */
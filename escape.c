@@ -0,0 +1,321 @@
+#include "escape.h"
+
+#include <assert.h>
+#include <stdlib.h>
+
+#include "bytecode.h"
+#include "jvm.h"
+
+/** The most operand stack entries a simulation tracks */
+#define MAX_SIMULATED_STACK 32
+
+/** What a simulation knows about an operand stack entry */
+typedef struct {
+    /** Whether the entry is the array being followed */
+    bool array;
+    /** Whether the entry is a known int, and which */
+    bool constant;
+    int32_t value;
+} stack_entry_t;
+
+/** Where a simulation starts following an array */
+typedef enum {
+    /** At its allocation, until it is stored in a local variable */
+    FROM_ALLOCATION,
+    /** At a load of the local variable it is stored in */
+    FROM_LOAD,
+} simulation_kind_t;
+
+/**
+ * Gets the int an instruction pushes, if it is a constant.
+ *
+ * @return whether the instruction pushes a constant
+ */
+bool read_constant(const code_t *code, size_t pc, int32_t *value) {
+    u1 opcode = code->code[pc];
+    if (i_iconst_m1 <= opcode && opcode <= i_iconst_5) {
+        *value = (int32_t) opcode - i_iconst_0;
+        return true;
+    }
+    if (opcode == i_bipush) {
+        *value = (int8_t) code->code[pc + 1];
+        return true;
+    }
+    if (opcode == i_sipush) {
+        *value = read_s2_operand(code, pc + 1);
+        return true;
+    }
+    return false;
+}
+
+/**
+ * Gets the local variable an aload or astore instruction uses.
+ *
+ * @return the local variable, or -1 if the instruction is neither
+ */
+int32_t reference_local(const code_t *code, size_t pc) {
+    u1 opcode = code->code[pc];
+    if (opcode == i_aload || opcode == i_astore) {
+        return code->code[pc + 1];
+    }
+    if (i_aload_0 <= opcode && opcode <= i_aload_3) {
+        return opcode - i_aload_0;
+    }
+    if (i_astore_0 <= opcode && opcode <= i_astore_3) {
+        return opcode - i_astore_0;
+    }
+    return -1;
+}
+
+/**
+ * Gets how many entries an instruction pops and pushes, for the instructions
+ * a followed array may be on the operand stack across.
+ *
+ * @param allocating whether the array is still being allocated, in which case
+ *   only instructions that can't throw are allowed, and no local variable can
+ *   be loaded, since the array's may still hold the array the allocation made
+ *   the last time it ran
+ * @return whether the instruction is allowed
+ */
+bool stack_effect(const code_t *code, size_t pc, bool allocating, u1 *pops, u1 *pushes) {
+    *pops = 0;
+    *pushes = 0;
+    switch (code->code[pc]) {
+        case i_nop:
+        case i_iinc:
+            return true;
+        case i_aconst_null:
+        case i_iconst_m1 ... i_iconst_5:
+        case i_bipush:
+        case i_sipush:
+        case i_ldc:
+        case i_ldc_w:
+        case i_iload:
+        case i_iload_0 ... i_iload_3:
+            *pushes = 1;
+            return true;
+        case i_aload:
+        case i_aload_0 ... i_aload_3:
+            *pushes = 1;
+            return !allocating;
+        case i_dup:
+            *pops = 1;
+            *pushes = 2;
+            return true;
+        case i_pop:
+        case i_istore:
+        case i_istore_0 ... i_istore_3:
+        case i_astore:
+        case i_astore_0 ... i_astore_3:
+            *pops = 1;
+            return true;
+        case i_iadd:
+        case i_isub:
+        case i_imul:
+        case i_ishl:
+        case i_ishr:
+        case i_iushr:
+        case i_iand:
+        case i_ior:
+        case i_ixor:
+            *pops = 2;
+            *pushes = 1;
+            return true;
+        case i_ineg:
+        case i_arraylength:
+            *pops = 1;
+            *pushes = 1;
+            return true;
+        case i_idiv:
+        case i_irem:
+        case i_iaload:
+            *pops = 2;
+            *pushes = 1;
+            return !allocating;
+        case i_iastore:
+            *pops = 3;
+            return true;
+        default:
+            return false;
+    }
+}
+
+/**
+ * Checks whether an instruction may pop the followed array from a position.
+ *
+ * @param depth how far from the top of the operand stack the array is,
+ *   e.g. 0 for the top
+ * @param array_local the local variable the array may be stored in,
+ *   or -1 if it hasn't been decided yet, in which case it is set
+ */
+bool may_pop_array(const code_t *code, size_t pc, size_t depth, int32_t *array_local) {
+    switch (code->code[pc]) {
+        case i_dup:
+        case i_pop:
+        case i_arraylength:
+            return depth == 0;
+        case i_iaload:
+            return depth == 1;
+        case i_iastore:
+            return depth == 2;
+        case i_astore:
+        case i_astore_0 ... i_astore_3: {
+            int32_t local = reference_local(code, pc);
+            if (*array_local == -1) {
+                *array_local = local;
+            }
+            return depth == 0 && local == *array_local;
+        }
+        default:
+            return false;
+    }
+}
+
+/**
+ * Follows an array through straight-line code, from where it is pushed onto
+ * the operand stack until it is popped, checking that it doesn't escape.
+ *
+ * @param pc the index of the instruction after the one that pushes the array
+ * @param kind whether the array was just allocated or loaded from a local
+ * @param length the array's length, if it was just allocated
+ * @param array_local the local variable the array is stored in, or -1 if it
+ *   was just allocated, in which case it is set if the array is stored
+ * @return whether the array stays in the method
+ */
+bool follow_array(const code_t *code, size_t pc, simulation_kind_t kind, int32_t length,
+                  int32_t *array_local) {
+    bool allocating = kind == FROM_ALLOCATION;
+    stack_entry_t stack[MAX_SIMULATED_STACK];
+    // Entries below the array aren't known, but the array is never below them
+    size_t depth = 1;
+    size_t arrays = 1;
+    stack[0] = (stack_entry_t){.array = true, .constant = false};
+    while (arrays > 0) {
+        u1 pops;
+        u1 pushes;
+        if (pc >= code->code_length ||
+            !stack_effect(code, pc, allocating, &pops, &pushes) ||
+            depth - (pops < depth ? pops : depth) + pushes > MAX_SIMULATED_STACK) {
+            return false;
+        }
+        stack_entry_t popped = stack[depth - 1];
+        for (size_t i = 0; i < pops && i < depth; i++) {
+            if (stack[depth - 1 - i].array && !may_pop_array(code, pc, i, array_local)) {
+                return false;
+            }
+        }
+        if (allocating && code->code[pc] == i_iastore && depth >= 3 &&
+            stack[depth - 3].array) {
+            // The element stored into must be in bounds, so the store can't throw
+            const stack_entry_t *index = &stack[depth - 2];
+            if (!index->constant || index->value < 0 || index->value >= length) {
+                return false;
+            }
+        }
+        for (size_t i = 0; i < pops && depth > 0; i++) {
+            depth--;
+            if (stack[depth].array) {
+                arrays--;
+            }
+        }
+        stack_entry_t pushed = {.array = false, .constant = false};
+        if (read_constant(code, pc, &pushed.value)) {
+            pushed.constant = true;
+        }
+        for (u1 i = 0; i < pushes; i++) {
+            // Only dup pushes more than one entry, which are copies of the popped one
+            stack[depth] = pushes == 2 ? popped : pushed;
+            if (stack[depth].array) {
+                arrays++;
+            }
+            depth++;
+        }
+        pc += instruction_length(code, pc);
+    }
+    return true;
+}
+
+/**
+ * Checks whether every load of a local variable only uses the array in it
+ * in the method, as follow_array() checks.
+ */
+bool local_stays_in_method(const code_t *code, int32_t local) {
+    for (size_t pc = 0; pc < code->code_length; pc += instruction_length(code, pc)) {
+        u1 opcode = code->code[pc];
+        bool load = opcode == i_aload || (i_aload_0 <= opcode && opcode <= i_aload_3);
+        if (load && reference_local(code, pc) == local &&
+            !follow_array(code, pc + instruction_length(code, pc), FROM_LOAD, 0,
+                          &local)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void find_local_arrays(code_t *code) {
+    // Make sure every instruction is known, so the code can be scanned.
+    // wide can load a local variable with a 2-byte index, which isn't followed.
+    for (size_t pc = 0; pc < code->code_length;) {
+        size_t length = instruction_length(code, pc);
+        if (length == 0 || code->code[pc] == 0xc4) {
+            return;
+        }
+        pc += length;
+    }
+
+    size_t memory = 0;
+    size_t previous = 0;
+    for (size_t pc = 0; pc < code->code_length;
+         previous = pc, pc += instruction_length(code, pc)) {
+        int32_t length;
+        if (code->code[pc] != i_newarray || pc == 0 ||
+            !read_constant(code, previous, &length) || length < 0 ||
+            length > MAX_LOCAL_ARRAY_LENGTH ||
+            code->local_arrays_count == UINT8_MAX + 1) {
+            continue;
+        }
+        int32_t local = -1;
+        if (!follow_array(code, pc + 2, FROM_ALLOCATION, length, &local) ||
+            (local != -1 && !local_stays_in_method(code, local))) {
+            continue;
+        }
+        size_t size = heap_array_memory_size(length);
+        if (memory + size > UINT16_MAX) {
+            continue;
+        }
+        code->local_arrays = realloc(code->local_arrays,
+                                     sizeof(local_array_t[code->local_arrays_count + 1]));
+        assert(code->local_arrays != NULL && "Failed to allocate local arrays");
+        code->local_arrays[code->local_arrays_count] =
+            (local_array_t){.length = length, .offset = memory};
+        memory += size;
+        // The operand is the allocation's index
+        code->code[pc] = i_newarray_local;
+        code->code[pc + 1] = code->local_arrays_count;
+        code->local_arrays_count++;
+    }
+    code->local_arrays_memory = memory;
+}
+
+size_t local_arrays_size(const code_t *code) {
+    return code->local_arrays_count + code->local_arrays_memory;
+}
+
+int32_t new_local_array(heap_t *heap, const code_t *code, u1 index, int32_t *memory) {
+    if (memory[index] != NULL_REFERENCE) {
+        heap_free_array_in(heap, memory[index]);
+    }
+    // The arrays' memory follows their references
+    const local_array_t *array = &code->local_arrays[index];
+    int32_t *array_memory = &memory[code->local_arrays_count + array->offset];
+    memory[index] = heap_new_array_in(heap, array_memory, array->length);
+    return memory[index];
+}
+
+void free_local_arrays(heap_t *heap, const code_t *code, int32_t *memory) {
+    for (u2 i = 0; i < code->local_arrays_count; i++) {
+        if (memory[i] != NULL_REFERENCE) {
+            heap_free_array_in(heap, memory[i]);
+        }
+    }
+}
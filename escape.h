@@ -0,0 +1,64 @@
+#ifndef ESCAPE_H
+#define ESCAPE_H
+
+#include <stdbool.h>
+
+#include "class_file.h"
+#include "heap.h"
+
+/** The longest array that is allocated in its method's frame */
+#define MAX_LOCAL_ARRAY_LENGTH 64
+
+/**
+ * An allocation of a small int array of constant length that never leaves its
+ * method: the array is only ever stored in one local variable, and the only
+ * things done with it are loading and storing its elements and getting its
+ * length. Such an array is allocated in memory that belongs to the method's
+ * frame instead of in the heap's spaces, so it never makes the young
+ * generation fill up. The allocation's newarray is rewritten to
+ * i_newarray_local, whose operand is the allocation's index in the method's
+ * `local_arrays`.
+ */
+typedef struct local_array {
+    /** The length of the array */
+    int32_t length;
+    /** The offset of the array's memory in the frame's memory for local arrays */
+    u2 offset;
+} local_array_t;
+
+/**
+ * Finds the allocations of arrays that don't escape a method's frame and
+ * rewrites their newarray instructions to i_newarray_local.
+ * Must be called before the method runs, and before find_copy_loops().
+ *
+ * @param code the method's code, which is updated with the allocations found
+ */
+void find_local_arrays(code_t *code);
+
+/**
+ * Gets the number of ints of memory a frame of a method needs for its local
+ * arrays, including their references (see new_local_array()).
+ */
+size_t local_arrays_size(const code_t *code);
+
+/**
+ * Allocates a local array in a frame's memory for local arrays. If the
+ * allocation has run before in the same frame, the array it allocated then is
+ * freed, since it can't be used anymore: the new array is about to replace it
+ * in the only local variable that held it.
+ *
+ * @param code the code of the frame's method
+ * @param index the allocation's index in the method's `local_arrays`
+ * @param memory the frame's memory for local arrays, which starts with the
+ *   reference to each allocation's array, so they can be roots of the frame
+ * @return a reference to the new array, whose elements are all 0
+ */
+int32_t new_local_array(heap_t *heap, const code_t *code, u1 index, int32_t *memory);
+
+/**
+ * Frees the arrays a frame allocated in its memory for local arrays,
+ * when the frame returns.
+ */
+void free_local_arrays(heap_t *heap, const code_t *code, int32_t *memory);
+
+#endif /* ESCAPE_H */
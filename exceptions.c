@@ -0,0 +1,317 @@
+#include "exceptions.h"
+
+#include <assert.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "jvm.h"
+#include "read_class.h"
+#include "string_table.h"
+
+/** The root of the exception classes, which declares their members */
+const char THROWABLE_CLASS[] = "java/lang/Throwable";
+/** The name and descriptor of Throwable's message field */
+const char MESSAGE_FIELD[] = "message";
+const char MESSAGE_DESCRIPTOR[] = "Ljava/lang/String;";
+
+const char ARITHMETIC_EXCEPTION[] = "java/lang/ArithmeticException";
+const char ARRAY_INDEX_EXCEPTION[] = "java/lang/ArrayIndexOutOfBoundsException";
+const char ARRAY_STORE_EXCEPTION[] = "java/lang/ArrayStoreException";
+const char ILLEGAL_ARGUMENT_EXCEPTION[] = "java/lang/IllegalArgumentException";
+const char NEGATIVE_ARRAY_SIZE_EXCEPTION[] = "java/lang/NegativeArraySizeException";
+const char NULL_POINTER_EXCEPTION[] = "java/lang/NullPointerException";
+const char OUT_OF_MEMORY_ERROR[] = "java/lang/OutOfMemoryError";
+
+/** A library exception class the VM provides */
+typedef struct {
+    /** The internal name of the class */
+    const char *name;
+    /** The internal name of the class's superclass */
+    const char *super_name;
+} builtin_class_t;
+
+const builtin_class_t BUILTIN_CLASSES[] = {
+    {"java/lang/Throwable", "java/lang/Object"},
+    {"java/lang/Exception", "java/lang/Throwable"},
+    {"java/lang/Error", "java/lang/Throwable"},
+    {"java/lang/VirtualMachineError", "java/lang/Error"},
+    {"java/lang/OutOfMemoryError", "java/lang/VirtualMachineError"},
+    {"java/lang/RuntimeException", "java/lang/Exception"},
+    {"java/lang/ArithmeticException", "java/lang/RuntimeException"},
+    {"java/lang/IndexOutOfBoundsException", "java/lang/RuntimeException"},
+    {"java/lang/ArrayIndexOutOfBoundsException", "java/lang/IndexOutOfBoundsException"},
+    {"java/lang/ArrayStoreException", "java/lang/RuntimeException"},
+    {"java/lang/NegativeArraySizeException", "java/lang/RuntimeException"},
+    {"java/lang/NullPointerException", "java/lang/RuntimeException"},
+    {"java/lang/IllegalArgumentException", "java/lang/RuntimeException"},
+    {"java/lang/IllegalStateException", "java/lang/RuntimeException"},
+    {"java/lang/UnsupportedOperationException", "java/lang/RuntimeException"},
+    {NULL, NULL},
+};
+
+/** A class file being generated, which grows as bytes are appended */
+typedef struct {
+    u1 *bytes;
+    size_t length;
+    size_t capacity;
+} class_writer_t;
+
+void write_u1(class_writer_t *writer, u1 value) {
+    if (writer->length == writer->capacity) {
+        writer->capacity = writer->capacity == 0 ? 256 : 2 * writer->capacity;
+        writer->bytes = realloc(writer->bytes, writer->capacity);
+        assert(writer->bytes != NULL && "Failed to allocate class file");
+    }
+    writer->bytes[writer->length] = value;
+    writer->length++;
+}
+void write_u2(class_writer_t *writer, u2 value) {
+    write_u1(writer, value >> 8);
+    write_u1(writer, value & 0xFF);
+}
+void write_u4(class_writer_t *writer, u4 value) {
+    write_u2(writer, value >> 16);
+    write_u2(writer, value & 0xFFFF);
+}
+
+/** Writes a CONSTANT_Utf8 */
+void write_utf8(class_writer_t *writer, const char *string) {
+    size_t length = strlen(string);
+    write_u1(writer, CONSTANT_Utf8);
+    write_u2(writer, length);
+    for (size_t i = 0; i < length; i++) {
+        write_u1(writer, string[i]);
+    }
+}
+
+/*
+ * The constant pool of a generated class. Only Throwable uses the constants
+ * after its superclass, since its subclasses declare no members.
+ */
+enum {
+    NAME_UTF8 = 1,
+    THIS_CLASS,
+    SUPER_NAME_UTF8,
+    SUPER_CLASS,
+    CODE_UTF8,
+    MESSAGE_UTF8,
+    MESSAGE_DESCRIPTOR_UTF8,
+    MESSAGE_NAME_AND_TYPE,
+    MESSAGE_FIELDREF,
+    INIT_UTF8,
+    INIT_DESCRIPTOR_UTF8,
+    INIT_MESSAGE_DESCRIPTOR_UTF8,
+    GET_MESSAGE_UTF8,
+    GET_MESSAGE_DESCRIPTOR_UTF8,
+    CONSTANT_POOL_COUNT
+};
+
+/** Writes a method with a Code attribute that has no exception handlers */
+void write_method(class_writer_t *writer, u2 name_index, u2 descriptor_index,
+                  u2 max_stack, u2 max_locals, const u1 *code, u4 code_length) {
+    write_u2(writer, 0x0001); // ACC_PUBLIC
+    write_u2(writer, name_index);
+    write_u2(writer, descriptor_index);
+    write_u2(writer, 1);
+    write_u2(writer, CODE_UTF8);
+    write_u4(writer, 2 + 2 + 4 + code_length + 2 + 2);
+    write_u2(writer, max_stack);
+    write_u2(writer, max_locals);
+    write_u4(writer, code_length);
+    for (u4 i = 0; i < code_length; i++) {
+        write_u1(writer, code[i]);
+    }
+    write_u2(writer, 0); // exception_table_length
+    write_u2(writer, 0); // attributes_count
+}
+
+/** Writes Throwable's message field, constructors, and getMessage() */
+void write_throwable_members(class_writer_t *writer) {
+    write_u2(writer, 1);
+    write_u2(writer, IS_PRIVATE);
+    write_u2(writer, MESSAGE_UTF8);
+    write_u2(writer, MESSAGE_DESCRIPTOR_UTF8);
+    write_u2(writer, 0);
+
+    write_u2(writer, 3);
+    // Throwable() leaves the message null
+    const u1 init[] = {i_return};
+    write_method(writer, INIT_UTF8, INIT_DESCRIPTOR_UTF8, 0, 1, init, sizeof(init));
+    // Throwable(String message)
+    const u1 init_message[] = {
+        i_aload_0, i_aload_1, i_putfield, 0, MESSAGE_FIELDREF, i_return,
+    };
+    write_method(writer, INIT_UTF8, INIT_MESSAGE_DESCRIPTOR_UTF8, 2, 2, init_message,
+                 sizeof(init_message));
+    // String getMessage()
+    const u1 get_message[] = {i_aload_0, i_getfield, 0, MESSAGE_FIELDREF, i_areturn};
+    write_method(writer, GET_MESSAGE_UTF8, GET_MESSAGE_DESCRIPTOR_UTF8, 1, 1,
+                 get_message, sizeof(get_message));
+}
+
+class_file_t *get_builtin_class(const char *name) {
+    const builtin_class_t *builtin = BUILTIN_CLASSES;
+    while (builtin->name != NULL && strcmp(builtin->name, name) != 0) {
+        builtin++;
+    }
+    if (builtin->name == NULL) {
+        return NULL;
+    }
+    bool is_throwable = strcmp(name, THROWABLE_CLASS) == 0;
+
+    class_writer_t writer = {.bytes = NULL, .length = 0, .capacity = 0};
+    write_u4(&writer, 0xCAFEBABE);
+    write_u2(&writer, 0);  // minor_version
+    write_u2(&writer, 52); // major_version
+
+    write_u2(&writer, is_throwable ? CONSTANT_POOL_COUNT : SUPER_CLASS + 1);
+    write_utf8(&writer, builtin->name);
+    write_u1(&writer, CONSTANT_Class);
+    write_u2(&writer, NAME_UTF8);
+    write_utf8(&writer, builtin->super_name);
+    write_u1(&writer, CONSTANT_Class);
+    write_u2(&writer, SUPER_NAME_UTF8);
+    if (is_throwable) {
+        write_utf8(&writer, "Code");
+        write_utf8(&writer, MESSAGE_FIELD);
+        write_utf8(&writer, MESSAGE_DESCRIPTOR);
+        write_u1(&writer, CONSTANT_NameAndType);
+        write_u2(&writer, MESSAGE_UTF8);
+        write_u2(&writer, MESSAGE_DESCRIPTOR_UTF8);
+        write_u1(&writer, CONSTANT_Fieldref);
+        write_u2(&writer, THIS_CLASS);
+        write_u2(&writer, MESSAGE_NAME_AND_TYPE);
+        write_utf8(&writer, "<init>");
+        write_utf8(&writer, "()V");
+        write_utf8(&writer, "(Ljava/lang/String;)V");
+        write_utf8(&writer, "getMessage");
+        write_utf8(&writer, "()Ljava/lang/String;");
+    }
+
+    write_u2(&writer, 0x0021); // ACC_PUBLIC | ACC_SUPER
+    write_u2(&writer, THIS_CLASS);
+    write_u2(&writer, SUPER_CLASS);
+    write_u2(&writer, 0); // interfaces_count
+    if (is_throwable) {
+        write_throwable_members(&writer);
+    }
+    else {
+        write_u2(&writer, 0); // fields_count
+        write_u2(&writer, 0); // methods_count
+    }
+    write_u2(&writer, 0); // attributes_count
+
+    class_file_t *class = get_class_from_bytes(writer.bytes, writer.length);
+    assert(class != NULL && "Malformed builtin class");
+    free(writer.bytes);
+    return class;
+}
+
+int32_t new_exception(class_loader_t *loader, heap_t *heap, const char *class_name,
+                      const char *message) {
+    class_file_t *class = load_class(loader, class_name);
+    assert(class != NULL && "Class not found");
+    link_class(loader, class);
+    if (message == NULL) {
+        int32_t exception = heap_new_object(heap, class->id, class->instance_size);
+        assert(exception != NULL_REFERENCE && "Out of memory");
+        return exception;
+    }
+    // Keep the message alive while the exception is allocated
+    int32_t message_string = new_string(heap, message);
+    heap_push_roots(heap, &message_string, 1);
+    int32_t exception = heap_new_object(heap, class->id, class->instance_size);
+    heap_pop_roots(heap, 1);
+    // There is no room left even to throw an OutOfMemoryError
+    assert(exception != NULL_REFERENCE && "Out of memory");
+    const field_t *field = find_field(MESSAGE_FIELD, MESSAGE_DESCRIPTOR,
+                                      load_class(loader, THROWABLE_CLASS));
+    heap_store_reference(heap, exception, field->slot, message_string);
+    return exception;
+}
+
+int32_t check_array_index(class_loader_t *loader, heap_t *heap, int32_t array,
+                          int32_t index) {
+    if (array == NULL_REFERENCE) {
+        return new_exception(loader, heap, NULL_POINTER_EXCEPTION, NULL);
+    }
+    int32_t length = heap_get(heap, array)[0];
+    // Unsigned arithmetic checks both 0 <= index and index < length
+    if ((uint32_t) index < (uint32_t) length) {
+        return NULL_REFERENCE;
+    }
+    char message[64];
+    snprintf(message, sizeof(message),
+             "Index %" PRId32 " out of bounds for length %" PRId32, index, length);
+    return new_exception(loader, heap, ARRAY_INDEX_EXCEPTION, message);
+}
+
+int32_t check_array_length(class_loader_t *loader, heap_t *heap, int32_t length) {
+    if (length >= 0) {
+        return NULL_REFERENCE;
+    }
+    char message[16];
+    snprintf(message, sizeof(message), "%" PRId32, length);
+    return new_exception(loader, heap, NEGATIVE_ARRAY_SIZE_EXCEPTION, message);
+}
+
+int32_t check_allocation(class_loader_t *loader, heap_t *heap, int32_t ref) {
+    if (ref != NULL_REFERENCE) {
+        return NULL_REFERENCE;
+    }
+    return new_exception(loader, heap, OUT_OF_MEMORY_ERROR, "Java heap space");
+}
+
+/** Checks whether a class is the class with the given name or one of its subclasses */
+bool is_subclass(class_loader_t *loader, const class_file_t *class, const char *name) {
+    while (class != NULL) {
+        if (strcmp(class->name, name) == 0) {
+            return true;
+        }
+        class = class->super_name == NULL ? NULL : load_class(loader, class->super_name);
+    }
+    return false;
+}
+
+bool find_exception_handler(class_loader_t *loader, class_file_t *class,
+                            const code_t *code, size_t *pc,
+                            const class_file_t *exception_class) {
+    for (u2 i = 0; i < code->exception_table_length; i++) {
+        const exception_handler_t *handler = &code->exception_table[i];
+        if (*pc < handler->start_pc || *pc >= handler->end_pc) {
+            continue;
+        }
+        // The catch type is compared by name, so it doesn't need to be loaded
+        if (handler->catch_type == 0 ||
+            is_subclass(loader, exception_class,
+                        get_class_name(class->constant_pool, handler->catch_type))) {
+            *pc = handler->handler_pc;
+            return true;
+        }
+    }
+    return false;
+}
+
+void print_uncaught_exception(FILE *stream, class_loader_t *loader, heap_t *heap,
+                              int32_t exception) {
+    const int32_t *object = heap_get(heap, exception);
+    const class_file_t *class = get_class_by_id(loader, object[0]);
+    // Keep the report after whatever the program printed before it
+    fflush(stdout);
+    fputs("Exception in thread \"main\" ", stream);
+    for (const char *c = class->name; *c != '\0'; c++) {
+        fputc(*c == '/' ? '.' : *c, stream);
+    }
+    const class_file_t *throwable = load_class(loader, THROWABLE_CLASS);
+    const field_t *field = throwable == NULL
+                               ? NULL
+                               : find_field(MESSAGE_FIELD, MESSAGE_DESCRIPTOR, throwable);
+    if (field != NULL && object[field->slot] != NULL_REFERENCE) {
+        size_t length;
+        const char *message = get_string(heap, object[field->slot], &length);
+        fputs(": ", stream);
+        fwrite(message, 1, length, stream);
+    }
+    fputc('\n', stream);
+}
@@ -0,0 +1,101 @@
+#ifndef EXCEPTIONS_H
+#define EXCEPTIONS_H
+
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "class_file.h"
+#include "class_loader.h"
+#include "heap.h"
+
+/*
+ * Exceptions are ordinary objects whose classes extend java/lang/Throwable.
+ * A method that throws looks up a handler in its exception table and jumps to it;
+ * if it has none, it returns the exception to its caller, which does the same.
+ * Nothing is done on entering or leaving a try block, so code that doesn't
+ * throw runs exactly as if it had no handlers.
+ */
+
+/** The classes of the exceptions that the VM throws */
+extern const char ARITHMETIC_EXCEPTION[];
+extern const char ARRAY_INDEX_EXCEPTION[];
+extern const char ARRAY_STORE_EXCEPTION[];
+extern const char ILLEGAL_ARGUMENT_EXCEPTION[];
+extern const char NEGATIVE_ARRAY_SIZE_EXCEPTION[];
+extern const char NULL_POINTER_EXCEPTION[];
+extern const char OUT_OF_MEMORY_ERROR[];
+
+/**
+ * Generates the class file for one of the library's exception classes, e.g.
+ * java/lang/ArithmeticException, which the VM provides since the JDK's class
+ * files aren't on the classpath. java/lang/Throwable has a message, which
+ * its constructors set and getMessage() returns; its subclasses inherit these.
+ *
+ * @param name the internal name of the class
+ * @return the parsed class, or NULL if the VM doesn't provide the class
+ */
+class_file_t *get_builtin_class(const char *name);
+
+/**
+ * Creates an exception for the VM to throw, e.g. when dividing by 0.
+ *
+ * @param class_name the internal name of the exception's class
+ * @param message the exception's message, which is copied, or NULL for none
+ * @return a reference to the exception
+ */
+int32_t new_exception(class_loader_t *loader, heap_t *heap, const char *class_name,
+                      const char *message);
+
+/**
+ * Checks that an array element can be accessed.
+ *
+ * @param array a reference to the array
+ * @param index the index of the element
+ * @return the exception to throw, or NULL_REFERENCE if the array isn't null
+ *   and the index is in bounds
+ */
+int32_t check_array_index(class_loader_t *loader, heap_t *heap, int32_t array,
+                          int32_t index);
+
+/**
+ * Checks that an array can be allocated with the given length.
+ *
+ * @return the exception to throw, or NULL_REFERENCE if the length isn't negative
+ */
+int32_t check_array_length(class_loader_t *loader, heap_t *heap, int32_t length);
+
+/**
+ * Checks that an allocation succeeded.
+ *
+ * @param ref what the heap returned for the allocation
+ * @return the OutOfMemoryError to throw, or NULL_REFERENCE if `ref` isn't null
+ */
+int32_t check_allocation(class_loader_t *loader, heap_t *heap, int32_t ref);
+
+/**
+ * Finds the handler for an exception thrown by an instruction,
+ * i.e. the first entry in the method's exception table that covers
+ * the instruction and catches the exception's class or one of its superclasses.
+ *
+ * @param class the class that declares the method
+ * @param code the method's code
+ * @param pc the index of the throwing instruction,
+ *   which is set to the start of the handler if one is found
+ * @param exception_class the class of the exception
+ * @return whether a handler was found
+ */
+bool find_exception_handler(class_loader_t *loader, class_file_t *class,
+                            const code_t *code, size_t *pc,
+                            const class_file_t *exception_class);
+
+/**
+ * Reports an exception that no method caught, as java does,
+ * e.g. `Exception in thread "main" java.lang.ArithmeticException: / by zero`.
+ *
+ * @param stream the stream to print to, e.g. stderr
+ * @param exception a reference to the exception
+ */
+void print_uncaught_exception(FILE *stream, class_loader_t *loader, heap_t *heap,
+                              int32_t exception);
+
+#endif /* EXCEPTIONS_H */
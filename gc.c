@@ -0,0 +1,872 @@
+#include "gc.h"
+
+#include <assert.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+void visit_references(heap_t *heap, block_t *block, const int32_t *from,
+                      const int32_t *to, reference_visitor_t visitor, void *arg) {
+    int32_t *payload = get_payload(block);
+    if (block->kind == BLOCK_REFERENCES) {
+        // The elements follow the array's length
+        int32_t *first = payload + 1;
+        int32_t *end = payload + block->size;
+        for (int32_t *slot = first < from ? (int32_t *) from : first;
+             slot < end && slot < to; slot++) {
+            visitor(heap, slot, arg);
+        }
+    }
+    else if (block->kind == BLOCK_OBJECT && heap->reference_map != NULL) {
+        uint16_t count;
+        const uint16_t *slots =
+            heap->reference_map(heap->reference_map_context, payload[0], &count);
+        for (uint16_t i = 0; i < count; i++) {
+            int32_t *slot = &payload[slots[i]];
+            if (from <= slot && slot < to) {
+                visitor(heap, slot, arg);
+            }
+        }
+    }
+}
+
+/** Calls a visitor on each int of the roots that is a reference */
+void visit_roots(heap_t *heap, const root_ranges_t *list, reference_visitor_t visitor,
+                 void *arg) {
+    for (size_t i = 0; i < list->count; i++) {
+        const root_range_t *range = &list->ranges[i];
+        for (size_t j = 0; j < range->count; j++) {
+            if (is_reference(heap, range->roots[j])) {
+                visitor(heap, &range->roots[j], arg);
+            }
+        }
+    }
+}
+
+/** Calls a visitor on every root */
+void visit_all_roots(heap_t *heap, reference_visitor_t visitor, void *arg) {
+    visit_roots(heap, &heap->frame_roots, visitor, arg);
+    visit_roots(heap, &heap->global_roots, visitor, arg);
+}
+
+/** Gets the number of ms since a time */
+double elapsed_ms(const struct timespec *start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) * 1e3 + (now.tv_nsec - start->tv_nsec) / 1e6;
+}
+
+/** Gets the number of bytes of the heap that blocks take up, including mapped ones */
+size_t used_bytes(const heap_t *heap) {
+    return (heap->young.top - heap->young.start) + (heap->old.top - heap->old.start) +
+           heap->mapped_bytes;
+}
+
+/**
+ * Adds a collection's pause to the heap's statistics, and logs it.
+ * Each log line is a list of space-separated key=value fields:
+ * when the pause started and how long it took in ms, which collections ran,
+ * how many bytes they freed, and how many bytes of the heap were in use
+ * afterwards and could be used before the next full collection.
+ *
+ * @param kind the collections that ran during the pause
+ * @param start when the pause started
+ * @param used the number of bytes of the heap used before (see used_bytes())
+ */
+void record_pause(heap_t *heap, const char *kind, const struct timespec *start,
+                  size_t used) {
+    double pause = elapsed_ms(start);
+    heap->total_pause += pause;
+    if (pause > heap->max_pause) {
+        heap->max_pause = pause;
+    }
+    if (heap->log != NULL) {
+        size_t used_after = used_bytes(heap);
+        double time = (start->tv_sec - heap->start_time.tv_sec) * 1e3 +
+                      (start->tv_nsec - heap->start_time.tv_nsec) / 1e6;
+        size_t capacity = (heap->young.end - heap->young.start) + heap->old_limit;
+        fprintf(heap->log,
+                "gc time_ms=%.3f kind=%s pause_ms=%.3f freed_bytes=%zu "
+                "heap_used_bytes=%zu heap_capacity_bytes=%zu\n",
+                time, kind, pause, used > used_after ? used - used_after : 0, used_after,
+                capacity);
+    }
+}
+
+/*
+ * Young collections
+ */
+
+/**
+ * Copies a young block out of the half of the young generation being collected,
+ * if it hasn't been copied yet: to the other half, or to the old generation
+ * once it is old enough or the other half is full.
+ */
+void evacuate(heap_t *heap, int32_t ref) {
+    int32_t *payload = heap->ptr[ref];
+    if (!in_space(&heap->young, payload)) {
+        return;
+    }
+    block_t *block = get_block(payload);
+    size_t bytes = block_bytes(block->size);
+    block_t *copy = NULL;
+    if (block->age + 1 < TENURING_AGE &&
+        (size_t) (heap->survivor.end - heap->survivor.top) >= bytes) {
+        copy = (block_t *) heap->survivor.top;
+        heap->survivor.top += bytes;
+        memcpy(copy, block, bytes);
+    }
+    else {
+        copy = allocate_old_block(heap, bytes);
+        assert(copy != NULL && "Out of memory");
+        memcpy(copy, block, bytes);
+    }
+    copy->age++;
+    heap->ptr[ref] = get_payload(copy);
+}
+
+/** Evacuates the block a slot refers to */
+void evacuate_slot(heap_t *heap, int32_t *slot, void *arg) {
+    (void) arg;
+    if (*slot != NULL_REFERENCE) {
+        evacuate(heap, *slot);
+    }
+}
+
+/**
+ * Evacuates the block a slot in the old generation refers to,
+ * marking the slot's card if the block is still young
+ */
+void evacuate_old_slot(heap_t *heap, int32_t *slot, void *arg) {
+    (void) arg;
+    if (*slot != NULL_REFERENCE) {
+        evacuate(heap, *slot);
+        if (!in_space(&heap->old, heap->ptr[*slot])) {
+            mark_card(heap, slot);
+        }
+    }
+}
+
+/** Checks whether a position is between the moved and unmoved blocks of a compaction */
+bool in_compaction_gap(const heap_t *heap, const char *position) {
+    return heap->phase == GC_COMPACTING && heap->compact_destination <= position &&
+           position < heap->compact_position;
+}
+
+/**
+ * Evacuates the blocks that slots in the marked cards refer to.
+ * Each card is cleared, and then marked again if it still refers to young blocks.
+ *
+ * @param end the end of the old blocks to scan
+ */
+void scan_cards(heap_t *heap, const char *end) {
+    size_t cards = (end - heap->old.start + (1 << CARD_SHIFT) - 1) >> CARD_SHIFT;
+    for (size_t card = 0; card < cards; card++) {
+        if (heap->cards[card] == 0) {
+            continue;
+        }
+        heap->cards[card] = 0;
+        const char *card_start = heap->old.start + (card << CARD_SHIFT);
+        const char *card_end = card_start + (1 << CARD_SHIFT);
+        if (card_end > end) {
+            card_end = end;
+        }
+        // While compacting, the cards in the gap between the moved and unmoved
+        // blocks have out-of-date block offsets
+        char *position = in_compaction_gap(heap, card_start)
+                             ? heap->compact_position
+                             : heap->old.start + heap->card_blocks[card];
+        while (position < card_end) {
+            if (in_compaction_gap(heap, position)) {
+                position = heap->compact_position;
+                continue;
+            }
+            block_t *block = (block_t *) position;
+            visit_references(heap, block, (const int32_t *) card_start,
+                             (const int32_t *) card_end, evacuate_old_slot, NULL);
+            position += block_bytes(block->size);
+        }
+    }
+}
+
+void collect_young(heap_t *heap) {
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    // The buffers' unused memory must be filled before the young blocks are walked
+    retire_tlabs(heap);
+    size_t used = used_bytes(heap);
+    size_t full_collections = heap->full_collections;
+    // In the worst case, every young block is promoted.
+    // Like allocate_old_block(), count the mapped arrays against the old generation.
+    size_t old_used = heap->old.top - heap->old.start + heap->mapped_bytes;
+    size_t old_free = (size_t) (heap->old.end - heap->old.start) > old_used
+                          ? (size_t) (heap->old.end - heap->old.start) - old_used
+                          : 0;
+    if (old_free < (size_t) (heap->young.top - heap->young.start)) {
+        mark_compact(heap);
+    }
+    heap->survivor.top = heap->survivor.start;
+    char *promoted_start = heap->old.top;
+
+    // Copy the blocks the roots and the old generation refer to
+    visit_all_roots(heap, evacuate_slot, NULL);
+    scan_cards(heap, promoted_start);
+
+    // Then the blocks the copied blocks refer to, until no more are copied
+    char *scanned_survivors = heap->survivor.start;
+    char *scanned_promoted = promoted_start;
+    while (scanned_survivors < heap->survivor.top || scanned_promoted < heap->old.top) {
+        while (scanned_survivors < heap->survivor.top) {
+            block_t *block = (block_t *) scanned_survivors;
+            int32_t *payload = get_payload(block);
+            visit_references(heap, block, payload, payload + block->size, evacuate_slot,
+                             NULL);
+            scanned_survivors += block_bytes(block->size);
+        }
+        while (scanned_promoted < heap->old.top) {
+            block_t *block = (block_t *) scanned_promoted;
+            int32_t *payload = get_payload(block);
+            visit_references(heap, block, payload, payload + block->size,
+                             evacuate_old_slot, NULL);
+            scanned_promoted += block_bytes(block->size);
+        }
+    }
+
+    // The references to blocks that weren't copied are free
+    for (char *position = heap->young.start; position < heap->young.top;) {
+        block_t *block = (block_t *) position;
+        if (heap->ptr[block->ref] == get_payload(block)) {
+            free_reference(heap, block->ref);
+        }
+        position += block_bytes(block->size);
+    }
+
+    // The survivors' half becomes the half new blocks are allocated in
+    space_t survivors = heap->survivor;
+    heap->survivor = heap->young;
+    heap->survivor.top = heap->survivor.start;
+    heap->young = survivors;
+    heap->young_collections++;
+
+    collect_old_if_needed(heap, 0);
+    bool full = heap->full_collections != full_collections;
+    record_pause(heap, full ? "young+full" : "young", &start, used);
+}
+
+/*
+ * Full collections
+ */
+
+/**
+ * Don't start another GC thread for fewer than this many references,
+ * since starting it would take longer than marking them
+ */
+const int32_t REFERENCES_PER_THREAD = 4096;
+
+/** The most references a GC thread steals from another at once */
+#define STEAL_BATCH 256
+
+/**
+ * The number of references a GC thread keeps to itself before sharing them on
+ * its mark stack, so that most references are marked and scanned without locking
+ */
+#define LOCAL_MARKS 64
+
+/**
+ * A GC thread's references that have been marked but whose blocks haven't been
+ * scanned yet. Other threads steal from it when they run out of their own.
+ */
+typedef struct {
+    pthread_mutex_t lock;
+    int32_t *refs;
+    size_t count;
+    size_t capacity;
+} mark_stack_t;
+
+/** The state the GC threads share while marking */
+typedef struct {
+    heap_t *heap;
+    /** Each thread's mark stack */
+    mark_stack_t *stacks;
+    size_t threads;
+    /** The number of threads that have run out of blocks to scan */
+    atomic_size_t idle;
+} marking_t;
+
+/** A GC thread's part of a full collection */
+typedef struct {
+    marking_t *marking;
+    /** The thread's mark stack and the range of references it sweeps */
+    size_t index;
+    /** The references the thread has marked but not shared or scanned yet */
+    int32_t local_marks[LOCAL_MARKS];
+    size_t local_count;
+    int32_t sweep_start;
+    int32_t sweep_end;
+    /** The number of free references the sweep found */
+    size_t free_count;
+} gc_thread_t;
+
+void push_mark(mark_stack_t *stack, const int32_t *refs, size_t count) {
+    pthread_mutex_lock(&stack->lock);
+    if (stack->count + count > stack->capacity) {
+        while (stack->count + count > stack->capacity) {
+            stack->capacity = stack->capacity == 0 ? 1024 : 2 * stack->capacity;
+        }
+        stack->refs = realloc(stack->refs, sizeof(int32_t[stack->capacity]));
+        assert(stack->refs != NULL && "Failed to allocate mark stack");
+    }
+    memcpy(&stack->refs[stack->count], refs, sizeof(int32_t[count]));
+    stack->count += count;
+    pthread_mutex_unlock(&stack->lock);
+}
+
+/**
+ * Takes references off the top of a mark stack.
+ *
+ * @param refs set to the references
+ * @param max the most references to take
+ * @return the number of references taken
+ */
+size_t pop_marks(mark_stack_t *stack, int32_t *refs, size_t max) {
+    pthread_mutex_lock(&stack->lock);
+    size_t count = stack->count < max ? stack->count : max;
+    stack->count -= count;
+    // An empty stack may not have been allocated yet
+    if (count > 0) {
+        memcpy(refs, &stack->refs[stack->count], sizeof(int32_t[count]));
+    }
+    pthread_mutex_unlock(&stack->lock);
+    return count;
+}
+
+/** Checks whether any thread's mark stack has references to steal */
+bool has_marks(marking_t *marking) {
+    for (size_t i = 0; i < marking->threads; i++) {
+        mark_stack_t *stack = &marking->stacks[i];
+        pthread_mutex_lock(&stack->lock);
+        bool empty = stack->count == 0;
+        pthread_mutex_unlock(&stack->lock);
+        if (!empty) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/** Marks the block a slot refers to, if no thread has marked it yet */
+void mark_slot(heap_t *heap, int32_t *slot, void *arg) {
+    gc_thread_t *thread = arg;
+    int32_t ref = *slot;
+    if (ref == NULL_REFERENCE ||
+        atomic_exchange_explicit(&heap->marks[ref], 1, memory_order_relaxed) != 0) {
+        return;
+    }
+    if (thread->local_count == LOCAL_MARKS) {
+        // Share the references so idle threads can steal them
+        push_mark(&thread->marking->stacks[thread->index], thread->local_marks,
+                  LOCAL_MARKS);
+        thread->local_count = 0;
+    }
+    thread->local_marks[thread->local_count] = ref;
+    thread->local_count++;
+}
+
+/**
+ * Scans marked blocks until every reachable block has been marked.
+ * A thread scans the blocks it marked itself first, then the ones on its own
+ * stack, and steals half of another thread's stack once its own is empty.
+ */
+void *mark_thread(void *arg) {
+    gc_thread_t *thread = arg;
+    marking_t *marking = thread->marking;
+    heap_t *heap = marking->heap;
+    int32_t refs[STEAL_BATCH];
+    for (;;) {
+        if (thread->local_count > 0) {
+            thread->local_count--;
+            int32_t *payload = heap->ptr[thread->local_marks[thread->local_count]];
+            block_t *block = get_block(payload);
+            visit_references(heap, block, payload, payload + block->size, mark_slot,
+                             thread);
+            continue;
+        }
+        thread->local_count = pop_marks(&marking->stacks[thread->index],
+                                        thread->local_marks, LOCAL_MARKS / 2);
+        if (thread->local_count > 0) {
+            continue;
+        }
+
+        bool stole = false;
+        for (size_t i = 1; i < marking->threads && !stole; i++) {
+            mark_stack_t *victim =
+                &marking->stacks[(thread->index + i) % marking->threads];
+            pthread_mutex_lock(&victim->lock);
+            size_t half = (victim->count + 1) / 2;
+            pthread_mutex_unlock(&victim->lock);
+            size_t count =
+                pop_marks(victim, refs, half < STEAL_BATCH ? half : STEAL_BATCH);
+            if (count > 0) {
+                push_mark(&marking->stacks[thread->index], refs, count);
+                stole = true;
+            }
+        }
+        if (stole) {
+            continue;
+        }
+
+        /* Wait for another thread to have references to steal. Only threads
+         * that aren't idle push references, so once every thread is idle,
+         * every stack is empty and marking is done. */
+        atomic_fetch_add(&marking->idle, 1);
+        for (;;) {
+            if (atomic_load(&marking->idle) == marking->threads) {
+                return NULL;
+            }
+            if (has_marks(marking)) {
+                atomic_fetch_sub(&marking->idle, 1);
+                break;
+            }
+            sched_yield();
+        }
+    }
+}
+
+/**
+ * Frees the unmarked references in a thread's range of the reference table and
+ * clears the marks. The range's free references, including ones that were
+ * already free, are listed at the same offsets of `free_refs`, to be
+ * gathered into one list once every thread is done.
+ */
+void *sweep_thread(void *arg) {
+    gc_thread_t *thread = arg;
+    heap_t *heap = thread->marking->heap;
+    int32_t *free_refs = &heap->free_refs[thread->sweep_start];
+    thread->free_count = 0;
+    for (int32_t ref = thread->sweep_start; ref < thread->sweep_end; ref++) {
+        if (atomic_load_explicit(&heap->marks[ref], memory_order_relaxed) == 0) {
+            heap->ptr[ref] = NULL;
+        }
+        else {
+            atomic_store_explicit(&heap->marks[ref], 0, memory_order_relaxed);
+        }
+        if (heap->ptr[ref] == NULL) {
+            free_refs[thread->free_count] = ref;
+            thread->free_count++;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Starts running a function on GC threads other than this one,
+ * which is thread 0.
+ *
+ * @param threads each thread's argument to the function
+ * @param workers set to the threads that were started
+ * @return the number of GC threads running the function, including this one,
+ *   which is smaller than `count` if some couldn't be started
+ */
+size_t start_gc_threads(void *(*function)(void *), gc_thread_t *threads, size_t count,
+                        pthread_t *workers) {
+    size_t started = 1;
+    for (; started < count; started++) {
+        if (pthread_create(&workers[started], NULL, function, &threads[started]) != 0) {
+            break;
+        }
+    }
+    return started;
+}
+
+/** Waits for the GC threads that start_gc_threads() started */
+void join_gc_threads(pthread_t *workers, size_t started) {
+    for (size_t i = 1; i < started; i++) {
+        pthread_join(workers[i], NULL);
+    }
+}
+
+/** Marks a card of the old generation if a slot in it refers to a young block */
+void mark_young_slot(heap_t *heap, int32_t *slot, void *arg) {
+    (void) arg;
+    if (*slot != NULL_REFERENCE && !in_space(&heap->old, heap->ptr[*slot])) {
+        mark_card(heap, slot);
+    }
+}
+
+/** Deals the roots out among the GC threads' mark stacks */
+void mark_root(heap_t *heap, int32_t *slot, void *arg) {
+    marking_t *marking = arg;
+    if (atomic_exchange_explicit(&heap->marks[*slot], 1, memory_order_relaxed) == 0) {
+        size_t thread = (size_t) *slot % marking->threads;
+        push_mark(&marking->stacks[thread], slot, 1);
+    }
+}
+
+/**
+ * Marks the blocks reachable from the roots and frees the references to the
+ * rest, on as many threads as the heap allows and is worth starting.
+ */
+void mark_and_sweep(heap_t *heap) {
+    // Sweeping frees every unused reference, including the ones threads reserved
+    drop_tlab_references(heap);
+    size_t threads = heap->count / REFERENCES_PER_THREAD + 1;
+    if (threads > heap->gc_threads) {
+        threads = heap->gc_threads;
+    }
+    marking_t marking = {.heap = heap, .threads = threads};
+    mark_stack_t stacks[threads];
+    gc_thread_t gc_threads[threads];
+    marking.stacks = stacks;
+    atomic_init(&marking.idle, 0);
+    for (size_t i = 0; i < threads; i++) {
+        stacks[i] = (mark_stack_t){.refs = NULL, .count = 0, .capacity = 0};
+        pthread_mutex_init(&stacks[i].lock, NULL);
+        gc_threads[i] = (gc_thread_t){.marking = &marking, .index = i, .local_count = 0};
+    }
+
+    visit_all_roots(heap, mark_root, &marking);
+    pthread_t workers[threads];
+    size_t started = start_gc_threads(mark_thread, gc_threads, threads, workers);
+    // Threads that couldn't be started count as idle, and the others steal their roots
+    atomic_fetch_add(&marking.idle, threads - started);
+    mark_thread(&gc_threads[0]);
+    join_gc_threads(workers, started);
+
+    // Split the reference table into a range per thread
+    int32_t range = (heap->count - 1 + threads - 1) / threads;
+    for (size_t i = 0; i < threads; i++) {
+        int32_t start = NULL_REFERENCE + 1 + i * range;
+        gc_threads[i].sweep_start = start < heap->count ? start : heap->count;
+        gc_threads[i].sweep_end =
+            start + range < heap->count ? start + range : heap->count;
+    }
+    started = start_gc_threads(sweep_thread, gc_threads, threads, workers);
+    sweep_thread(&gc_threads[0]);
+    for (size_t i = started; i < threads; i++) {
+        sweep_thread(&gc_threads[i]);
+    }
+    join_gc_threads(workers, started);
+
+    // Gather the free references
+    heap->free_count = 0;
+    for (size_t i = 0; i < threads; i++) {
+        memmove(&heap->free_refs[heap->free_count],
+                &heap->free_refs[gc_threads[i].sweep_start],
+                sizeof(int32_t[gc_threads[i].free_count]));
+        heap->free_count += gc_threads[i].free_count;
+        pthread_mutex_destroy(&stacks[i].lock);
+        free(stacks[i].refs);
+    }
+}
+
+/**
+ * Returns the pages of the old generation past its limit to the OS,
+ * if compacting emptied them, so the program's memory use shrinks back
+ * after a spike of live data. The pages below the limit are kept,
+ * since they are likely to be used again before the next full collection.
+ *
+ * @param previous_top the end of the old blocks before compacting
+ */
+void release_old_pages(heap_t *heap, const char *previous_top) {
+    uintptr_t page_size = sysconf(_SC_PAGESIZE);
+    uintptr_t start = (uintptr_t) heap->old.start + heap->old_limit;
+    if (start < (uintptr_t) heap->old.top) {
+        start = (uintptr_t) heap->old.top;
+    }
+    start = (start + page_size - 1) & ~(page_size - 1);
+    uintptr_t end = ((uintptr_t) previous_top + page_size - 1) & ~(page_size - 1);
+    if (end > (uintptr_t) heap->old.end) {
+        end = (uintptr_t) heap->old.end;
+    }
+    if (start < end && madvise((void *) start, end - start, MADV_DONTNEED) == 0) {
+        heap->released_bytes += end - start;
+    }
+}
+
+void free_dead_mappings(heap_t *heap) {
+    for (mapping_t **link = &heap->mappings; *link != NULL;) {
+        mapping_t *mapping = *link;
+        block_t *block = (block_t *) (mapping + 1);
+        // The block's reference may have been reused since it was freed
+        if (heap->ptr[block->ref] == get_payload(block)) {
+            link = &mapping->next;
+            continue;
+        }
+        *link = mapping->next;
+        size_t size_class = mapping->size_class;
+        size_t bytes = (size_t) sysconf(_SC_PAGESIZE) << size_class;
+        heap->mapped_bytes -= bytes;
+        if (heap->free_mapped_bytes + bytes <= heap->old_limit) {
+            mapping->next = heap->free_mappings[size_class];
+            heap->free_mappings[size_class] = mapping;
+            heap->free_mapped_bytes += bytes;
+        }
+        else {
+            munmap(mapping, bytes);
+        }
+    }
+}
+
+/**
+ * Moves an old block down to a position, if it is alive, and marks the cards
+ * of its slots that refer to young blocks.
+ *
+ * @param destination the position, which is advanced past the block if it is moved
+ * @return the position after the block
+ */
+char *slide_block(heap_t *heap, char *position, char **destination) {
+    block_t *block = (block_t *) position;
+    size_t bytes = block_bytes(block->size);
+    if (heap->ptr[block->ref] == get_payload(block)) {
+        if (*destination != position) {
+            memmove(*destination, block, bytes);
+        }
+        block = (block_t *) *destination;
+        heap->ptr[block->ref] = get_payload(block);
+        record_old_block(heap, block);
+        int32_t *payload = get_payload(block);
+        visit_references(heap, block, payload, payload + block->size, mark_young_slot,
+                         NULL);
+        *destination += bytes;
+    }
+    return position + bytes;
+}
+
+/**
+ * Finishes compacting the old generation: lets it grow to twice its live data
+ * before the next collection and releases the pages past that.
+ *
+ * @param previous_top the end of the old blocks before compacting
+ */
+void finish_compaction(heap_t *heap, const char *previous_top) {
+    /* The limit shrinks as well as grows, so after a spike,
+     * the pages past it can be released. */
+    size_t old_capacity = heap->old.end - heap->old.start;
+    size_t live = heap->old.top - heap->old.start + heap->mapped_bytes;
+    size_t limit = 2 * live > heap->min_old_limit ? 2 * live : heap->min_old_limit;
+    heap->old_limit = limit < old_capacity ? limit : old_capacity;
+    release_old_pages(heap, previous_top);
+    heap->full_collections++;
+}
+
+void mark_compact(heap_t *heap) {
+    finish_incremental_collection(heap);
+    mark_and_sweep(heap);
+    free_dead_mappings(heap);
+
+    /* Slide the live old blocks down over the dead ones, keeping them in order,
+     * so the old generation is contiguous and blocks allocated together stay
+     * together. Blocks that are already in place, like the long-lived ones at
+     * the start of the old generation, aren't copied. */
+    char *previous_top = heap->old.top;
+    memset(heap->cards, 0,
+           (heap->old.top - heap->old.start + (1 << CARD_SHIFT) - 1) >> CARD_SHIFT);
+    char *destination = heap->old.start;
+    for (char *position = heap->old.start; position < heap->old.top;) {
+        position = slide_block(heap, position, &destination);
+    }
+    heap->old.top = destination;
+    finish_compaction(heap, previous_top);
+}
+
+bool collect_old_if_needed(heap_t *heap, size_t bytes) {
+    size_t used = heap->old.top - heap->old.start + heap->mapped_bytes + bytes;
+    if (heap->pause_target != 0 && heap->phase == GC_IDLE) {
+        if (used > heap->old_limit / 2) {
+            start_incremental_collection(heap);
+        }
+        return false;
+    }
+    if (used <= heap->old_limit) {
+        return false;
+    }
+    if (heap->phase != GC_IDLE) {
+        finish_incremental_collection(heap);
+    }
+    else {
+        mark_compact(heap);
+    }
+    return true;
+}
+
+void collect_old(heap_t *heap, size_t bytes) {
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    size_t used = used_bytes(heap);
+    if (collect_old_if_needed(heap, bytes)) {
+        record_pause(heap, "full", &start, used);
+    }
+}
+
+void collect_full(heap_t *heap) {
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    size_t used = used_bytes(heap);
+    mark_compact(heap);
+    record_pause(heap, "full", &start, used);
+}
+
+/*
+ * Incremental full collections
+ */
+
+/** The number of blocks or references an increment handles between checks of the time */
+#define INCREMENT_CHUNK 64
+
+void shade(heap_t *heap, int32_t ref) {
+    if (ref == NULL_REFERENCE ||
+        atomic_load_explicit(&heap->marks[ref], memory_order_relaxed) != 0) {
+        return;
+    }
+    atomic_store_explicit(&heap->marks[ref], 1, memory_order_relaxed);
+    if (heap->gray_count == heap->gray_capacity) {
+        heap->gray_capacity = heap->gray_capacity == 0 ? 1024 : 2 * heap->gray_capacity;
+        heap->gray = realloc(heap->gray, sizeof(int32_t[heap->gray_capacity]));
+        assert(heap->gray != NULL && "Failed to allocate mark stack");
+    }
+    heap->gray[heap->gray_count] = ref;
+    heap->gray_count++;
+}
+
+/** Marks the block a slot refers to gray */
+void shade_slot(heap_t *heap, int32_t *slot, void *arg) {
+    (void) arg;
+    shade(heap, *slot);
+}
+
+void start_incremental_collection(heap_t *heap) {
+    assert(heap->phase == GC_IDLE && "Incremental collection already running");
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    heap->phase = GC_MARKING;
+    heap->allocated_since_increment = 0;
+    visit_all_roots(heap, shade_slot, NULL);
+    record_pause(heap, "mark-start", &start, used_bytes(heap));
+}
+
+/**
+ * Scans gray blocks, marking the blocks they refer to gray.
+ *
+ * @return whether every gray block has been scanned
+ */
+bool mark_increment(heap_t *heap) {
+    for (size_t i = 0; i < INCREMENT_CHUNK && heap->gray_count > 0; i++) {
+        heap->gray_count--;
+        int32_t *payload = heap->ptr[heap->gray[heap->gray_count]];
+        // A young collection may have freed the block since it was marked,
+        // in which case it is no longer reachable
+        if (payload != NULL) {
+            block_t *block = get_block(payload);
+            visit_references(heap, block, payload, payload + block->size, shade_slot,
+                             NULL);
+        }
+    }
+    return heap->gray_count == 0;
+}
+
+/**
+ * Frees the unmarked references in the next part of the reference table.
+ * The marks are cleared once the whole table has been swept.
+ *
+ * @return whether the whole table has been swept
+ */
+bool sweep_increment(heap_t *heap) {
+    int32_t end = heap->sweep_position + INCREMENT_CHUNK * 64;
+    if (end > heap->count) {
+        end = heap->count;
+    }
+    for (; heap->sweep_position < end; heap->sweep_position++) {
+        int32_t ref = heap->sweep_position;
+        if (heap->ptr[ref] != NULL &&
+            atomic_load_explicit(&heap->marks[ref], memory_order_relaxed) == 0) {
+            free_reference(heap, ref);
+        }
+    }
+    if (heap->sweep_position < heap->count) {
+        return false;
+    }
+    memset((void *) heap->marks, 0, sizeof(atomic_uchar[heap->count]));
+    return true;
+}
+
+/**
+ * Moves the next old blocks down over the dead ones. Blocks allocated in the
+ * old generation since compaction started are moved as well.
+ *
+ * @return whether every old block has been moved
+ */
+bool compact_increment(heap_t *heap) {
+    // Large blocks take longer to move, so the chunk is limited by their size too
+    const char *chunk_end = heap->compact_position + (INCREMENT_CHUNK << 8);
+    for (size_t i = 0; i < INCREMENT_CHUNK && heap->compact_position < heap->old.top &&
+                       heap->compact_position < chunk_end;
+         i++) {
+        heap->compact_position =
+            slide_block(heap, heap->compact_position, &heap->compact_destination);
+    }
+    if (heap->compact_position < heap->old.top) {
+        return false;
+    }
+    char *previous_top = heap->old.top;
+    heap->old.top = heap->compact_destination;
+    // The cards past the new top may still be marked from blocks that moved
+    size_t first_free_card =
+        (heap->old.top - heap->old.start + (1 << CARD_SHIFT) - 1) >> CARD_SHIFT;
+    size_t end_card =
+        (previous_top - heap->old.start + (1 << CARD_SHIFT) - 1) >> CARD_SHIFT;
+    if (first_free_card < end_card) {
+        memset(&heap->cards[first_free_card], 0, end_card - first_free_card);
+    }
+    finish_compaction(heap, previous_top);
+    return true;
+}
+
+/** Does a chunk of the running incremental collection's work */
+void advance_collection(heap_t *heap) {
+    switch (heap->phase) {
+        case GC_MARKING:
+            if (mark_increment(heap)) {
+                heap->phase = GC_SWEEPING;
+                heap->sweep_position = NULL_REFERENCE + 1;
+            }
+            break;
+        case GC_SWEEPING:
+            if (sweep_increment(heap)) {
+                free_dead_mappings(heap);
+                heap->phase = GC_COMPACTING;
+                heap->compact_position = heap->old.start;
+                heap->compact_destination = heap->old.start;
+            }
+            break;
+        case GC_COMPACTING:
+            if (compact_increment(heap)) {
+                heap->phase = GC_IDLE;
+            }
+            break;
+        case GC_IDLE:
+            break;
+    }
+}
+
+void finish_incremental_collection(heap_t *heap) {
+    while (heap->phase != GC_IDLE) {
+        advance_collection(heap);
+    }
+}
+
+void collect_increment(heap_t *heap) {
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    size_t used = used_bytes(heap);
+    const char *kind = heap->phase == GC_MARKING    ? "mark"
+                       : heap->phase == GC_SWEEPING ? "sweep"
+                                                    : "compact";
+    do {
+        advance_collection(heap);
+    } while (heap->phase != GC_IDLE && elapsed_ms(&start) < heap->pause_target);
+    record_pause(heap, kind, &start, used);
+}
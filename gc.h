@@ -0,0 +1,435 @@
+#ifndef GC_H
+#define GC_H
+
+/*
+ * The internals of the heap, which the allocator (heap.c) and the garbage
+ * collector (gc.c) share. The rest of the VM only uses heap.h.
+ */
+
+#include <pthread.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "heap.h"
+
+/** What a block's payload holds, which determines the references in it */
+typedef enum {
+    /** Only ints, e.g. an int[] or a String */
+    BLOCK_INTS,
+    /** An array of references: its length, then the references */
+    BLOCK_REFERENCES,
+    /** An object: its class id, then fields the class's reference map describes */
+    BLOCK_OBJECT,
+} block_kind_t;
+
+/**
+ * The header of an object or array in one of the heap's spaces.
+ * The object or array itself, the block's payload, follows immediately.
+ */
+typedef struct {
+    /** The reference to the payload */
+    int32_t ref;
+    /** The number of ints in the payload */
+    uint32_t size;
+    /** What the payload holds (see `block_kind_t`) */
+    uint8_t kind;
+    /** The number of young collections the block has survived */
+    uint8_t age;
+    /** Where the block was allocated (see `heap_set_allocation_site()`), or 0 */
+    uint16_t site;
+} block_t;
+
+/** A contiguous region of memory that blocks are allocated from in order */
+typedef struct {
+    /** The first block */
+    char *start;
+    /** The end of the last block, where the next block is allocated */
+    char *top;
+    /** The end of the region */
+    char *end;
+} space_t;
+
+/**
+ * The memory mapped for a large int array, which starts with this header,
+ * followed by the array's block. Each mapping is a power of 2 pages, its size
+ * class, so mappings freed by collections can be reused for other arrays of
+ * the same class without going back to the OS.
+ */
+typedef struct mapping {
+    /** The next mapping in the list of live mappings or of free mappings */
+    struct mapping *next;
+    /** The mapping's size class: it is 2^`size_class` pages */
+    size_t size_class;
+} mapping_t;
+
+/**
+ * Int arrays whose blocks take up at least this many bytes, and which are too
+ * large for the young generation, are each given their own mapping instead of
+ * being allocated in the old generation, so compaction never moves them and
+ * their memory can be reused as soon as they die.
+ */
+#define MAPPED_BLOCK_SIZE (32 << 10)
+
+/** The number of size classes of mappings */
+#define MAPPING_CLASSES 48
+
+/**
+ * The size of the huge pages the heap uses with the large pages options.
+ * Mappings at least this large start at a multiple of it.
+ */
+#define HUGE_PAGE_SIZE ((size_t) 2 << 20)
+
+/** The number of references a thread's allocation buffer holds at most */
+#define TLAB_REFERENCES 64
+
+/**
+ * A thread-local allocation buffer: a part of the young generation that only
+ * one thread allocates blocks in, and references that only that thread gives
+ * them, so allocating a small block touches nothing the thread shares.
+ * Only refilling the buffer takes the heap's lock.
+ */
+typedef struct tlab {
+    /** Where the buffer's next block is allocated, or NULL if it has no memory */
+    char *top;
+    /**
+     * The end of the buffer's memory, minus the size of a block header,
+     * so the rest of the buffer can always be filled (see retire_tlabs())
+     */
+    char *end;
+    /** The references reserved for the thread, which are given out from the end */
+    int32_t refs[TLAB_REFERENCES];
+    size_t refs_count;
+    /** The allocation site of the thread's next block */
+    uint16_t allocation_site;
+    /** The NUMA node the thread is pinned to, or -1 if it isn't pinned */
+    int node;
+    /** The next buffer in the heap's list of its threads' buffers */
+    struct tlab *next;
+} tlab_t;
+
+/** A range of ints that may hold references (see `heap_push_roots()`) */
+typedef struct {
+    int32_t *roots;
+    size_t count;
+} root_range_t;
+
+/** A growable array of root ranges */
+typedef struct {
+    root_range_t *ranges;
+    size_t count;
+    size_t capacity;
+} root_ranges_t;
+
+/**
+ * The old generation is divided into cards of this many bytes (as a power of 2).
+ * A store of a reference into an old block marks the card containing the
+ * stored-into int, so young collections only scan the old blocks in marked cards.
+ */
+#define CARD_SHIFT 9
+
+/** How many young collections a block survives before it moves to the old generation */
+#define TENURING_AGE 2
+
+/**
+ * Where an incremental full collection is up to. Each phase is done in
+ * increments between allocations, in the order they are listed.
+ */
+typedef enum {
+    /** No incremental collection is running */
+    GC_IDLE,
+    /** Scanning the gray references, which are marked but not scanned yet */
+    GC_MARKING,
+    /** Freeing the unmarked references */
+    GC_SWEEPING,
+    /** Sliding the live old blocks down over the dead ones */
+    GC_COMPACTING,
+} gc_phase_t;
+
+struct heap {
+    /** The payload each reference refers to, or NULL if the reference is unused */
+    int32_t **ptr;
+    /** The number of entries in `ptr` that have been used, including NULL_REFERENCE */
+    int32_t count;
+    /**
+     * The number of entries reserved for `ptr`, `marks` and `free_refs`.
+     * The tables are reserved up front and never move, so threads can use
+     * them while another thread takes more references.
+     */
+    int32_t capacity;
+    /** References that were freed by collections and can be reused */
+    int32_t *free_refs;
+    size_t free_count;
+    /**
+     * Whether each reference has been found to be alive by a full collection.
+     * The GC threads mark references in parallel, so the marks are atomic.
+     */
+    atomic_uchar *marks;
+
+    /**
+     * Held while changing the state threads share, e.g. to refill a thread's
+     * allocation buffer or to collect garbage
+     */
+    pthread_mutex_t lock;
+    /** The allocation buffers of the threads that allocate in the heap, in a list */
+    tlab_t *tlabs;
+    /** The number of bytes of the young generation a buffer takes at a time */
+    size_t tlab_size;
+    /**
+     * The number of NUMA nodes the buffers and mapped arrays are placed on,
+     * or 0 if they aren't placed, e.g. on machines with a single node
+     */
+    size_t numa_nodes;
+    /** Whether to pin attached threads to NUMA nodes */
+    bool numa_pinning;
+    /** The number of threads that have been pinned, to take turns between nodes */
+    size_t pinned_threads;
+
+    /** The half of the young generation that new blocks are allocated in */
+    space_t young;
+    /** The other half of the young generation, which survivors are copied to */
+    space_t survivor;
+    /** Blocks larger than this many bytes are allocated in the old generation */
+    size_t large_block_size;
+    /** The old generation, whose `end` is the end of the memory reserved for it */
+    space_t old;
+    /** How many bytes of the old generation may be used before a full collection */
+    size_t old_limit;
+    /** The smallest `old_limit` full collections set */
+    size_t min_old_limit;
+    /** The number of bytes of the old generation compaction has returned to the OS */
+    size_t released_bytes;
+    /** The mappings of the live large int arrays (see `mapping_t`), in a list */
+    mapping_t *mappings;
+    /** The number of bytes of the mappings in `mappings` */
+    size_t mapped_bytes;
+    /** The free mappings kept for reuse, in a list per size class */
+    mapping_t *free_mappings[MAPPING_CLASSES];
+    /** The number of bytes of the mappings in `free_mappings` */
+    size_t free_mapped_bytes;
+    /** The number of large arrays that reused a free mapping */
+    size_t reused_mappings;
+    /**
+     * Which huge pages back the heap. Falls back from LARGE_PAGES_EXPLICIT
+     * to LARGE_PAGES_TRANSPARENT once too few explicit huge pages are free.
+     */
+    large_pages_t large_pages;
+    /**
+     * One byte per card of the old generation, which is nonzero if the card may
+     * hold a reference to a young block
+     */
+    uint8_t *cards;
+    /**
+     * For each card of the old generation, the offset from `old.start` of the
+     * block that contains the first byte of the card
+     */
+    uint32_t *card_blocks;
+
+    /** The ranges registered with heap_push_roots(), in stack order */
+    root_ranges_t frame_roots;
+    /** The ranges registered with heap_add_global_roots() */
+    root_ranges_t global_roots;
+    /** Finds the references in objects (see `heap_set_reference_map()`) */
+    reference_map_t reference_map;
+    void *reference_map_context;
+
+    /** The most threads a full collection marks and sweeps on */
+    size_t gc_threads;
+    /** Where to log each collection's pause, or NULL */
+    FILE *log;
+    /** When the heap was initialized, which the log's times are relative to */
+    struct timespec start_time;
+    /** The number of collections of each kind that have run */
+    size_t young_collections;
+    size_t full_collections;
+    /** The total and longest time that collections have paused the program, in ms */
+    double total_pause;
+    double max_pause;
+
+    /**
+     * The longest an increment of an incremental full collection should take,
+     * in ms, or 0 if full collections aren't incremental
+     */
+    double pause_target;
+    /**
+     * What the running incremental collection is doing.
+     * Allocating threads read it without the heap's lock.
+     */
+    _Atomic gc_phase_t phase;
+    /** The bytes allocated since the last increment */
+    size_t allocated_since_increment;
+    /** The references that have been marked but whose blocks haven't been scanned */
+    int32_t *gray;
+    size_t gray_count;
+    size_t gray_capacity;
+    /** The next reference to sweep */
+    int32_t sweep_position;
+    /**
+     * While compacting, the next old block to move and where to move it to.
+     * The memory between them holds no blocks.
+     */
+    char *compact_position;
+    char *compact_destination;
+
+    /** Names allocation sites in heap dumps (see `heap_set_site_names()`) */
+    site_names_t site_names;
+    void *site_names_context;
+    /** Where heap_request_dump() dumps the heap, or NULL */
+    const char *dump_path;
+    /** Whether heap_request_dump() has been called since the last dump */
+    volatile sig_atomic_t dump_requested;
+};
+
+/** Gets the header of a block from its payload */
+block_t *get_block(int32_t *payload);
+
+/** Gets the payload of a block */
+int32_t *get_payload(block_t *block);
+
+/** Gets the number of bytes a block with the given payload size takes up */
+size_t block_bytes(uint32_t size);
+
+/** Checks whether a pointer is inside a space */
+bool in_space(const space_t *space, const void *pointer);
+
+/** Checks whether an int is a reference to an object or array in the heap */
+bool is_reference(const heap_t *heap, int32_t value);
+
+/**
+ * Allocates a block in the old generation, if there is room,
+ * and records where it starts for scanning cards.
+ *
+ * @param bytes the size of the block, including its header
+ * @return the uninitialized block, or NULL if the old generation is full
+ */
+block_t *allocate_old_block(heap_t *heap, size_t bytes);
+
+/**
+ * Allocates a block in a mapping of its own (see `mapping_t`), if the heap
+ * has room for it, reusing a free mapping of the right size if there is one.
+ *
+ * @param bytes the size of the block, including its header
+ * @return the uninitialized block, or NULL if the heap is full
+ */
+block_t *allocate_mapped_block(heap_t *heap, size_t bytes);
+
+/**
+ * Frees the mappings of the arrays whose references a collection has freed.
+ * Like the old generation's pages below its limit, up to `old_limit` bytes of
+ * them are kept for reuse, and the rest are returned to the OS.
+ */
+void free_dead_mappings(heap_t *heap);
+
+/**
+ * Records that a block in the old generation starts at a position,
+ * updating `card_blocks` for the cards whose first bytes it contains.
+ */
+void record_old_block(heap_t *heap, block_t *block);
+
+/** Marks the card containing an int in the old generation */
+void mark_card(heap_t *heap, const int32_t *address);
+
+/** Makes a reference available to be reused */
+void free_reference(heap_t *heap, int32_t ref);
+
+/**
+ * Fills the unused memory of each thread's allocation buffer with a block
+ * that has no reference, so the young generation can be walked block by block,
+ * and empties the buffers. Called before a young collection.
+ */
+void retire_tlabs(heap_t *heap);
+
+/**
+ * Empties the references reserved for each thread.
+ * Called before the references are swept, which frees them again.
+ */
+void drop_tlab_references(heap_t *heap);
+
+/**
+ * Called for each reference slot of a block that a traversal visits.
+ *
+ * @param slot the int holding the reference, which may be NULL_REFERENCE
+ * @param arg the argument passed to visit_references()
+ */
+typedef void (*reference_visitor_t)(heap_t *heap, int32_t *slot, void *arg);
+
+/**
+ * Visits the slots of a block that hold references and are in a range of memory.
+ *
+ * @param from the start of the range
+ * @param to the end of the range
+ */
+void visit_references(heap_t *heap, block_t *block, const int32_t *from,
+                      const int32_t *to, reference_visitor_t visitor, void *arg);
+
+/**
+ * Collects the young generation, copying the blocks that are still reachable
+ * to the other half of the young generation or, once they are old enough,
+ * to the old generation. Runs a full collection first if the old generation
+ * might not have room for the survivors, or afterwards if it has grown too big.
+ */
+void collect_young(heap_t *heap);
+
+/**
+ * Collects the whole heap. The reachable blocks are marked and the references
+ * to unreachable ones are freed, both in parallel on up to `gc_threads`
+ * threads. Then the live blocks of the old generation are slid together to
+ * the start of the old generation, and the pages that frees past the old
+ * generation's limit are returned to the OS.
+ */
+void collect_full(heap_t *heap);
+
+/**
+ * Collects the old generation if allocating in it would take it past its limit.
+ * If full collections are incremental, one is started at half the limit
+ * instead, leaving room to allocate while it runs, and only finished at once
+ * if the old generation reaches its limit before it is done.
+ *
+ * @param bytes the number of bytes about to be allocated in the old generation
+ * @return whether a collection ran, rather than just starting
+ */
+bool collect_old_if_needed(heap_t *heap, size_t bytes);
+
+/** Does the work of collect_old_if_needed(), recording the pause */
+void collect_old(heap_t *heap, size_t bytes);
+
+/**
+ * Does the work of collect_full(), without recording the pause,
+ * e.g. as part of a young collection.
+ * Finishes the running incremental collection first, if there is one.
+ */
+void mark_compact(heap_t *heap);
+
+/**
+ * Starts an incremental full collection by marking the roots gray.
+ * From then on, the blocks that were reachable at the start are marked
+ * a little at a time by collect_increment(), the snapshot-at-the-beginning
+ * write barrier marks references as they are overwritten, and new blocks are
+ * allocated marked, so anything that was live at the start or allocated since
+ * survives. The unmarked references are then freed and the old generation
+ * compacted, also in increments.
+ */
+void start_incremental_collection(heap_t *heap);
+
+/**
+ * Does the next part of the running incremental collection,
+ * stopping once it has taken `pause_target` ms.
+ */
+void collect_increment(heap_t *heap);
+
+/** Does the rest of the running incremental collection, if there is one, at once */
+void finish_incremental_collection(heap_t *heap);
+
+/** Writes a dump of the heap to `dump_path`, as heap_request_dump() requested */
+void dump_requested_heap(heap_t *heap);
+
+/**
+ * Marks a reference gray, if it isn't marked yet,
+ * so the running incremental collection scans its block.
+ */
+void shade(heap_t *heap, int32_t ref);
+
+#endif /* GC_H */
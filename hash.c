@@ -0,0 +1,9 @@
+#include "hash.h"
+
+size_t hash_bytes(const char *bytes, size_t length) {
+    size_t hash = 2166136261u;
+    for (size_t i = 0; i < length; i++) {
+        hash = (hash ^ (unsigned char) bytes[i]) * 16777619u;
+    }
+    return hash;
+}
@@ -0,0 +1,15 @@
+#ifndef HASH_H
+#define HASH_H
+
+#include <stddef.h>
+
+/**
+ * Hashes a string of bytes (FNV-1a), e.g. for the VM's hash tables of
+ * class names, JAR entry names and interned strings.
+ *
+ * @param bytes the bytes to hash, which needn't be null-terminated
+ * @param length the number of bytes
+ */
+size_t hash_bytes(const char *bytes, size_t length);
+
+#endif /* HASH_H */
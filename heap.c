@@ -1,38 +1,775 @@
 #include "heap.h"
 
+#include <assert.h>
+#include <stdbool.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
 
-typedef struct heap {
-    /** Generic array of pointers. */
-    int32_t **ptr;
-    /** How many pointers there are currently in the array. */
-    int32_t count;
-} heap_t;
+#include "gc.h"
+#include "nodes.h"
 
-heap_t *heap_init() {
-    // The heap array is initially allocated to hold zero elements.
+const heap_options_t DEFAULT_HEAP_OPTIONS = {
+    .young_size = 4 << 20,
+    .max_size = 512 << 20,
+    .gc_threads = 1,
+    .log = NULL,
+    .pause_target = 0,
+    .dump_path = NULL,
+    .large_pages = LARGE_PAGES_NONE,
+    .numa = false,
+    .numa_pinning = false,
+};
+
+/**
+ * While an incremental collection is running, an increment of it is done
+ * each time this many bytes have been allocated
+ */
+const size_t INCREMENT_INTERVAL = 16 << 10;
+
+/** How many bytes of the old generation may be used before the first full collection */
+const size_t INITIAL_OLD_LIMIT = 16 << 20;
+
+/**
+ * The number of references reserved beyond those the heap's blocks can use,
+ * for arrays allocated in frames and references reserved by allocation buffers
+ */
+const int32_t EXTRA_REFERENCES = 1 << 20;
+
+/** The allocation buffer of the calling thread (see heap_attach_thread()) */
+_Thread_local tlab_t *thread_tlab = NULL;
+
+block_t *get_block(int32_t *payload) {
+    return (block_t *) ((char *) payload - sizeof(block_t));
+}
+
+int32_t *get_payload(block_t *block) {
+    return (int32_t *) ((char *) block + sizeof(block_t));
+}
+
+size_t block_bytes(uint32_t size) {
+    return sizeof(block_t) + sizeof(int32_t[size]);
+}
+
+bool in_space(const space_t *space, const void *pointer) {
+    return space->start <= (const char *) pointer && (const char *) pointer < space->end;
+}
+
+bool is_reference(const heap_t *heap, int32_t value) {
+    return value > NULL_REFERENCE && value < heap->count && heap->ptr[value] != NULL;
+}
+
+/**
+ * Reserves memory that starts at a multiple of HUGE_PAGE_SIZE and asks the kernel
+ * to back it with transparent huge pages. Since mmap() only aligns to pages,
+ * a huge page more is reserved and the unaligned ends are unmapped.
+ *
+ * @return the memory, or MAP_FAILED if it couldn't be reserved
+ */
+void *map_huge_aligned(size_t bytes) {
+    size_t page_size = sysconf(_SC_PAGESIZE);
+    bytes = (bytes + page_size - 1) & ~(page_size - 1);
+    char *start = mmap(NULL, bytes + HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (start == MAP_FAILED) {
+        return MAP_FAILED;
+    }
+    char *aligned =
+        (char *) (((uintptr_t) start + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1));
+    if (aligned != start) {
+        munmap(start, aligned - start);
+    }
+    if (aligned != start + HUGE_PAGE_SIZE) {
+        munmap(aligned + bytes, start + HUGE_PAGE_SIZE - aligned);
+    }
+    // Without transparent huge pages (e.g. in a container), default pages are used
+    madvise(aligned, bytes, MADV_HUGEPAGE);
+    return aligned;
+}
+
+/** Reserves memory for a table, which the OS only provides once it is used */
+void *map_table(size_t bytes) {
+    void *start = mmap(NULL, bytes, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    assert(start != MAP_FAILED && "Failed to allocate reference table");
+    return start;
+}
+
+/**
+ * Reserves the reference table for as many references as can be in use at once.
+ * Every block in the heap takes at least block_bytes(1), and the table's
+ * memory is zeroed, so no marks are set.
+ */
+void map_reference_table(heap_t *heap, size_t max_size) {
+    size_t capacity = max_size / block_bytes(1) + EXTRA_REFERENCES;
+    heap->capacity = capacity < INT32_MAX ? capacity : INT32_MAX;
+    heap->ptr = map_table(sizeof(int32_t *[heap->capacity]));
+    heap->marks = map_table(sizeof(atomic_uchar[heap->capacity]));
+    heap->free_refs = map_table(sizeof(int32_t[heap->capacity]));
+}
+
+/** Reserves memory for a space, which the OS only provides once it is used */
+void map_space(space_t *space, size_t bytes, large_pages_t large_pages) {
+    void *start;
+    if (large_pages == LARGE_PAGES_NONE) {
+        start = mmap(NULL, bytes, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    }
+    else {
+        // The spaces grow a block at a time, so explicit huge pages, which must be
+        // reserved up front, would mostly go unused
+        start = map_huge_aligned(bytes);
+    }
+    assert(start != MAP_FAILED && "Failed to reserve heap");
+    space->start = start;
+    space->top = start;
+    space->end = space->start + bytes;
+}
+
+heap_t *heap_init(const heap_options_t *options) {
+    assert(options->young_size > 0 && options->max_size > 2 * options->young_size &&
+           "Maximum heap size is too small for the young generation");
+    assert(options->max_size - 2 * options->young_size <= UINT32_MAX &&
+           "Maximum heap size is too large");
+    assert(options->gc_threads > 0 && "No GC threads");
+    assert(options->pause_target >= 0 && "Negative pause target");
     heap_t *heap = malloc(sizeof(heap_t));
-    heap->ptr = NULL;
-    heap->count = 0;
+    assert(heap != NULL && "Failed to allocate heap");
+    map_reference_table(heap, options->max_size);
+    // Reserve the null reference so it never refers to an array
+    heap->ptr[NULL_REFERENCE] = NULL;
+    heap->count = 1;
+    heap->free_count = 0;
+
+    // The two halves of the young generation are adjacent
+    size_t young_size = options->young_size & ~(sizeof(int32_t) - 1);
+    map_space(&heap->young, 2 * young_size, options->large_pages);
+    heap->survivor.start = heap->young.start + young_size;
+    heap->survivor.top = heap->survivor.start;
+    heap->survivor.end = heap->young.end;
+    heap->young.end = heap->survivor.start;
+    heap->large_block_size = young_size / 4;
+    heap->tlab_size = (young_size / 16) & ~(sizeof(int32_t) - 1);
+    pthread_mutex_init(&heap->lock, NULL);
+    heap->tlabs = NULL;
+
+    size_t old_size = options->max_size - 2 * young_size;
+    map_space(&heap->old, old_size, options->large_pages);
+    heap->numa_nodes = options->numa ? count_nodes() : 0;
+    // Blocks are promoted by whichever thread collects, so no node owns them
+    if (heap->numa_nodes < 2 ||
+        !interleave_nodes(heap->old.start, old_size, heap->numa_nodes)) {
+        heap->numa_nodes = 0;
+    }
+    heap->numa_pinning = options->numa_pinning;
+    heap->pinned_threads = 0;
+    heap->old_limit = old_size < INITIAL_OLD_LIMIT ? old_size : INITIAL_OLD_LIMIT;
+    heap->min_old_limit = heap->old_limit;
+    heap->released_bytes = 0;
+    heap->mappings = NULL;
+    heap->mapped_bytes = 0;
+    for (size_t i = 0; i < MAPPING_CLASSES; i++) {
+        heap->free_mappings[i] = NULL;
+    }
+    heap->free_mapped_bytes = 0;
+    heap->reused_mappings = 0;
+    heap->large_pages = options->large_pages;
+    size_t cards = (old_size >> CARD_SHIFT) + 1;
+    heap->cards = calloc(cards, sizeof(uint8_t));
+    heap->card_blocks = calloc(cards, sizeof(uint32_t));
+    assert(heap->cards != NULL && heap->card_blocks != NULL &&
+           "Failed to allocate card table");
+
+    heap->frame_roots = (root_ranges_t){.ranges = NULL, .count = 0, .capacity = 0};
+    heap->global_roots = (root_ranges_t){.ranges = NULL, .count = 0, .capacity = 0};
+    heap->reference_map = NULL;
+    heap->reference_map_context = NULL;
+    heap->gc_threads = options->gc_threads;
+    heap->log = options->log;
+    clock_gettime(CLOCK_MONOTONIC, &heap->start_time);
+    heap->young_collections = 0;
+    heap->full_collections = 0;
+    heap->total_pause = 0;
+    heap->max_pause = 0;
+    heap->pause_target = options->pause_target;
+    heap->phase = GC_IDLE;
+    heap->allocated_since_increment = 0;
+    heap->gray = NULL;
+    heap->gray_count = 0;
+    heap->gray_capacity = 0;
+    heap->compact_position = NULL;
+    heap->compact_destination = NULL;
+    heap->site_names = NULL;
+    heap->site_names_context = NULL;
+    heap->dump_path = options->dump_path;
+    heap->dump_requested = 0;
+    heap_attach_thread(heap);
     return heap;
 }
 
-int32_t heap_add(heap_t *heap, int32_t *ptr) {
-    heap->ptr = realloc(heap->ptr, (heap->count + 1) * sizeof(int32_t *));
-    heap->ptr[heap->count] = ptr;
-    int32_t temp = heap->count;
-    heap->count += 1;
-    return temp;
+void heap_attach_thread(heap_t *heap) {
+    tlab_t *tlab = malloc(sizeof(tlab_t));
+    assert(tlab != NULL && "Failed to allocate allocation buffer");
+    tlab->top = NULL;
+    tlab->end = NULL;
+    tlab->refs_count = 0;
+    tlab->allocation_site = 0;
+    tlab->node = -1;
+    pthread_mutex_lock(&heap->lock);
+    tlab->next = heap->tlabs;
+    heap->tlabs = tlab;
+    int node = heap->pinned_threads % (heap->numa_nodes > 0 ? heap->numa_nodes : 1);
+    bool pin = heap->numa_nodes > 0 && heap->numa_pinning;
+    if (pin) {
+        heap->pinned_threads++;
+    }
+    pthread_mutex_unlock(&heap->lock);
+    if (pin && pin_to_node(node)) {
+        tlab->node = node;
+    }
+    thread_tlab = tlab;
+}
+
+/**
+ * Places memory the calling thread is about to allocate in on its NUMA node,
+ * if the heap places memory. Stops placing memory if the kernel refuses to,
+ * e.g. because it doesn't support NUMA policies.
+ * Must be called with the heap's lock held.
+ */
+void place_on_thread_node(heap_t *heap, void *start, size_t bytes) {
+    if (heap->numa_nodes == 0) {
+        return;
+    }
+    // Unpinned threads can move between nodes, so check where the thread is now
+    int node = thread_tlab->node >= 0 ? thread_tlab->node : current_node();
+    if (!bind_to_node(start, bytes, node)) {
+        heap->numa_nodes = 0;
+    }
+}
+
+/** Gives back the unused memory of a thread's allocation buffer */
+void retire_tlab(heap_t *heap, tlab_t *tlab) {
+    if (tlab->top == NULL) {
+        return;
+    }
+    // If no buffer was carved after this one, its memory can simply be reused
+    if (tlab->end + sizeof(block_t) == heap->young.top) {
+        heap->young.top = tlab->top;
+    }
+    else {
+        block_t *filler = (block_t *) tlab->top;
+        filler->ref = NULL_REFERENCE;
+        filler->size = (tlab->end - tlab->top) / sizeof(int32_t);
+        filler->kind = BLOCK_INTS;
+        filler->age = 0;
+        filler->site = 0;
+    }
+    tlab->top = NULL;
+    tlab->end = NULL;
+}
+
+void retire_tlabs(heap_t *heap) {
+    for (tlab_t *tlab = heap->tlabs; tlab != NULL; tlab = tlab->next) {
+        retire_tlab(heap, tlab);
+    }
+}
+
+void drop_tlab_references(heap_t *heap) {
+    for (tlab_t *tlab = heap->tlabs; tlab != NULL; tlab = tlab->next) {
+        tlab->refs_count = 0;
+    }
+}
+
+void heap_detach_thread(heap_t *heap) {
+    tlab_t *tlab = thread_tlab;
+    pthread_mutex_lock(&heap->lock);
+    retire_tlab(heap, tlab);
+    for (size_t i = 0; i < tlab->refs_count; i++) {
+        free_reference(heap, tlab->refs[i]);
+    }
+    tlab_t **link = &heap->tlabs;
+    while (*link != tlab) {
+        link = &(*link)->next;
+    }
+    *link = tlab->next;
+    pthread_mutex_unlock(&heap->lock);
+    free(tlab);
+    thread_tlab = NULL;
+}
+
+void heap_set_reference_map(heap_t *heap, reference_map_t map, void *context) {
+    heap->reference_map = map;
+    heap->reference_map_context = context;
+}
+
+void heap_set_site_names(heap_t *heap, site_names_t names, void *context) {
+    heap->site_names = names;
+    heap->site_names_context = context;
+}
+
+void heap_set_allocation_site(heap_t *heap, uint16_t site) {
+    (void) heap;
+    thread_tlab->allocation_site = site;
+}
+
+void record_old_block(heap_t *heap, block_t *block) {
+    size_t offset = (char *) block - heap->old.start;
+    size_t end = offset + block_bytes(block->size);
+    // The cards whose first bytes are in the block
+    size_t first_card = (offset + (1 << CARD_SHIFT) - 1) >> CARD_SHIFT;
+    size_t end_card = (end + (1 << CARD_SHIFT) - 1) >> CARD_SHIFT;
+    for (size_t card = first_card; card < end_card; card++) {
+        heap->card_blocks[card] = offset;
+    }
+}
+
+block_t *allocate_old_block(heap_t *heap, size_t bytes) {
+    // The mapped arrays share the old generation's part of the maximum heap size
+    size_t used = heap->old.top - heap->old.start + heap->mapped_bytes;
+    if ((size_t) (heap->old.end - heap->old.start) < used + bytes) {
+        return NULL;
+    }
+    block_t *block = (block_t *) heap->old.top;
+    heap->old.top += bytes;
+    block->size = (bytes - sizeof(block_t)) / sizeof(int32_t);
+    record_old_block(heap, block);
+    return block;
+}
+
+/** Gets the number of bytes of the mappings of a size class */
+size_t mapping_bytes(size_t size_class) {
+    return (size_t) sysconf(_SC_PAGESIZE) << size_class;
+}
+
+/**
+ * Maps the memory of a large array. Arrays that fill a huge page get huge pages
+ * if the heap uses them: explicit ones if there are enough free, and otherwise
+ * transparent ones.
+ *
+ * @return the memory, or NULL if it couldn't be mapped
+ */
+mapping_t *map_mapping(heap_t *heap, size_t bytes) {
+    void *start = MAP_FAILED;
+    if (heap->large_pages == LARGE_PAGES_NONE || bytes < HUGE_PAGE_SIZE) {
+        start = mmap(NULL, bytes, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        return start == MAP_FAILED ? NULL : start;
+    }
+    if (heap->large_pages == LARGE_PAGES_EXPLICIT) {
+        // Without MAP_NORESERVE, mmap() fails if too few huge pages are free,
+        // rather than the program crashing when it touches the array
+        start = mmap(NULL, bytes, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (start == MAP_FAILED) {
+            fprintf(stderr, "Too few huge pages are free; "
+                            "using transparent huge pages instead\n");
+            heap->large_pages = LARGE_PAGES_TRANSPARENT;
+        }
+    }
+    if (start == MAP_FAILED) {
+        start = map_huge_aligned(bytes);
+    }
+    return start == MAP_FAILED ? NULL : start;
+}
+
+/** Gets the size class of the smallest mapping that holds a block */
+size_t mapping_size_class(size_t bytes) {
+    size_t size_class = 0;
+    while (mapping_bytes(size_class) < sizeof(mapping_t) + bytes) {
+        size_class++;
+    }
+    assert(size_class < MAPPING_CLASSES && "Array too large");
+    return size_class;
+}
+
+block_t *allocate_mapped_block(heap_t *heap, size_t bytes) {
+    size_t size_class = mapping_size_class(bytes);
+    size_t mapped = mapping_bytes(size_class);
+    size_t used = heap->old.top - heap->old.start + heap->mapped_bytes;
+    if ((size_t) (heap->old.end - heap->old.start) < used + mapped) {
+        return NULL;
+    }
+    mapping_t *mapping = heap->free_mappings[size_class];
+    if (mapping != NULL) {
+        heap->free_mappings[size_class] = mapping->next;
+        heap->free_mapped_bytes -= mapped;
+        heap->reused_mappings++;
+    }
+    else {
+        mapping = map_mapping(heap, mapped);
+        if (mapping == NULL) {
+            return NULL;
+        }
+        mapping->size_class = size_class;
+    }
+    // A mapping that is reused can have been used on another node
+    place_on_thread_node(heap, mapping, mapped);
+    mapping->next = heap->mappings;
+    heap->mappings = mapping;
+    heap->mapped_bytes += mapped;
+    block_t *block = (block_t *) (mapping + 1);
+    block->size = (bytes - sizeof(block_t)) / sizeof(int32_t);
+    return block;
+}
+
+/** Checks whether a tenured block gets its own mapping */
+bool is_mapped_block(block_kind_t kind, size_t bytes) {
+    // Arrays of references stay in the old generation, where stores are carded
+    return kind == BLOCK_INTS && bytes >= MAPPED_BLOCK_SIZE;
+}
+
+/**
+ * Allocates a block outside the young generation: in a mapping of its own if
+ * it is a large int array, and otherwise in the old generation.
+ *
+ * @return the uninitialized block, or NULL if the heap is full
+ */
+block_t *allocate_tenured_block(heap_t *heap, block_kind_t kind, size_t bytes) {
+    if (is_mapped_block(kind, bytes)) {
+        return allocate_mapped_block(heap, bytes);
+    }
+    return allocate_old_block(heap, bytes);
+}
+
+void mark_card(heap_t *heap, const int32_t *address) {
+    heap->cards[((const char *) address - heap->old.start) >> CARD_SHIFT] = 1;
+}
+
+void free_reference(heap_t *heap, int32_t ref) {
+    heap->ptr[ref] = NULL;
+    heap->free_refs[heap->free_count] = ref;
+    heap->free_count++;
+}
+
+/**
+ * Reserves unused references for a thread's allocation buffer,
+ * reusing freed ones if there are any. Must be called with the heap's lock held.
+ */
+void reserve_references(heap_t *heap, tlab_t *tlab) {
+    while (tlab->refs_count < TLAB_REFERENCES / 2) {
+        int32_t ref;
+        if (heap->free_count > 0) {
+            heap->free_count--;
+            ref = heap->free_refs[heap->free_count];
+        }
+        else {
+            assert(heap->count < heap->capacity && "Too many objects");
+            ref = heap->count;
+            heap->count++;
+            // Reserved references aren't in use, so collections must skip them
+            heap->ptr[ref] = NULL;
+        }
+        tlab->refs[tlab->refs_count] = ref;
+        tlab->refs_count++;
+    }
+}
+
+/** Gets an unused reference from the calling thread's allocation buffer */
+int32_t new_reference(heap_t *heap) {
+    tlab_t *tlab = thread_tlab;
+    if (tlab->refs_count == 0) {
+        pthread_mutex_lock(&heap->lock);
+        reserve_references(heap, tlab);
+        pthread_mutex_unlock(&heap->lock);
+    }
+    tlab->refs_count--;
+    return tlab->refs[tlab->refs_count];
+}
+
+/**
+ * Gives a new block a reference and clears its payload.
+ *
+ * @param block the block, whose size and kind are set
+ * @return a reference to the payload
+ */
+int32_t add_block(heap_t *heap, block_t *block) {
+    block->age = 0;
+    // The site only applies to the allocation it was set for
+    tlab_t *tlab = thread_tlab;
+    block->site = tlab->allocation_site;
+    tlab->allocation_site = 0;
+    int32_t *payload = get_payload(block);
+    memset(payload, 0, sizeof(int32_t[block->size]));
+    block->ref = new_reference(heap);
+    heap->ptr[block->ref] = payload;
+    // Blocks allocated while marking are alive, so they are allocated marked
+    if (heap->phase == GC_MARKING || heap->phase == GC_SWEEPING) {
+        atomic_store_explicit(&heap->marks[block->ref], 1, memory_order_relaxed);
+    }
+    return block->ref;
+}
+
+/**
+ * Allocates a block that doesn't fit in the calling thread's allocation buffer,
+ * collecting garbage if needed. Blocks of at most a quarter of a buffer refill
+ * the buffer, and larger ones are allocated on their own.
+ * Must be called with the heap's lock held.
+ *
+ * @return the uninitialized block, whose size is set,
+ *   or NULL if it doesn't fit in the heap
+ */
+block_t *allocate_shared(heap_t *heap, tlab_t *tlab, block_kind_t kind, size_t bytes) {
+    if (heap->dump_requested) {
+        dump_requested_heap(heap);
+    }
+    bool refill = bytes <= heap->tlab_size / 4;
+    // A buffer needs room to fill its end, and its size counts as allocated
+    size_t needed = refill ? bytes + sizeof(block_t) : bytes;
+    size_t refill_size = heap->tlab_size;
+    if (heap->phase != GC_IDLE) {
+        // Keep the pace of the increments the same as without buffers
+        if (refill_size > INCREMENT_INTERVAL) {
+            refill_size = INCREMENT_INTERVAL < needed ? needed : INCREMENT_INTERVAL;
+        }
+        heap->allocated_since_increment += refill ? refill_size : bytes;
+        if (heap->allocated_since_increment >= INCREMENT_INTERVAL) {
+            heap->allocated_since_increment = 0;
+            collect_increment(heap);
+        }
+    }
+    bool large = bytes > heap->large_block_size;
+    if (!large && (size_t) (heap->young.end - heap->young.top) < needed) {
+        // Collecting retires the buffer, giving its memory back before it is copied
+        collect_young(heap);
+    }
+    block_t *block;
+    // The survivors of a young collection can leave too little room for the block
+    if (large || (size_t) (heap->young.end - heap->young.top) < needed) {
+        // A mapped block uses up the whole of its mapping
+        collect_old(heap, is_mapped_block(kind, bytes)
+                              ? mapping_bytes(mapping_size_class(bytes))
+                              : bytes);
+        block = allocate_tenured_block(heap, kind, bytes);
+        // An incremental collection may not have freed enough yet
+        if (block == NULL && heap->pause_target != 0) {
+            collect_full(heap);
+            block = allocate_tenured_block(heap, kind, bytes);
+        }
+        return block;
+    }
+    if (!refill) {
+        block = (block_t *) heap->young.top;
+        heap->young.top += bytes;
+    }
+    else {
+        // Retiring the old buffer can give back memory at the young generation's top
+        retire_tlab(heap, tlab);
+        size_t room = heap->young.end - heap->young.top;
+        block = (block_t *) heap->young.top;
+        heap->young.top += refill_size < room ? refill_size : room;
+        place_on_thread_node(heap, block, heap->young.top - (char *) block);
+        tlab->top = (char *) block + bytes;
+        tlab->end = heap->young.top - sizeof(block_t);
+    }
+    block->size = (bytes - sizeof(block_t)) / sizeof(int32_t);
+    return block;
+}
+
+/**
+ * Allocates a block whose payload is all 0s, collecting garbage if needed.
+ * Small blocks are allocated in the calling thread's allocation buffer,
+ * medium ones elsewhere in the young generation, and large ones directly
+ * in the old generation or a mapping, since copying them would be expensive.
+ *
+ * @param kind what the payload holds
+ * @param size the number of ints in the payload
+ * @return a reference to the payload, or NULL_REFERENCE if the block doesn't fit
+ */
+int32_t allocate(heap_t *heap, block_kind_t kind, uint32_t size) {
+    tlab_t *tlab = thread_tlab;
+    assert(tlab != NULL && "Thread isn't attached to the heap");
+    size_t bytes = block_bytes(size);
+    block_t *block;
+    if ((size_t) (tlab->end - tlab->top) >= bytes) {
+        block = (block_t *) tlab->top;
+        tlab->top += bytes;
+        block->size = size;
+    }
+    else {
+        pthread_mutex_lock(&heap->lock);
+        block = allocate_shared(heap, tlab, kind, bytes);
+        pthread_mutex_unlock(&heap->lock);
+        if (block == NULL) {
+            return NULL_REFERENCE;
+        }
+    }
+    block->kind = kind;
+    return add_block(heap, block);
+}
+
+int32_t heap_new_array(heap_t *heap, int32_t length) {
+    assert(length >= 0 && "Negative array size");
+    int32_t ref = allocate(heap, BLOCK_INTS, (uint32_t) length + 1);
+    if (ref != NULL_REFERENCE) {
+        heap->ptr[ref][0] = length;
+    }
+    return ref;
+}
+
+size_t heap_max_size(const heap_t *heap) {
+    return 2 * (size_t) (heap->young.end - heap->young.start) +
+           (size_t) (heap->old.end - heap->old.start);
+}
+
+size_t heap_array_memory_size(int32_t length) {
+    return block_bytes((uint32_t) length + 1) / sizeof(int32_t);
+}
+
+int32_t heap_new_array_in(heap_t *heap, int32_t *memory, int32_t length) {
+    assert(length >= 0 && "Negative array size");
+    // The block isn't in any space, so collections neither copy nor compact it
+    block_t *block = (block_t *) memory;
+    block->size = (uint32_t) length + 1;
+    block->kind = BLOCK_INTS;
+    int32_t ref = add_block(heap, block);
+    heap->ptr[ref][0] = length;
+    return ref;
+}
+
+void heap_free_array_in(heap_t *heap, int32_t ref) {
+    // Keep the reference for the thread's next allocation if there is room
+    tlab_t *tlab = thread_tlab;
+    if (tlab->refs_count < TLAB_REFERENCES) {
+        heap->ptr[ref] = NULL;
+        tlab->refs[tlab->refs_count] = ref;
+        tlab->refs_count++;
+        return;
+    }
+    pthread_mutex_lock(&heap->lock);
+    free_reference(heap, ref);
+    pthread_mutex_unlock(&heap->lock);
+}
+
+int32_t heap_new_reference_array(heap_t *heap, int32_t length) {
+    assert(length >= 0 && "Negative array size");
+    int32_t ref = allocate(heap, BLOCK_REFERENCES, (uint32_t) length + 1);
+    if (ref != NULL_REFERENCE) {
+        heap->ptr[ref][0] = length;
+    }
+    return ref;
+}
+
+int32_t heap_new_object(heap_t *heap, int32_t class_id, int32_t size) {
+    assert(size >= 1 && "Object has no header");
+    int32_t ref = allocate(heap, BLOCK_OBJECT, size);
+    if (ref != NULL_REFERENCE) {
+        heap->ptr[ref][0] = class_id;
+    }
+    return ref;
 }
 
 int32_t *heap_get(heap_t *heap, int32_t ref) {
     return heap->ptr[ref];
 }
 
+void heap_store_reference(heap_t *heap, int32_t ref, int32_t index, int32_t value) {
+    int32_t *payload = heap->ptr[ref];
+    // The overwritten reference was reachable when marking started
+    if (heap->phase == GC_MARKING) {
+        shade(heap, payload[index]);
+    }
+    payload[index] = value;
+    // Only references from the old generation to the young generation are recorded
+    if (value != NULL_REFERENCE && in_space(&heap->old, payload) &&
+        !in_space(&heap->old, heap->ptr[value])) {
+        mark_card(heap, &payload[index]);
+    }
+}
+
+void heap_overwrite_barrier_range(heap_t *heap, int32_t ref, int32_t index,
+                                  int32_t count) {
+    int32_t *payload = heap->ptr[ref];
+    if (heap->phase != GC_MARKING || get_block(payload)->kind == BLOCK_INTS) {
+        return;
+    }
+    for (int32_t i = index; i < index + count; i++) {
+        shade(heap, payload[i]);
+    }
+}
+
+void heap_write_barrier_range(heap_t *heap, int32_t ref, int32_t index, int32_t count) {
+    int32_t *payload = heap->ptr[ref];
+    if (get_block(payload)->kind == BLOCK_INTS || !in_space(&heap->old, payload)) {
+        return;
+    }
+    for (int32_t i = index; i < index + count; i++) {
+        if (payload[i] != NULL_REFERENCE &&
+            !in_space(&heap->old, heap->ptr[payload[i]])) {
+            mark_card(heap, &payload[i]);
+        }
+    }
+}
+
+/** Adds a range of ints to a list of root ranges */
+void add_root_range(root_ranges_t *list, int32_t *roots, size_t count) {
+    if (list->count == list->capacity) {
+        list->capacity = list->capacity == 0 ? 64 : 2 * list->capacity;
+        list->ranges = realloc(list->ranges, sizeof(root_range_t[list->capacity]));
+        assert(list->ranges != NULL && "Failed to allocate roots");
+    }
+    list->ranges[list->count] = (root_range_t){.roots = roots, .count = count};
+    list->count++;
+}
+
+void heap_push_roots(heap_t *heap, int32_t *roots, size_t count) {
+    add_root_range(&heap->frame_roots, roots, count);
+}
+
+void heap_pop_roots(heap_t *heap, size_t ranges) {
+    assert(ranges <= heap->frame_roots.count && "Popped more roots than were pushed");
+    heap->frame_roots.count -= ranges;
+}
+
+void heap_add_global_roots(heap_t *heap, int32_t *roots, size_t count) {
+    add_root_range(&heap->global_roots, roots, count);
+}
+
+void heap_print_stats(const heap_t *heap, FILE *stream) {
+    fprintf(stream, "gc: %zu young collections, %zu full collections\n",
+            heap->young_collections, heap->full_collections);
+    fprintf(stream, "gc pauses: %.3f ms total, %.3f ms longest\n", heap->total_pause,
+            heap->max_pause);
+    fprintf(stream, "gc old generation: %zuK used, %zuK returned to the OS\n",
+            (size_t) (heap->old.top - heap->old.start) >> 10, heap->released_bytes >> 10);
+    fprintf(stream, "gc mapped arrays: %zuK used, %zu reused a free mapping\n",
+            heap->mapped_bytes >> 10, heap->reused_mappings);
+    if (heap->numa_nodes > 0) {
+        fprintf(stream, "gc NUMA nodes: %zu\n", heap->numa_nodes);
+    }
+}
+
 void heap_free(heap_t *heap) {
-    for (int32_t i = 0; i < heap->count; i++) {
-        free(heap->ptr[i]);
+    munmap(heap->young.start < heap->survivor.start ? heap->young.start
+                                                    : heap->survivor.start,
+           (heap->young.end - heap->young.start) * 2);
+    munmap(heap->old.start, heap->old.end - heap->old.start);
+    for (mapping_t *mapping = heap->mappings; mapping != NULL;) {
+        mapping_t *next = mapping->next;
+        munmap(mapping, mapping_bytes(mapping->size_class));
+        mapping = next;
+    }
+    for (size_t i = 0; i < MAPPING_CLASSES; i++) {
+        for (mapping_t *mapping = heap->free_mappings[i]; mapping != NULL;) {
+            mapping_t *next = mapping->next;
+            munmap(mapping, mapping_bytes(i));
+            mapping = next;
+        }
     }
-    free(heap->ptr);
+    free(heap->cards);
+    free(heap->card_blocks);
+    munmap(heap->ptr, sizeof(int32_t *[heap->capacity]));
+    munmap((void *) heap->marks, sizeof(atomic_uchar[heap->capacity]));
+    munmap(heap->free_refs, sizeof(int32_t[heap->capacity]));
+    free(heap->gray);
+    free(heap->frame_roots.ranges);
+    free(heap->global_roots.ranges);
+    for (tlab_t *tlab = heap->tlabs; tlab != NULL;) {
+        tlab_t *next = tlab->next;
+        free(tlab);
+        tlab = next;
+    }
+    thread_tlab = NULL;
+    pthread_mutex_destroy(&heap->lock);
     free(heap);
-}
\ No newline at end of file
+}
@@ -2,28 +2,214 @@
 #define HEAP_H
 
 #include <inttypes.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
 
 /**
- * Represents the array of pointers to heap-allocated int32_t arrays.
+ * The reference representing Java's null.
+ * heap_init() reserves it, so no array is ever given this reference.
+ */
+#define NULL_REFERENCE 0
+
+/**
+ * The garbage-collected heap of objects and arrays.
+ * A reference is an index into the heap's table of pointers to objects and
+ * arrays, so the collector can move an object by updating its table entry,
+ * without finding and updating the references to it.
+ *
+ * There are two generations. New objects and arrays are allocated in the young
+ * generation, where most of them die; young collections copy the survivors out,
+ * so they cost time in proportion to the live young data. Objects and arrays
+ * that survive a few young collections, and large arrays, are moved to the old
+ * generation, which full collections mark and then compact, either all at once
+ * or in increments that keep each pause short. Large int arrays are instead
+ * given mappings of their own, which are reused for other arrays once they die.
  */
 typedef struct heap heap_t;
 
+/** Which pages larger than the OS's default back the heap */
+typedef enum {
+    /** Only default-sized pages */
+    LARGE_PAGES_NONE,
+    /**
+     * Transparent huge pages: the heap is aligned to huge pages and the kernel is
+     * asked to back it with them, which it does if it has them to spare
+     */
+    LARGE_PAGES_TRANSPARENT,
+    /**
+     * Explicit huge pages (see /proc/sys/vm/nr_hugepages) for the large arrays
+     * that fill them, and transparent huge pages for the rest of the heap and
+     * once too few explicit huge pages are free
+     */
+    LARGE_PAGES_EXPLICIT,
+} large_pages_t;
+
+/** The sizes of the heap's generations */
+typedef struct {
+    /** The number of bytes in each of the young generation's two halves */
+    size_t young_size;
+    /** The maximum number of bytes in the whole heap */
+    size_t max_size;
+    /** The most threads to mark and sweep the heap on, including the program's */
+    size_t gc_threads;
+    /**
+     * Where to log how long each collection pauses the program and how much
+     * memory it frees, one line per pause, or NULL
+     */
+    FILE *log;
+    /**
+     * If nonzero, full collections are done in increments between allocations,
+     * each of which should pause the program for at most this many ms
+     */
+    double pause_target;
+    /** Where heap_request_dump() writes heap dumps, or NULL to ignore requests */
+    const char *dump_path;
+    /** Whether to back the heap with huge pages, so large arrays miss the TLB less */
+    large_pages_t large_pages;
+    /**
+     * Whether to place each thread's allocation buffers and large arrays on the
+     * NUMA node it runs on, and spread the old generation across the nodes.
+     * Ignored on machines with a single node.
+     */
+    bool numa;
+    /** Whether to pin each attached thread to a NUMA node, taking turns between them */
+    bool numa_pinning;
+} heap_options_t;
+
+/** The sizes used unless the command line overrides them */
+extern const heap_options_t DEFAULT_HEAP_OPTIONS;
+
+/**
+ * Initializes an empty heap.
+ *
+ * @param options the sizes of the heap's generations
+ */
+heap_t *heap_init(const heap_options_t *options);
+
+/**
+ * Gives the calling thread an allocation buffer, a part of the young generation
+ * it allocates small objects and arrays in without taking the heap's lock.
+ * Each thread must be attached before it allocates, except for the thread that
+ * called heap_init(), which already is. Collections run on the thread that runs
+ * out of room, so the other threads must not use the heap while it collects.
+ */
+void heap_attach_thread(heap_t *heap);
+
+/**
+ * Gives back the calling thread's allocation buffer.
+ * Must be called before the thread exits if it was attached.
+ */
+void heap_detach_thread(heap_t *heap);
+
+/**
+ * Finds the slots of a class's objects that hold references, so the collector
+ * can follow them. Slot 0 is the object's header.
+ *
+ * @param context the context passed to heap_set_reference_map()
+ * @param class_id the id of the objects' class
+ * @param count set to the number of slots
+ * @return the indices of the slots
+ */
+typedef const uint16_t *(*reference_map_t)(void *context, int32_t class_id,
+                                            uint16_t *count);
+
+/**
+ * Sets the function the collector uses to find references in objects.
+ */
+void heap_set_reference_map(heap_t *heap, reference_map_t map, void *context);
+
+/**
+ * Names an allocation site in heap dumps, e.g. "Foo.bar()V:12".
+ *
+ * @param context the context passed to heap_set_site_names()
+ * @param site the site, which isn't 0
+ * @return the site's name, which must stay allocated until the dump is written
+ */
+typedef const char *(*site_names_t)(void *context, uint16_t site);
+
+/**
+ * Sets the function heap dumps use to name the allocation sites of blocks.
+ */
+void heap_set_site_names(heap_t *heap, site_names_t names, void *context);
+
 /**
- * Initializes a heap. The capacity of this heap is initially zero.
+ * Sets the allocation site recorded for the next object or array the calling
+ * thread allocates, which heap dumps report. Allocations made without setting
+ * a site, e.g. by the VM itself, have site 0.
+ *
+ * @param site an identifier of the instruction about to allocate
  */
-heap_t *heap_init();
+void heap_set_allocation_site(heap_t *heap, uint16_t site);
 
 /**
- * Add a pointer to the heap and get a reference. For simplification, the
- * reference is an index into a generic heap-allocated array.
+ * Allocate a one-dimensional array of ints whose elements are all 0 and add it
+ * to the heap. The array's length is stored before its elements.
  *
- * @param ptr Pointer of an int32_t array to add to the heap.
- * @returns A "reference" to the pointer.
+ * @param length the number of elements in the array
+ * @returns A "reference" to the new array, or NULL_REFERENCE if it doesn't fit
+ *   in the heap even after collecting garbage.
  */
-int32_t heap_add(heap_t *heap, int32_t *ptr);
+int32_t heap_new_array(heap_t *heap, int32_t length);
+
+/**
+ * Allocate a one-dimensional array of references whose elements are all null.
+ * Like an int array, its length is stored before its elements.
+ *
+ * @param length the number of elements in the array
+ * @returns A "reference" to the new array, or NULL_REFERENCE if it doesn't fit
+ *   in the heap even after collecting garbage.
+ */
+int32_t heap_new_reference_array(heap_t *heap, int32_t length);
+
+/**
+ * Gets the most bytes the heap's objects and arrays can take up,
+ * the `max_size` option it was created with.
+ */
+size_t heap_max_size(const heap_t *heap);
+
+/**
+ * Gets the number of ints of memory heap_new_array_in() needs for an array.
+ *
+ * @param length the number of elements in the array
+ */
+size_t heap_array_memory_size(int32_t length);
+
+/**
+ * Allocate a one-dimensional array of ints like heap_new_array(), but in memory
+ * the caller provides, e.g. a frame's, instead of the heap's spaces.
+ * The collector never moves the array. The caller must keep the reference
+ * registered as a root until it frees the array with heap_free_array_in().
+ *
+ * @param memory heap_array_memory_size() ints, which must stay allocated
+ *   until the array is freed
+ * @param length the number of elements in the array
+ * @returns A "reference" to the new array.
+ */
+int32_t heap_new_array_in(heap_t *heap, int32_t *memory, int32_t length);
+
+/**
+ * Frees an array allocated by heap_new_array_in(), so its memory can be reused.
+ *
+ * @param ref the array
+ */
+void heap_free_array_in(heap_t *heap, int32_t ref);
+
+/**
+ * Allocate an object whose fields are all 0 and add it to the heap.
+ * The object's first int is a header identifying its class.
+ *
+ * @param class_id the id of the object's class, which is stored in the header
+ * @param size the number of ints in the object, including the header
+ * @returns A "reference" to the new object, or NULL_REFERENCE if it doesn't fit
+ *   in the heap even after collecting garbage.
+ */
+int32_t heap_new_object(heap_t *heap, int32_t class_id, int32_t size);
 
 /**
  * Retrieve a pointer from the heap.
+ * Allocating can move objects and arrays, so the pointer is only valid
+ * until the next allocation.
  *
  * @param ref A "reference".
  * @returns A pointer to an int32_t array from the heap.
@@ -31,10 +217,97 @@ int32_t heap_add(heap_t *heap, int32_t *ptr);
 int32_t *heap_get(heap_t *heap, int32_t ref);
 
 /**
- * Frees elements of the heap-allocated int32_t arrays.
+ * Stores a reference in an object's field or an array's element.
+ * Unlike storing through heap_get(), this records the store for the collector
+ * (a write barrier), which must know about references from old to young data.
+ *
+ * @param ref the object or array to store into
+ * @param index the index of the int to store into, e.g. 1 for an array's first element
+ * @param value the reference to store
+ */
+void heap_store_reference(heap_t *heap, int32_t ref, int32_t index, int32_t value);
+
+/**
+ * Records that references are about to be overwritten in a range of an array's
+ * elements without heap_store_reference(), e.g. by copying over them from
+ * another array. Must be called before the store, and heap_write_barrier_range()
+ * after it. Does nothing if the array holds ints.
+ *
+ * @param ref the array
+ * @param index the index of the first int to be stored into
+ * @param count the number of ints to be stored into
+ */
+void heap_overwrite_barrier_range(heap_t *heap, int32_t ref, int32_t index,
+                                  int32_t count);
+
+/**
+ * Records that references were stored into a range of an array's elements
+ * without heap_store_reference(), e.g. by copying them from another array.
+ * Does nothing if the array holds ints.
+ *
+ * @param ref the array
+ * @param index the index of the first int stored into
+ * @param count the number of ints stored into
+ */
+void heap_write_barrier_range(heap_t *heap, int32_t ref, int32_t index, int32_t count);
+
+/**
+ * Registers ints that may hold references which keep objects and arrays alive,
+ * e.g. a frame's local variables. Any int that is a valid reference is treated
+ * as one, so the ints don't need to be known to be references.
+ * Ranges are registered and unregistered in stack order, like frames.
+ *
+ * @param roots the ints, which must stay allocated until they're unregistered
+ * @param count the number of ints
+ */
+void heap_push_roots(heap_t *heap, int32_t *roots, size_t count);
+
+/**
+ * Unregisters the ranges of ints registered most recently with heap_push_roots().
+ *
+ * @param ranges the number of ranges to unregister
+ */
+void heap_pop_roots(heap_t *heap, size_t ranges);
+
+/**
+ * Registers ints that may hold references for as long as the heap exists,
+ * e.g. a class's static fields.
+ *
+ * @param roots the ints, which must stay allocated as long as the heap
+ * @param count the number of ints
+ */
+void heap_add_global_roots(heap_t *heap, int32_t *roots, size_t count);
+
+/**
+ * Prints how many collections of each generation have run,
+ * and how long they paused the program.
+ */
+void heap_print_stats(const heap_t *heap, FILE *stream);
+
+/**
+ * Collects garbage, then writes every live object and array to a file, along
+ * with the roots that keep them alive, in the format described in heap_dump.h.
+ */
+void heap_dump(heap_t *heap, FILE *stream);
+
+/**
+ * Asks for a heap dump to be written to the `dump_path` option at the next
+ * allocation, when the heap is in a consistent state.
+ * Only sets a flag, so it can be called from a signal handler.
+ */
+void heap_request_dump(heap_t *heap);
+
+/**
+ * Writes a heap dump to the `dump_path` option right away, e.g. when the
+ * program exits. Must not be called while another thread is allocating.
+ */
+void heap_dump_now(heap_t *heap);
+
+/**
+ * Frees the heap, including all objects and arrays.
  *
- * @param heap array of heap-allocated pointers
+ * @param heap the heap
  */
 void heap_free(heap_t *heap);
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,370 @@
+/*
+ * Reports what a heap dump written by the JVM (see heap_dump.h) holds:
+ * the largest arrays, a histogram of the blocks' sizes, the allocation sites
+ * that allocated the most, and how much memory each range of roots retains.
+ *
+ * Usage: heap_analyze <heap dump>
+ */
+
+#include <assert.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "heap_dump.h"
+
+/** How many entries each ranked report lists */
+#define REPORT_ENTRIES 10
+
+/** The number of power-of-2 size classes in the histogram */
+#define SIZE_CLASSES 32
+
+/** An object or array in the dump */
+typedef struct {
+    int32_t ref;
+    /** 0 for an int array, 1 for an array of references, 2 for an object */
+    uint8_t kind;
+    uint16_t site;
+    /** The array's length, or the object's class id */
+    int32_t length;
+    uint32_t bytes;
+    /** The references the block holds, in `dump_t.refs` */
+    size_t refs_start;
+    uint32_t refs_count;
+} dump_block_t;
+
+/** A root of the dump */
+typedef struct {
+    dump_root_kind_t kind;
+    uint32_t range;
+    int32_t ref;
+} dump_root_t;
+
+/** The contents of a heap dump */
+typedef struct {
+    dump_block_t *blocks;
+    size_t blocks_count;
+    /** The references held by all the blocks */
+    int32_t *refs;
+    size_t refs_count;
+    dump_root_t *roots;
+    size_t roots_count;
+    /** The name of each allocation site, or NULL */
+    char *site_names[UINT16_MAX + 1];
+    /** The index in `blocks` of each reference's block, or -1 */
+    int64_t *block_index;
+    int32_t max_ref;
+} dump_t;
+
+void read_bytes(FILE *file, void *bytes, size_t size) {
+    size_t read = fread(bytes, 1, size, file);
+    assert(read == size && "Truncated heap dump");
+}
+
+uint8_t read_u1(FILE *file) {
+    uint8_t value;
+    read_bytes(file, &value, sizeof(value));
+    return value;
+}
+
+uint16_t read_u2(FILE *file) {
+    uint16_t value;
+    read_bytes(file, &value, sizeof(value));
+    return value;
+}
+
+uint32_t read_u4(FILE *file) {
+    uint32_t value;
+    read_bytes(file, &value, sizeof(value));
+    return value;
+}
+
+int32_t read_i4(FILE *file) {
+    int32_t value;
+    read_bytes(file, &value, sizeof(value));
+    return value;
+}
+
+/** Grows an array by one element if it is full, doubling its capacity */
+void *grow(void *array, size_t count, size_t *capacity, size_t element_size) {
+    if (count < *capacity) {
+        return array;
+    }
+    *capacity = *capacity == 0 ? 1024 : 2 * *capacity;
+    array = realloc(array, *capacity * element_size);
+    assert(array != NULL && "Failed to allocate heap dump");
+    return array;
+}
+
+/** Reads a heap dump's records */
+void read_dump(FILE *file, dump_t *dump) {
+    char magic[sizeof(HEAP_DUMP_MAGIC) - 1];
+    read_bytes(file, magic, sizeof(magic));
+    assert(memcmp(magic, HEAP_DUMP_MAGIC, sizeof(magic)) == 0 && "Not a heap dump");
+    uint32_t version = read_u4(file);
+    assert(version == HEAP_DUMP_VERSION && "Unsupported heap dump version");
+
+    size_t blocks_capacity = 0;
+    size_t refs_capacity = 0;
+    size_t roots_capacity = 0;
+    for (uint8_t tag = read_u1(file); tag != DUMP_END; tag = read_u1(file)) {
+        switch (tag) {
+            case DUMP_BLOCK: {
+                dump->blocks = grow(dump->blocks, dump->blocks_count, &blocks_capacity,
+                                    sizeof(dump_block_t));
+                dump_block_t *block = &dump->blocks[dump->blocks_count];
+                dump->blocks_count++;
+                block->ref = read_i4(file);
+                block->kind = read_u1(file);
+                block->site = read_u2(file);
+                block->length = read_i4(file);
+                block->bytes = read_u4(file);
+                block->refs_start = dump->refs_count;
+                block->refs_count = read_u4(file);
+                for (uint32_t i = 0; i < block->refs_count; i++) {
+                    dump->refs = grow(dump->refs, dump->refs_count, &refs_capacity,
+                                      sizeof(int32_t));
+                    dump->refs[dump->refs_count] = read_i4(file);
+                    dump->refs_count++;
+                }
+                if (block->ref > dump->max_ref) {
+                    dump->max_ref = block->ref;
+                }
+                break;
+            }
+            case DUMP_ROOT: {
+                dump->roots = grow(dump->roots, dump->roots_count, &roots_capacity,
+                                   sizeof(dump_root_t));
+                dump_root_t *root = &dump->roots[dump->roots_count];
+                dump->roots_count++;
+                root->kind = read_u1(file);
+                root->range = read_u4(file);
+                root->ref = read_i4(file);
+                break;
+            }
+            case DUMP_SITE: {
+                uint16_t site = read_u2(file);
+                uint16_t length = read_u2(file);
+                char *name = malloc(length + 1);
+                assert(name != NULL && "Failed to allocate site name");
+                read_bytes(file, name, length);
+                name[length] = '\0';
+                free(dump->site_names[site]);
+                dump->site_names[site] = name;
+                break;
+            }
+            default:
+                assert(false && "Unknown heap dump record");
+        }
+    }
+
+    dump->block_index = malloc(sizeof(int64_t[dump->max_ref + 1]));
+    assert(dump->block_index != NULL && "Failed to allocate heap dump");
+    for (int32_t ref = 0; ref <= dump->max_ref; ref++) {
+        dump->block_index[ref] = -1;
+    }
+    for (size_t i = 0; i < dump->blocks_count; i++) {
+        dump->block_index[dump->blocks[i].ref] = i;
+    }
+}
+
+/** Gets the block a reference refers to, or NULL if it isn't in the dump */
+dump_block_t *find_block(const dump_t *dump, int32_t ref) {
+    if (ref <= 0 || ref > dump->max_ref || dump->block_index[ref] < 0) {
+        return NULL;
+    }
+    return &dump->blocks[dump->block_index[ref]];
+}
+
+const char *site_name(const dump_t *dump, uint16_t site) {
+    return dump->site_names[site] == NULL ? "unknown" : dump->site_names[site];
+}
+
+/** Orders blocks by size, largest first */
+int compare_blocks(const void *a, const void *b) {
+    const dump_block_t *block_a = *(const dump_block_t *const *) a;
+    const dump_block_t *block_b = *(const dump_block_t *const *) b;
+    return (block_a->bytes < block_b->bytes) - (block_a->bytes > block_b->bytes);
+}
+
+void print_largest_arrays(const dump_t *dump) {
+    dump_block_t **arrays = malloc(sizeof(dump_block_t *[dump->blocks_count + 1]));
+    assert(arrays != NULL && "Failed to allocate report");
+    size_t count = 0;
+    for (size_t i = 0; i < dump->blocks_count; i++) {
+        if (dump->blocks[i].kind != 2) {
+            arrays[count] = &dump->blocks[i];
+            count++;
+        }
+    }
+    qsort(arrays, count, sizeof(dump_block_t *), compare_blocks);
+    printf("Largest arrays:\n");
+    for (size_t i = 0; i < count && i < REPORT_ENTRIES; i++) {
+        printf("  ref=%" PRId32 " type=%s length=%" PRId32 " bytes=%" PRIu32 " site=%s\n",
+               arrays[i]->ref, arrays[i]->kind == 0 ? "int[]" : "reference[]",
+               arrays[i]->length, arrays[i]->bytes, site_name(dump, arrays[i]->site));
+    }
+    free(arrays);
+}
+
+void print_size_histogram(const dump_t *dump) {
+    uint64_t counts[SIZE_CLASSES] = {0};
+    uint64_t bytes[SIZE_CLASSES] = {0};
+    for (size_t i = 0; i < dump->blocks_count; i++) {
+        // The class of blocks of at most 2^n bytes
+        size_t size_class = 0;
+        while (size_class < SIZE_CLASSES - 1 &&
+               (uint64_t) 1 << size_class < dump->blocks[i].bytes) {
+            size_class++;
+        }
+        counts[size_class]++;
+        bytes[size_class] += dump->blocks[i].bytes;
+    }
+    printf("Histogram by size:\n");
+    for (size_t i = 0; i < SIZE_CLASSES; i++) {
+        if (counts[i] > 0) {
+            printf("  up_to_bytes=%" PRIu64 " blocks=%" PRIu64 " bytes=%" PRIu64 "\n",
+                   (uint64_t) 1 << i, counts[i], bytes[i]);
+        }
+    }
+}
+
+/** The blocks and bytes attributed to an allocation site or a range of roots */
+typedef struct {
+    const char *name;
+    uint32_t index;
+    uint64_t blocks;
+    uint64_t bytes;
+} total_t;
+
+/** Orders totals by bytes, most first */
+int compare_totals(const void *a, const void *b) {
+    const total_t *total_a = a;
+    const total_t *total_b = b;
+    return (total_a->bytes < total_b->bytes) - (total_a->bytes > total_b->bytes);
+}
+
+void print_sites(const dump_t *dump) {
+    total_t *totals = calloc(UINT16_MAX + 1, sizeof(total_t));
+    assert(totals != NULL && "Failed to allocate report");
+    for (size_t i = 0; i < dump->blocks_count; i++) {
+        total_t *total = &totals[dump->blocks[i].site];
+        total->name = site_name(dump, dump->blocks[i].site);
+        total->blocks++;
+        total->bytes += dump->blocks[i].bytes;
+    }
+    qsort(totals, UINT16_MAX + 1, sizeof(total_t), compare_totals);
+    printf("Allocation sites:\n");
+    for (size_t i = 0; i < REPORT_ENTRIES && totals[i].blocks > 0; i++) {
+        printf("  site=%s blocks=%" PRIu64 " bytes=%" PRIu64 "\n", totals[i].name,
+               totals[i].blocks, totals[i].bytes);
+    }
+    free(totals);
+}
+
+/**
+ * Attributes each block to the first range of roots it is reachable from,
+ * looking at the global roots first, then the frames from the outermost,
+ * so a block kept alive by several ranges is counted for the longest-lived.
+ */
+void print_retention(const dump_t *dump) {
+    uint32_t ranges = 0;
+    for (size_t i = 0; i < dump->roots_count; i++) {
+        if (dump->roots[i].range + 1 > ranges) {
+            ranges = dump->roots[i].range + 1;
+        }
+    }
+    // The frame ranges' totals follow the global ranges'
+    total_t *totals = calloc(2 * (size_t) ranges + 1, sizeof(total_t));
+    bool *reached = calloc(dump->blocks_count + 1, sizeof(bool));
+    dump_block_t **stack = malloc(sizeof(dump_block_t *[dump->blocks_count + 1]));
+    assert(totals != NULL && reached != NULL && stack != NULL &&
+           "Failed to allocate report");
+    for (uint32_t range = 0; range < ranges; range++) {
+        totals[range] = (total_t){.name = "global", .index = range};
+        totals[ranges + range] = (total_t){.name = "frame", .index = range};
+    }
+    dump_root_kind_t kinds[] = {DUMP_GLOBAL_ROOT, DUMP_FRAME_ROOT};
+    for (size_t k = 0; k < 2; k++) {
+        for (size_t i = 0; i < dump->roots_count; i++) {
+            const dump_root_t *root = &dump->roots[i];
+            if (root->kind != kinds[k]) {
+                continue;
+            }
+            size_t index = (root->kind == DUMP_FRAME_ROOT) * ranges + root->range;
+            total_t *total = &totals[index];
+            size_t count = 0;
+            dump_block_t *block = find_block(dump, root->ref);
+            if (block != NULL && !reached[block - dump->blocks]) {
+                reached[block - dump->blocks] = true;
+                stack[count] = block;
+                count++;
+            }
+            while (count > 0) {
+                count--;
+                block = stack[count];
+                total->blocks++;
+                total->bytes += block->bytes;
+                for (uint32_t j = 0; j < block->refs_count; j++) {
+                    dump_block_t *child =
+                        find_block(dump, dump->refs[block->refs_start + j]);
+                    if (child != NULL && !reached[child - dump->blocks]) {
+                        reached[child - dump->blocks] = true;
+                        stack[count] = child;
+                        count++;
+                    }
+                }
+            }
+        }
+    }
+    qsort(totals, 2 * (size_t) ranges, sizeof(total_t), compare_totals);
+    printf("Retained by roots:\n");
+    for (size_t i = 0; i < REPORT_ENTRIES && i < 2 * (size_t) ranges; i++) {
+        if (totals[i].blocks > 0) {
+            printf("  roots=%s range=%" PRIu32 " blocks=%" PRIu64 " bytes=%" PRIu64 "\n",
+                   totals[i].name, totals[i].index, totals[i].blocks, totals[i].bytes);
+        }
+    }
+    free(totals);
+    free(reached);
+    free(stack);
+}
+
+int main(int argc, char *argv[]) {
+    if (argc != 2) {
+        fprintf(stderr, "USAGE: %s <heap dump>\n", argv[0]);
+        return 1;
+    }
+    FILE *file = fopen(argv[1], "rb");
+    if (file == NULL) {
+        perror(argv[1]);
+        return 1;
+    }
+    dump_t *dump = calloc(1, sizeof(dump_t));
+    assert(dump != NULL && "Failed to allocate heap dump");
+    read_dump(file, dump);
+    fclose(file);
+
+    uint64_t bytes = 0;
+    for (size_t i = 0; i < dump->blocks_count; i++) {
+        bytes += dump->blocks[i].bytes;
+    }
+    printf("Heap: blocks=%zu bytes=%" PRIu64 " roots=%zu\n", dump->blocks_count, bytes,
+           dump->roots_count);
+    print_largest_arrays(dump);
+    print_size_histogram(dump);
+    print_sites(dump);
+    print_retention(dump);
+
+    free(dump->blocks);
+    free(dump->refs);
+    free(dump->roots);
+    free(dump->block_index);
+    for (size_t site = 0; site <= UINT16_MAX; site++) {
+        free(dump->site_names[site]);
+    }
+    free(dump);
+    return 0;
+}
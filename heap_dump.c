@@ -0,0 +1,148 @@
+#include "heap_dump.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "gc.h"
+
+/** The non-null references a block holds, which add_reference() collects */
+typedef struct {
+    int32_t *refs;
+    size_t count;
+    size_t capacity;
+} reference_list_t;
+
+/** Adds the reference in a slot to a `reference_list_t`, if it isn't null */
+void add_reference(heap_t *heap, int32_t *slot, void *arg) {
+    (void) heap;
+    reference_list_t *list = arg;
+    if (*slot == NULL_REFERENCE) {
+        return;
+    }
+    if (list->count == list->capacity) {
+        list->capacity = list->capacity == 0 ? 64 : 2 * list->capacity;
+        list->refs = realloc(list->refs, sizeof(int32_t[list->capacity]));
+        assert(list->refs != NULL && "Failed to allocate heap dump");
+    }
+    list->refs[list->count] = *slot;
+    list->count++;
+}
+
+/*
+ * Write errors are checked once the dump is done, with ferror(),
+ * so a failed dump doesn't stop the program.
+ */
+
+void dump_u1(FILE *stream, uint8_t value) {
+    fwrite(&value, sizeof(value), 1, stream);
+}
+
+void dump_u2(FILE *stream, uint16_t value) {
+    fwrite(&value, sizeof(value), 1, stream);
+}
+
+void dump_u4(FILE *stream, uint32_t value) {
+    fwrite(&value, sizeof(value), 1, stream);
+}
+
+void dump_i4(FILE *stream, int32_t value) {
+    fwrite(&value, sizeof(value), 1, stream);
+}
+
+/** Writes a DUMP_ROOT record for each int of a list of ranges that is a reference */
+void write_roots(heap_t *heap, const root_ranges_t *list, dump_root_kind_t kind,
+                 FILE *stream) {
+    for (size_t i = 0; i < list->count; i++) {
+        const root_range_t *range = &list->ranges[i];
+        for (size_t j = 0; j < range->count; j++) {
+            if (is_reference(heap, range->roots[j])) {
+                dump_u1(stream, DUMP_ROOT);
+                dump_u1(stream, kind);
+                dump_u4(stream, i);
+                dump_i4(stream, range->roots[j]);
+            }
+        }
+    }
+}
+
+void heap_dump(heap_t *heap, FILE *stream) {
+    // Only the blocks that are still reachable are dumped
+    collect_full(heap);
+    fwrite(HEAP_DUMP_MAGIC, 1, sizeof(HEAP_DUMP_MAGIC) - 1, stream);
+    dump_u4(stream, HEAP_DUMP_VERSION);
+
+    // Remember which sites the blocks were allocated at, to name them afterwards
+    bool *used_sites = calloc(UINT16_MAX + 1, sizeof(bool));
+    assert(used_sites != NULL && "Failed to allocate heap dump");
+    reference_list_t list = {.refs = NULL, .count = 0, .capacity = 0};
+    for (int32_t ref = NULL_REFERENCE + 1; ref < heap->count; ref++) {
+        int32_t *payload = heap->ptr[ref];
+        if (payload == NULL) {
+            continue;
+        }
+        block_t *block = get_block(payload);
+        list.count = 0;
+        visit_references(heap, block, payload, payload + block->size, add_reference,
+                         &list);
+        dump_u1(stream, DUMP_BLOCK);
+        dump_i4(stream, ref);
+        dump_u1(stream, block->kind);
+        dump_u2(stream, block->site);
+        // An array's length or an object's class id
+        dump_i4(stream, payload[0]);
+        dump_u4(stream, block_bytes(block->size));
+        dump_u4(stream, list.count);
+        if (list.count > 0) {
+            fwrite(list.refs, sizeof(int32_t), list.count, stream);
+        }
+        used_sites[block->site] = true;
+    }
+    free(list.refs);
+
+    write_roots(heap, &heap->frame_roots, DUMP_FRAME_ROOT, stream);
+    write_roots(heap, &heap->global_roots, DUMP_GLOBAL_ROOT, stream);
+    for (uint32_t site = 1; site <= UINT16_MAX && heap->site_names != NULL; site++) {
+        if (used_sites[site]) {
+            const char *name = heap->site_names(heap->site_names_context, site);
+            size_t length = strlen(name);
+            if (length > UINT16_MAX) {
+                length = UINT16_MAX;
+            }
+            dump_u1(stream, DUMP_SITE);
+            dump_u2(stream, site);
+            dump_u2(stream, length);
+            fwrite(name, 1, length, stream);
+        }
+    }
+    free(used_sites);
+    dump_u1(stream, DUMP_END);
+}
+
+void heap_request_dump(heap_t *heap) {
+    if (heap->dump_path != NULL) {
+        heap->dump_requested = 1;
+    }
+}
+
+void heap_dump_now(heap_t *heap) {
+    if (heap->dump_path != NULL) {
+        dump_requested_heap(heap);
+    }
+}
+
+void dump_requested_heap(heap_t *heap) {
+    heap->dump_requested = 0;
+    FILE *stream = fopen(heap->dump_path, "wb");
+    if (stream == NULL) {
+        perror(heap->dump_path);
+        return;
+    }
+    heap_dump(heap, stream);
+    bool failed = ferror(stream) != 0;
+    if (fclose(stream) != 0 || failed) {
+        fprintf(stderr, "Failed to write heap dump to %s\n", heap->dump_path);
+        return;
+    }
+    fprintf(stderr, "Heap dump written to %s\n", heap->dump_path);
+}
@@ -0,0 +1,56 @@
+#ifndef HEAP_DUMP_H
+#define HEAP_DUMP_H
+
+/*
+ * The format of the heap dumps heap_dump() writes and heap_analyze reads.
+ *
+ * A dump starts with the 8 bytes of HEAP_DUMP_MAGIC and a u4 version,
+ * followed by records, each of which starts with a u1 tag (see
+ * `dump_tag_t`) and ends the dump if the tag is DUMP_END.
+ * Integers are written in the byte order of the machine that wrote the dump.
+ */
+
+/** The bytes every heap dump starts with */
+#define HEAP_DUMP_MAGIC "TJVMHEAP"
+
+/** The version of the format, which changes whenever the records do */
+#define HEAP_DUMP_VERSION 1
+
+/** What a record of a heap dump describes */
+typedef enum {
+    /**
+     * An object or array that is still alive:
+     * - its reference (i4)
+     * - what it holds (u1), as a `block_kind_t`: 0 for an int array,
+     *   1 for an array of references, and 2 for an object
+     * - its allocation site (u2), or 0 if it isn't known
+     * - the array's length, or the object's class id (i4)
+     * - the number of bytes it takes up in the heap (u4)
+     * - the number of non-null references it holds (u4), then the references (i4s)
+     */
+    DUMP_BLOCK = 1,
+    /**
+     * An int in a range of roots that refers to an object or array:
+     * - whether the range is a frame's (0) or global (1) (u1)
+     * - the index of the range among the frame or global ranges (u4),
+     *   frames' ranges being in call order
+     * - the reference (i4)
+     */
+    DUMP_ROOT = 2,
+    /**
+     * The name of an allocation site of the blocks in the dump:
+     * - the site (u2)
+     * - the length of the name (u2), then its bytes
+     */
+    DUMP_SITE = 3,
+    /** The end of the dump */
+    DUMP_END = 4,
+} dump_tag_t;
+
+/** Whether the range of roots of a DUMP_ROOT record is a frame's or global */
+typedef enum {
+    DUMP_FRAME_ROOT = 0,
+    DUMP_GLOBAL_ROOT = 1,
+} dump_root_kind_t;
+
+#endif /* HEAP_DUMP_H */
@@ -0,0 +1,528 @@
+#include "intrinsics.h"
+
+#include <assert.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bytecode.h"
+#include "exceptions.h"
+#include "gc.h"
+#include "jvm.h"
+
+/**
+ * Copies a range of elements between two arrays (or within one array) as if
+ * through a temporary array, after checking that both ranges are in bounds.
+ *
+ * @return whether the ranges were valid and the elements were copied
+ */
+bool copy_array_range(heap_t *heap, int32_t src, int64_t src_pos, int32_t dst,
+                      int64_t dst_pos, int64_t length) {
+    if (src == NULL_REFERENCE || dst == NULL_REFERENCE) {
+        return false;
+    }
+    int32_t *src_array = heap_get(heap, src);
+    int32_t *dst_array = heap_get(heap, dst);
+    if (length < 0 || src_pos < 0 || dst_pos < 0 || src_pos + length > src_array[0] ||
+        dst_pos + length > dst_array[0]) {
+        return false;
+    }
+    // Elements start after the array's length
+    heap_overwrite_barrier_range(heap, dst, dst_pos + 1, length);
+    memmove(&dst_array[dst_pos + 1], &src_array[src_pos + 1], length * sizeof(int32_t));
+    heap_write_barrier_range(heap, dst, dst_pos + 1, length);
+    return true;
+}
+
+/**
+ * Sets a range of an array's elements to a value.
+ * Uses memset() when every byte of the value is the same, e.g. for 0 or -1.
+ */
+void fill_array_range(int32_t *array, int32_t from, int32_t to, int32_t value) {
+    uint32_t bytes = (uint32_t) value;
+    if (bytes == (bytes & 0xFF) * 0x01010101U) {
+        memset(&array[from + 1], bytes & 0xFF, (to - from) * sizeof(int32_t));
+        return;
+    }
+    for (int32_t i = from; i < to; i++) {
+        array[i + 1] = value;
+    }
+}
+
+/** Names the kind of array a block holds, as java's arraycopy messages do */
+const char *array_kind_name(block_kind_t kind) {
+    return kind == BLOCK_INTS ? "int[]" : "object array[]";
+}
+
+/**
+ * Checks the arguments of System.arraycopy(), in the order java does.
+ * The arrays must hold the same kind of element, since copying ints into
+ * a reference array would give the collector references that don't exist.
+ *
+ * @return the exception to throw, or NULL_REFERENCE if both ranges are in bounds
+ */
+int32_t check_array_copy(class_loader_t *loader, heap_t *heap, int32_t src,
+                         int32_t src_pos, int32_t dst, int32_t dst_pos, int32_t length) {
+    if (src == NULL_REFERENCE || dst == NULL_REFERENCE) {
+        return new_exception(loader, heap, NULL_POINTER_EXCEPTION, NULL);
+    }
+    char message[96];
+    block_kind_t src_kind = get_block(heap_get(heap, src))->kind;
+    block_kind_t dst_kind = get_block(heap_get(heap, dst))->kind;
+    if (src_kind == BLOCK_OBJECT || dst_kind == BLOCK_OBJECT) {
+        snprintf(message, sizeof(message), "arraycopy: %s type is not an array",
+                 src_kind == BLOCK_OBJECT ? "source" : "destination");
+        return new_exception(loader, heap, ARRAY_STORE_EXCEPTION, message);
+    }
+    if (src_kind != dst_kind) {
+        snprintf(message, sizeof(message),
+                 "arraycopy: type mismatch: can not copy %s into %s",
+                 array_kind_name(src_kind), array_kind_name(dst_kind));
+        return new_exception(loader, heap, ARRAY_STORE_EXCEPTION, message);
+    }
+    int32_t src_length = heap_get(heap, src)[0];
+    int32_t dst_length = heap_get(heap, dst)[0];
+    if (length < 0) {
+        snprintf(message, sizeof(message), "arraycopy: length %" PRId32 " is negative",
+                 length);
+    }
+    else if (src_pos < 0 || (int64_t) src_pos + length > src_length) {
+        snprintf(message, sizeof(message),
+                 "arraycopy: %s index %" PRId64 " out of bounds for length %" PRId32,
+                 src_pos < 0 ? "source" : "last source",
+                 src_pos < 0 ? src_pos : (int64_t) src_pos + length, src_length);
+    }
+    else if (dst_pos < 0 || (int64_t) dst_pos + length > dst_length) {
+        snprintf(message, sizeof(message),
+                 "arraycopy: %s index %" PRId64 " out of bounds for length %" PRId32,
+                 dst_pos < 0 ? "destination" : "last destination",
+                 dst_pos < 0 ? dst_pos : (int64_t) dst_pos + length, dst_length);
+    }
+    else {
+        return NULL_REFERENCE;
+    }
+    return new_exception(loader, heap, ARRAY_INDEX_EXCEPTION, message);
+}
+
+/**
+ * Checks the range of Arrays.fill(), as java's Arrays.rangeCheck() does.
+ *
+ * @return the exception to throw, or NULL_REFERENCE if the range is valid
+ */
+int32_t check_fill_range(class_loader_t *loader, heap_t *heap, int32_t array,
+                         int32_t from, int32_t to) {
+    if (array == NULL_REFERENCE) {
+        return new_exception(loader, heap, NULL_POINTER_EXCEPTION, NULL);
+    }
+    char message[64];
+    if (from > to) {
+        snprintf(message, sizeof(message),
+                 "fromIndex(%" PRId32 ") > toIndex(%" PRId32 ")", from, to);
+        return new_exception(loader, heap, ILLEGAL_ARGUMENT_EXCEPTION, message);
+    }
+    if (from >= 0 && to <= heap_get(heap, array)[0]) {
+        return NULL_REFERENCE;
+    }
+    snprintf(message, sizeof(message), "Array index out of range: %" PRId32,
+             from < 0 ? from : to);
+    return new_exception(loader, heap, ARRAY_INDEX_EXCEPTION, message);
+}
+
+/** System.arraycopy(Object src, int srcPos, Object dest, int destPos, int length) */
+int32_t system_arraycopy(int32_t *args, class_loader_t *loader, heap_t *heap,
+                         int32_t *value) {
+    (void) value;
+    int32_t exception =
+        check_array_copy(loader, heap, args[0], args[1], args[2], args[3], args[4]);
+    if (exception == NULL_REFERENCE) {
+        copy_array_range(heap, args[0], args[1], args[2], args[3], args[4]);
+    }
+    return exception;
+}
+
+/** Arrays.fill(int[] a, int val) */
+int32_t arrays_fill(int32_t *args, class_loader_t *loader, heap_t *heap,
+                    int32_t *value) {
+    (void) value;
+    if (args[0] == NULL_REFERENCE) {
+        return new_exception(loader, heap, NULL_POINTER_EXCEPTION, NULL);
+    }
+    int32_t *array = heap_get(heap, args[0]);
+    fill_array_range(array, 0, array[0], args[1]);
+    return NULL_REFERENCE;
+}
+
+/** Arrays.fill(int[] a, int fromIndex, int toIndex, int val) */
+int32_t arrays_fill_range(int32_t *args, class_loader_t *loader, heap_t *heap,
+                          int32_t *value) {
+    (void) value;
+    int32_t exception = check_fill_range(loader, heap, args[0], args[1], args[2]);
+    if (exception == NULL_REFERENCE) {
+        fill_array_range(heap_get(heap, args[0]), args[1], args[2], args[3]);
+    }
+    return exception;
+}
+
+/** Arrays.copyOf(int[] original, int newLength) */
+int32_t arrays_copy_of(int32_t *args, class_loader_t *loader, heap_t *heap,
+                       int32_t *value) {
+    if (args[0] == NULL_REFERENCE) {
+        return new_exception(loader, heap, NULL_POINTER_EXCEPTION, NULL);
+    }
+    int32_t exception = check_array_length(loader, heap, args[1]);
+    if (exception != NULL_REFERENCE) {
+        return exception;
+    }
+    int32_t copy = heap_new_array(heap, args[1]);
+    exception = check_allocation(loader, heap, copy);
+    if (exception != NULL_REFERENCE) {
+        return exception;
+    }
+    int32_t length = heap_get(heap, args[0])[0];
+    copy_array_range(heap, args[0], 0, copy, 0, length < args[1] ? length : args[1]);
+    *value = copy;
+    return NULL_REFERENCE;
+}
+
+/** All methods the VM implements natively */
+const intrinsic_t INTRINSICS[] = {
+    {"java/lang/System", "arraycopy", "(Ljava/lang/Object;ILjava/lang/Object;II)V", 5,
+     false, i_invokestatic_intrinsic, system_arraycopy},
+    {"java/util/Arrays", "fill", "([II)V", 2, false, i_invokestatic_intrinsic,
+     arrays_fill},
+    {"java/util/Arrays", "fill", "([IIII)V", 4, false, i_invokestatic_intrinsic,
+     arrays_fill_range},
+    {"java/util/Arrays", "copyOf", "([II)[I", 2, true, i_invokestatic_intrinsic,
+     arrays_copy_of},
+    {"java/lang/Math", "abs", "(I)I", 1, true, i_math_abs, NULL},
+    {"java/lang/Math", "min", "(II)I", 2, true, i_math_min, NULL},
+    {"java/lang/Math", "max", "(II)I", 2, true, i_math_max, NULL},
+    {"java/lang/Integer", "bitCount", "(I)I", 1, true, i_integer_bit_count, NULL},
+    {"java/lang/Integer", "numberOfTrailingZeros", "(I)I", 1, true,
+     i_integer_trailing_zeros, NULL},
+    {"java/lang/Integer", "numberOfLeadingZeros", "(I)I", 1, true,
+     i_integer_leading_zeros, NULL},
+};
+
+const intrinsic_t *find_intrinsic(const char *class_name, const char *name,
+                                  const char *descriptor) {
+    size_t count = sizeof(INTRINSICS) / sizeof(INTRINSICS[0]);
+    for (const intrinsic_t *intrinsic = INTRINSICS; intrinsic < INTRINSICS + count;
+         intrinsic++) {
+        if (strcmp(intrinsic->class_name, class_name) == 0 &&
+            strcmp(intrinsic->name, name) == 0 &&
+            strcmp(intrinsic->descriptor, descriptor) == 0) {
+            return intrinsic;
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Matchers for the pieces of a copy loop. Each checks whether the instruction(s)
+ * at *pc have the expected form, and if so, stores what they load and advances
+ * *pc past them.
+ */
+
+bool match_opcode(const code_t *code, size_t *pc, jvm_instruction_t opcode) {
+    if (*pc >= code->code_length || code->code[*pc] != opcode) {
+        return false;
+    }
+    *pc += 1;
+    return true;
+}
+
+bool match_iload(const code_t *code, size_t *pc, u2 *local) {
+    if (*pc >= code->code_length) {
+        return false;
+    }
+    u1 opcode = code->code[*pc];
+    if (opcode == i_iload && *pc + 1 < code->code_length) {
+        *local = code->code[*pc + 1];
+        *pc += 2;
+        return true;
+    }
+    if (i_iload_0 <= opcode && opcode <= i_iload_3) {
+        *local = opcode - i_iload_0;
+        *pc += 1;
+        return true;
+    }
+    return false;
+}
+
+bool match_aload(const code_t *code, size_t *pc, u2 *local) {
+    if (*pc >= code->code_length) {
+        return false;
+    }
+    u1 opcode = code->code[*pc];
+    if (opcode == i_aload && *pc + 1 < code->code_length) {
+        *local = code->code[*pc + 1];
+        *pc += 2;
+        return true;
+    }
+    if (i_aload_0 <= opcode && opcode <= i_aload_3) {
+        *local = opcode - i_aload_0;
+        *pc += 1;
+        return true;
+    }
+    return false;
+}
+
+/** Matches a constant, an int local other than `index`, or an array's length */
+bool match_loop_value(const code_t *code, size_t *pc, u2 index, loop_value_t *value) {
+    if (*pc >= code->code_length) {
+        return false;
+    }
+    u1 opcode = code->code[*pc];
+    u2 local;
+    value->negated = false;
+    if (i_iconst_m1 <= opcode && opcode <= i_iconst_5) {
+        value->kind = LOOP_CONSTANT;
+        value->value = opcode - i_iconst_0;
+        *pc += 1;
+        return true;
+    }
+    if (opcode == i_bipush && *pc + 1 < code->code_length) {
+        value->kind = LOOP_CONSTANT;
+        value->value = (int8_t) code->code[*pc + 1];
+        *pc += 2;
+        return true;
+    }
+    if (opcode == i_sipush && *pc + 2 < code->code_length) {
+        value->kind = LOOP_CONSTANT;
+        value->value = read_s2_operand(code, *pc + 1);
+        *pc += 3;
+        return true;
+    }
+    size_t start = *pc;
+    if (match_iload(code, pc, &local)) {
+        value->kind = LOOP_LOCAL;
+        value->value = local;
+        return local != index;
+    }
+    if (match_aload(code, pc, &local) && match_opcode(code, pc, i_arraylength)) {
+        value->kind = LOOP_ARRAY_LENGTH;
+        value->value = local;
+        return true;
+    }
+    *pc = start;
+    return false;
+}
+
+/** Matches `index`, `index + value`, or `index - value` */
+bool match_loop_index(const code_t *code, size_t *pc, u2 index, loop_value_t *offset) {
+    u2 local;
+    if (!match_iload(code, pc, &local) || local != index) {
+        return false;
+    }
+    size_t start = *pc;
+    if (match_loop_value(code, pc, index, offset)) {
+        if (match_opcode(code, pc, i_iadd)) {
+            return true;
+        }
+        if (match_opcode(code, pc, i_isub)) {
+            offset->negated = true;
+            return true;
+        }
+    }
+    // No offset
+    *pc = start;
+    offset->kind = LOOP_CONSTANT;
+    offset->value = 0;
+    offset->negated = false;
+    return true;
+}
+
+/**
+ * Checks whether a copy loop starts at the given index, which is the form javac
+ * generates for a counted for loop whose body is a single element copy:
+ *   start: iload i; <limit>; if_icmpge end
+ *          aload dst; <dst index>; aload src; <src index>; iaload; iastore
+ *          iinc i 1; goto start
+ *   end:
+ */
+bool match_copy_loop(const code_t *code, size_t start, copy_loop_t *loop) {
+    size_t pc = start;
+    loop->start = start;
+    if (!match_iload(code, &pc, &loop->index)) {
+        return false;
+    }
+    loop->index_load_length = pc - start;
+    if (!match_loop_value(code, &pc, loop->index, &loop->limit) ||
+        pc + 3 > code->code_length) {
+        return false;
+    }
+    u1 condition = code->code[pc];
+    if (condition != i_if_icmpge && condition != i_if_icmpgt) {
+        return false;
+    }
+    loop->inclusive = condition == i_if_icmpgt;
+    loop->end = pc + read_s2_operand(code, pc + 1);
+    pc += 3;
+
+    if (!match_aload(code, &pc, &loop->dst) ||
+        !match_loop_index(code, &pc, loop->index, &loop->dst_offset) ||
+        !match_aload(code, &pc, &loop->src) ||
+        !match_loop_index(code, &pc, loop->index, &loop->src_offset) ||
+        !match_opcode(code, &pc, i_iaload) || !match_opcode(code, &pc, i_iastore)) {
+        return false;
+    }
+
+    // iinc i 1
+    if (pc + 3 > code->code_length || code->code[pc] != i_iinc ||
+        code->code[pc + 1] != loop->index || (int8_t) code->code[pc + 2] != 1) {
+        return false;
+    }
+    pc += 3;
+    // goto start, which must be the last instruction of the loop
+    if (pc + 3 > code->code_length || code->code[pc] != i_goto ||
+        pc + read_s2_operand(code, pc + 1) != start) {
+        return false;
+    }
+    pc += 3;
+    return pc == loop->end;
+}
+
+/** Checks whether a branch target is strictly inside a loop */
+bool is_inside_loop(const copy_loop_t *loop, size_t target) {
+    return loop->start < target && target < loop->end;
+}
+
+/**
+ * Checks whether any branch outside a loop jumps into the middle of it,
+ * in which case the loop can't be replaced by a copy.
+ */
+bool jumps_into_loop(const code_t *code, const copy_loop_t *loop) {
+    for (size_t pc = 0; pc < code->code_length; pc += instruction_length(code, pc)) {
+        if (loop->start <= pc && pc < loop->end) {
+            continue;
+        }
+        u1 opcode = code->code[pc];
+        if (opcode == i_tableswitch || opcode == i_lookupswitch) {
+            /* Both switches start with the default offset. The rest of the offsets
+             * start 12 bytes in and are 4 bytes apart in a tableswitch,
+             * or 8 bytes apart (after each match) in a lookupswitch. */
+            size_t operands = (pc + 4) & ~(size_t) 3;
+            size_t end = pc + instruction_length(code, pc);
+            size_t step = opcode == i_lookupswitch ? 8 : 4;
+            if (is_inside_loop(loop, pc + read_s4_operand(code, operands))) {
+                return true;
+            }
+            for (size_t offset = operands + 12; offset < end; offset += step) {
+                if (is_inside_loop(loop, pc + read_s4_operand(code, offset))) {
+                    return true;
+                }
+            }
+        }
+        else if ((i_ifeq <= opcode && opcode <= i_goto) || opcode == 0xc6 ||
+                 opcode == 0xc7) {
+            // if<cond>, if_icmp<cond>, if_acmp<cond>, goto, ifnull, ifnonnull
+            if (is_inside_loop(loop, pc + read_s2_operand(code, pc + 1))) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+void find_copy_loops(code_t *code) {
+    // Make sure every instruction is known, so the code can be scanned
+    for (size_t pc = 0; pc < code->code_length;) {
+        size_t length = instruction_length(code, pc);
+        if (length == 0) {
+            return;
+        }
+        pc += length;
+    }
+
+    for (size_t pc = 0; pc < code->code_length; pc += instruction_length(code, pc)) {
+        copy_loop_t loop;
+        if (!match_copy_loop(code, pc, &loop) || jumps_into_loop(code, &loop)) {
+            continue;
+        }
+        code->copy_loops = realloc(code->copy_loops,
+                                   sizeof(copy_loop_t[code->copy_loops_count + 1]));
+        assert(code->copy_loops != NULL && "Failed to allocate copy loops");
+        code->copy_loops[code->copy_loops_count] = loop;
+        code->copy_loops_count++;
+    }
+
+    // Rewrite the loops only after scanning, since i_copy_loop's length is only
+    // known once its loop has been recorded
+    for (u2 i = 0; i < code->copy_loops_count; i++) {
+        code->code[code->copy_loops[i].start] = i_copy_loop;
+    }
+}
+
+const copy_loop_t *get_copy_loop(const code_t *code, size_t pc) {
+    for (u2 i = 0; i < code->copy_loops_count; i++) {
+        if (code->copy_loops[i].start == pc) {
+            return &code->copy_loops[i];
+        }
+    }
+    assert(false && "Missing copy loop");
+    return NULL;
+}
+
+/**
+ * Evaluates one of a copy loop's values.
+ *
+ * @return whether the value could be evaluated (an array length needs a non-null array)
+ */
+bool evaluate_loop_value(const loop_value_t *value, const int32_t *locals, heap_t *heap,
+                         int64_t *result) {
+    switch (value->kind) {
+        case LOOP_CONSTANT:
+            *result = value->value;
+            break;
+        case LOOP_LOCAL:
+            *result = locals[value->value];
+            break;
+        case LOOP_ARRAY_LENGTH:
+            if (locals[value->value] == NULL_REFERENCE) {
+                return false;
+            }
+            *result = heap_get(heap, locals[value->value])[0];
+            break;
+    }
+    if (value->negated) {
+        *result = -*result;
+    }
+    return true;
+}
+
+bool run_copy_loop(const copy_loop_t *loop, int32_t *locals, heap_t *heap) {
+    int64_t first = locals[loop->index];
+    int64_t limit = 0;
+    int64_t dst_offset = 0;
+    int64_t src_offset = 0;
+    if (!evaluate_loop_value(&loop->limit, locals, heap, &limit) ||
+        !evaluate_loop_value(&loop->dst_offset, locals, heap, &dst_offset) ||
+        !evaluate_loop_value(&loop->src_offset, locals, heap, &src_offset)) {
+        return false;
+    }
+    if (loop->inclusive) {
+        limit += 1;
+    }
+    if (limit <= first) {
+        // The loop body doesn't run at all
+        return true;
+    }
+
+    int64_t count = limit - first;
+    int64_t dst_start = first + dst_offset;
+    int64_t src_start = first + src_offset;
+    int32_t dst = locals[loop->dst];
+    int32_t src = locals[loop->src];
+    /* Copying forward within an array reads the elements it already wrote
+     * when the destination starts inside the source range. */
+    if (dst == src && src_start < dst_start && dst_start < src_start + count) {
+        return false;
+    }
+    if (!copy_array_range(heap, src, src_start, dst, dst_start, count)) {
+        return false;
+    }
+    locals[loop->index] = limit;
+    return true;
+}
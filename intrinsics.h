@@ -0,0 +1,135 @@
+#ifndef INTRINSICS_H
+#define INTRINSICS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "class_file.h"
+#include "class_loader.h"
+#include "heap.h"
+#include "jvm.h"
+
+/**
+ * A library method that the VM runs natively instead of as bytecode.
+ * invokestatic looks up intrinsics when it resolves a call site,
+ * so calls to library classes work without loading them.
+ */
+typedef struct {
+    /** The internal name of the method's class, e.g. "java/lang/System" */
+    const char *class_name;
+    /** The method name, e.g. "arraycopy" */
+    const char *name;
+    /** The method descriptor, e.g. "([II)V" */
+    const char *descriptor;
+    /** The number of int or reference parameters the method takes */
+    u2 parameters;
+    /** Whether the method returns a value */
+    bool has_value;
+    /**
+     * The instruction that call sites are rewritten into.
+     * Simple methods get their own instruction, which the interpreter computes
+     * inline; the rest use i_invokestatic_intrinsic, which calls `function`.
+     */
+    jvm_instruction_t instruction;
+    /**
+     * The native implementation of the method,
+     * or NULL if the method has its own instruction.
+     *
+     * @param args the method's arguments, in the order they are declared
+     * @param heap the heap that array arguments refer into
+     * @param value set to the method's return value, unless it returns void
+     * @return the exception the method throws, or NULL_REFERENCE if it returns
+     */
+    int32_t (*function)(int32_t *args, class_loader_t *loader, heap_t *heap,
+                        int32_t *value);
+} intrinsic_t;
+
+/**
+ * Finds the intrinsic implementing a method.
+ *
+ * @param class_name the internal name of the method's class
+ * @param name the method name
+ * @param descriptor the method descriptor
+ * @return the intrinsic, or NULL if the method isn't implemented natively
+ */
+const intrinsic_t *find_intrinsic(const char *class_name, const char *name,
+                                  const char *descriptor);
+
+/** Where a copy loop gets one of its loop-invariant values from */
+typedef enum {
+    /** An int constant pushed by iconst, bipush, or sipush */
+    LOOP_CONSTANT,
+    /** An int local variable */
+    LOOP_LOCAL,
+    /** The length of the array in a reference local variable */
+    LOOP_ARRAY_LENGTH
+} loop_value_kind_t;
+
+/** A loop-invariant int used by a copy loop */
+typedef struct {
+    loop_value_kind_t kind;
+    /** The constant, or the index of the local variable */
+    int32_t value;
+    /** Whether the value is subtracted instead of added */
+    bool negated;
+} loop_value_t;
+
+/**
+ * A loop that copies elements from one array to another, of the form
+ *   for (; i < limit; i++) dst[i + dst_offset] = src[i + src_offset];
+ * (or i <= limit), where the offsets are optional.
+ * Its first instruction is rewritten to i_copy_loop, which performs the
+ * whole copy at once using the same bounds-checked copy as System.arraycopy.
+ */
+typedef struct copy_loop {
+    /** The index of the loop's first instruction, which loads `i` */
+    u4 start;
+    /** The index of the first instruction after the loop */
+    u4 end;
+    /** The local variable holding `i` */
+    u2 index;
+    /** The length of the loop's first instruction */
+    u1 index_load_length;
+    /** Whether the loop condition is `i <= limit` rather than `i < limit` */
+    bool inclusive;
+    loop_value_t limit;
+    /** The local variable holding the destination array */
+    u2 dst;
+    loop_value_t dst_offset;
+    /** The local variable holding the source array */
+    u2 src;
+    loop_value_t src_offset;
+} copy_loop_t;
+
+/**
+ * Finds the element-copy loops in a method's code and rewrites the first
+ * instruction of each to i_copy_loop. Must be called before the method runs.
+ *
+ * @param code the method's code, which is updated with the loops found
+ */
+void find_copy_loops(code_t *code);
+
+/**
+ * Looks up the copy loop starting at an i_copy_loop instruction.
+ *
+ * @param code the method's code
+ * @param pc the index of the i_copy_loop instruction
+ * @return the loop starting there
+ */
+const copy_loop_t *get_copy_loop(const code_t *code, size_t pc);
+
+/**
+ * Runs all remaining iterations of a copy loop as a single copy.
+ * If the loop would go out of bounds, or would read elements it already
+ * wrote, nothing is done, so that running the loop's original bytecode
+ * behaves exactly as it would have.
+ *
+ * @param loop the loop to run
+ * @param locals the local variables of the method running the loop;
+ *   the loop's index is advanced to its final value
+ * @param heap the heap that the arrays refer into
+ * @return whether the loop was run
+ */
+bool run_copy_loop(const copy_loop_t *loop, int32_t *locals, heap_t *heap);
+
+#endif /* INTRINSICS_H */
@@ -0,0 +1,280 @@
+#include "jar.h"
+
+#include <assert.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#include "hash.h"
+
+/*
+ * Signatures and sizes of the zip records we read. If you're interested,
+ * https://pkware.cachefly.net/webdocs/casestudies/APPNOTE.TXT
+ * has the complete specification.
+ */
+const u4 END_OF_CENTRAL_DIRECTORY_SIGNATURE = 0x06054b50;
+const size_t END_OF_CENTRAL_DIRECTORY_SIZE = 22;
+/** The largest comment that can follow the end of central directory record */
+const size_t MAX_COMMENT_SIZE = 0xFFFF;
+const u4 CENTRAL_DIRECTORY_SIGNATURE = 0x02014b50;
+const size_t CENTRAL_DIRECTORY_HEADER_SIZE = 46;
+const u4 LOCAL_HEADER_SIGNATURE = 0x04034b50;
+const size_t LOCAL_HEADER_SIZE = 30;
+
+/** Entry compression methods */
+typedef enum { STORED = 0, DEFLATED = 8 } compression_t;
+
+/** An entry of the central directory */
+typedef struct {
+    /** The entry's path, which is not null-terminated */
+    const char *name;
+    u2 name_length;
+    compression_t compression;
+    u4 compressed_size;
+    u4 size;
+    /** The offset of the entry's local header in the archive */
+    u4 local_header_offset;
+    /** The inflated contents of a deflated entry, or NULL if not inflated yet */
+    u1 *inflated;
+} jar_entry_t;
+
+typedef struct jar {
+    /** The memory-mapped archive */
+    const u1 *data;
+    /** The size of the archive in bytes */
+    size_t size;
+    /** The entries of the central directory */
+    jar_entry_t *entries;
+    size_t entry_count;
+    /**
+     * A hash table of entries keyed by name, which resolves collisions by
+     * linear probing. Each slot holds an index into `entries` plus 1, or 0 if empty.
+     */
+    u4 *index;
+    /** The number of slots in `index`, which is always a power of 2 */
+    size_t capacity;
+} jar_t;
+
+/* Zip archives store integers in little-endian */
+u2 read_le_u2(const u1 *bytes) {
+    return (u2) (bytes[0] | bytes[1] << 8);
+}
+u4 read_le_u4(const u1 *bytes) {
+    return (u4) bytes[0] | (u4) bytes[1] << 8 | (u4) bytes[2] << 16 | (u4) bytes[3] << 24;
+}
+
+/** Finds the end of central directory record, which is followed only by a comment */
+const u1 *find_end_of_central_directory(const u1 *data, size_t size) {
+    if (size < END_OF_CENTRAL_DIRECTORY_SIZE) {
+        return NULL;
+    }
+    size_t last = size - END_OF_CENTRAL_DIRECTORY_SIZE;
+    size_t first = last > MAX_COMMENT_SIZE ? last - MAX_COMMENT_SIZE : 0;
+    for (size_t offset = last + 1; offset-- > first;) {
+        if (read_le_u4(&data[offset]) == END_OF_CENTRAL_DIRECTORY_SIGNATURE) {
+            return &data[offset];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Reads the entries of the central directory and builds the hash table over them.
+ *
+ * @return whether the central directory was valid
+ */
+bool index_central_directory(jar_t *jar) {
+    const u1 *end = find_end_of_central_directory(jar->data, jar->size);
+    if (end == NULL) {
+        return false;
+    }
+    u2 entry_count = read_le_u2(&end[10]);
+    u4 directory_size = read_le_u4(&end[12]);
+    u4 directory_offset = read_le_u4(&end[16]);
+    if (directory_offset > jar->size || directory_size > jar->size - directory_offset) {
+        return false;
+    }
+
+    jar->entries = malloc(sizeof(jar_entry_t[entry_count + 1]));
+    assert(jar->entries != NULL && "Failed to allocate JAR entries");
+    // Keep the hash table at most half full
+    jar->capacity = 16;
+    while (jar->capacity < 2 * (size_t) entry_count) {
+        jar->capacity *= 2;
+    }
+    jar->index = calloc(jar->capacity, sizeof(u4));
+    assert(jar->index != NULL && "Failed to allocate JAR index");
+
+    const u1 *header = &jar->data[directory_offset];
+    const u1 *directory_end = header + directory_size;
+    for (jar->entry_count = 0; jar->entry_count < entry_count; jar->entry_count++) {
+        if (header + CENTRAL_DIRECTORY_HEADER_SIZE > directory_end ||
+            read_le_u4(header) != CENTRAL_DIRECTORY_SIGNATURE) {
+            return false;
+        }
+        jar_entry_t *entry = &jar->entries[jar->entry_count];
+        entry->compression = read_le_u2(&header[10]);
+        entry->compressed_size = read_le_u4(&header[20]);
+        entry->size = read_le_u4(&header[24]);
+        entry->name_length = read_le_u2(&header[28]);
+        u2 extra_length = read_le_u2(&header[30]);
+        u2 comment_length = read_le_u2(&header[32]);
+        entry->local_header_offset = read_le_u4(&header[42]);
+        entry->name = (const char *) &header[CENTRAL_DIRECTORY_HEADER_SIZE];
+        entry->inflated = NULL;
+        header += CENTRAL_DIRECTORY_HEADER_SIZE + entry->name_length + extra_length +
+                  comment_length;
+        if (header > directory_end) {
+            return false;
+        }
+
+        size_t slot =
+            hash_bytes(entry->name, entry->name_length) & (jar->capacity - 1);
+        while (jar->index[slot] != 0) {
+            slot = (slot + 1) & (jar->capacity - 1);
+        }
+        jar->index[slot] = jar->entry_count + 1;
+    }
+    return true;
+}
+
+jar_t *jar_open(const char *path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return NULL;
+    }
+    struct stat stats;
+    if (fstat(fd, &stats) < 0 || stats.st_size == 0) {
+        close(fd);
+        return NULL;
+    }
+    void *data = mmap(NULL, stats.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        return NULL;
+    }
+
+    jar_t *jar = malloc(sizeof(*jar));
+    assert(jar != NULL && "Failed to allocate JAR");
+    jar->data = data;
+    jar->size = stats.st_size;
+    jar->entries = NULL;
+    jar->entry_count = 0;
+    jar->index = NULL;
+    if (!index_central_directory(jar)) {
+        jar_close(jar);
+        return NULL;
+    }
+    return jar;
+}
+
+/**
+ * Finds where an entry's contents start, after its local header.
+ *
+ * @return the entry's (possibly compressed) contents, or NULL if the header is invalid
+ */
+const u1 *find_entry_data(const jar_t *jar, const jar_entry_t *entry) {
+    size_t offset = entry->local_header_offset;
+    if (offset > jar->size || LOCAL_HEADER_SIZE > jar->size - offset) {
+        return NULL;
+    }
+    const u1 *header = &jar->data[offset];
+    if (read_le_u4(header) != LOCAL_HEADER_SIGNATURE) {
+        return NULL;
+    }
+    // The local header's name and extra field can differ from the central directory's
+    size_t data_offset = offset + LOCAL_HEADER_SIZE + read_le_u2(&header[26]) +
+                         read_le_u2(&header[28]);
+    if (data_offset > jar->size || entry->compressed_size > jar->size - data_offset) {
+        return NULL;
+    }
+    return &jar->data[data_offset];
+}
+
+/** Inflates a deflated entry into a newly allocated buffer */
+u1 *inflate_entry(const jar_entry_t *entry, const u1 *compressed) {
+    u1 *inflated = malloc(entry->size > 0 ? entry->size : 1);
+    assert(inflated != NULL && "Failed to allocate inflated JAR entry");
+    z_stream stream = {
+        .next_in = (Bytef *) compressed,
+        .avail_in = entry->compressed_size,
+        .next_out = inflated,
+        .avail_out = entry->size,
+    };
+    // Negative window bits mean raw deflate data, without a zlib header
+    int result = inflateInit2(&stream, -MAX_WBITS);
+    assert(result == Z_OK && "Failed to initialize zlib");
+    result = inflate(&stream, Z_FINISH);
+    inflateEnd(&stream);
+    if (result != Z_STREAM_END || stream.total_out != entry->size) {
+        free(inflated);
+        return NULL;
+    }
+    return inflated;
+}
+
+size_t jar_entry_count(const jar_t *jar) {
+    return jar->entry_count;
+}
+
+const char *jar_entry_name(const jar_t *jar, size_t index, size_t *length) {
+    *length = jar->entries[index].name_length;
+    return jar->entries[index].name;
+}
+
+bool jar_read_entry(jar_t *jar, size_t index, const u1 **bytes, size_t *length) {
+    jar_entry_t *entry = &jar->entries[index];
+    const u1 *data = find_entry_data(jar, entry);
+    if (data == NULL) {
+        return false;
+    }
+    if (entry->compression == STORED) {
+        // Only the compressed size was checked against the JAR's size
+        if (entry->size != entry->compressed_size) {
+            return false;
+        }
+        *bytes = data;
+    }
+    else if (entry->compression == DEFLATED) {
+        if (entry->inflated == NULL) {
+            entry->inflated = inflate_entry(entry, data);
+            if (entry->inflated == NULL) {
+                return false;
+            }
+        }
+        *bytes = entry->inflated;
+    }
+    else {
+        return false;
+    }
+    *length = entry->size;
+    return true;
+}
+
+bool jar_find(jar_t *jar, const char *name, const u1 **bytes, size_t *length) {
+    size_t name_length = strlen(name);
+    size_t slot = hash_bytes(name, name_length) & (jar->capacity - 1);
+    for (; jar->index[slot] != 0; slot = (slot + 1) & (jar->capacity - 1)) {
+        size_t index = jar->index[slot] - 1;
+        jar_entry_t *entry = &jar->entries[index];
+        if (entry->name_length == name_length &&
+            memcmp(entry->name, name, name_length) == 0) {
+            return jar_read_entry(jar, index, bytes, length);
+        }
+    }
+    return false;
+}
+
+void jar_close(jar_t *jar) {
+    for (size_t i = 0; i < jar->entry_count; i++) {
+        free(jar->entries[i].inflated);
+    }
+    free(jar->entries);
+    free(jar->index);
+    munmap((void *) jar->data, jar->size);
+    free(jar);
+}
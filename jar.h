@@ -0,0 +1,68 @@
+#ifndef JAR_H
+#define JAR_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "class_file.h"
+
+/**
+ * A JAR (zip archive) of class files. The archive is memory-mapped and its
+ * central directory is indexed when it is opened, so looking up an entry
+ * needs no system calls.
+ */
+typedef struct jar jar_t;
+
+/**
+ * Opens a JAR and indexes the entries in its central directory.
+ *
+ * @param path the path of the JAR
+ * @return the opened JAR, or NULL if it doesn't exist or isn't a zip archive
+ */
+jar_t *jar_open(const char *path);
+
+/**
+ * Finds the contents of an entry in a JAR.
+ * Stored (uncompressed) entries point directly into the mapped archive.
+ * Deflated entries are inflated the first time they are found, and the
+ * inflated contents are kept until the JAR is closed. Either way, the contents
+ * stay put until then, so classes can be parsed in place.
+ *
+ * @param name the entry's path in the archive, e.g. "com/example/Foo.class"
+ * @param bytes set to the entry's contents, which are valid until jar_close()
+ * @param length set to the number of bytes in the entry
+ * @return whether the entry was found
+ */
+bool jar_find(jar_t *jar, const char *name, const u1 **bytes, size_t *length);
+
+/**
+ * Gets the number of entries in a JAR's central directory.
+ */
+size_t jar_entry_count(const jar_t *jar);
+
+/**
+ * Gets the path of an entry in a JAR.
+ *
+ * @param index the index of the entry, less than jar_entry_count()
+ * @param length set to the length of the path
+ * @return the path, which is not null-terminated
+ */
+const char *jar_entry_name(const jar_t *jar, size_t index, size_t *length);
+
+/**
+ * Gets the contents of an entry in a JAR, like jar_find() does.
+ * Different entries can be read from different threads at the same time.
+ *
+ * @param index the index of the entry, less than jar_entry_count()
+ * @param bytes set to the entry's contents, which are valid until jar_close()
+ * @param length set to the number of bytes in the entry
+ * @return whether the entry could be read
+ */
+bool jar_read_entry(jar_t *jar, size_t index, const u1 **bytes, size_t *length);
+
+/**
+ * Unmaps a JAR and frees all of its inflated entries.
+ */
+void jar_close(jar_t *jar);
+
+#endif /* JAR_H */
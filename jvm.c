@@ -2,13 +2,23 @@
 
 #include <assert.h>
 #include <inttypes.h>
+#include <signal.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
+#include "bytecode.h"
+#include "class_loader.h"
+#include "dispatch.h"
+#include "escape.h"
+#include "exceptions.h"
 #include "heap.h"
+#include "intrinsics.h"
+#include "profiler.h"
 #include "read_class.h"
+#include "string_table.h"
 
 /** The name of the method to invoke to run the class file */
 const char MAIN_METHOD[] = "main";
@@ -19,6 +29,9 @@ const char MAIN_METHOD[] = "main";
  * https://docs.oracle.com/javase/specs/jvms/se12/html/jvms-4.html#jvms-4.3.2.
  */
 const char MAIN_DESCRIPTOR[] = "([Ljava/lang/String;)V";
+/** The name and descriptor of a class's static initializer */
+const char CLASS_INITIALIZER[] = "<clinit>";
+const char CLASS_INITIALIZER_DESCRIPTOR[] = "()V";
 
 /**
  * Represents the return value of a Java method: either void or an int or a reference.
@@ -30,23 +43,256 @@ typedef struct {
     bool has_value;
     /** The returned value (only valid if `has_value` is true) */
     int32_t value;
+    /** The exception the method threw instead of returning, or NULL_REFERENCE */
+    int32_t exception;
 } optional_value_t;
 
+/**
+ * Finds the start of a switch instruction's operands. They are padded so that
+ * they begin at a multiple of 4 bytes from the start of the method's code.
+ *
+ * @param code the code of the method containing the switch
+ * @param pc the index of the switch opcode in the method's code
+ * @return the 4-byte-aligned operands
+ */
+int32_t *switch_operands(code_t *code, size_t pc) {
+    return (int32_t *) &code->code[(pc + 4) & ~(size_t) 3];
+}
+
+/**
+ * Converts big-endian 4-byte operands to host byte order in place.
+ *
+ * @param operands the first operand to convert
+ * @param count the number of consecutive operands to convert
+ */
+void decode_s4_operands(int32_t *operands, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        u1 *bytes = (u1 *) &operands[i];
+        operands[i] = (int32_t) ((u4) bytes[0] << 24 | (u4) bytes[1] << 16 |
+                                 (u4) bytes[2] << 8 | bytes[3]);
+    }
+}
+
+/**
+ * Finds the jump offset for a key in a decoded lookupswitch.
+ * The match-offset pairs are sorted by match, so this is a binary search,
+ * written so that the comparisons compile to conditional moves, not branches.
+ *
+ * @param operands the decoded operands: default, npairs, then the pairs
+ * @param key the value being switched on
+ * @return the offset of the matching case, or the default offset
+ */
+int32_t lookup_switch_offset(const int32_t *operands, int32_t key) {
+    int32_t npairs = operands[1];
+    const int32_t *pairs = &operands[2];
+    if (npairs == 0) {
+        return operands[0];
+    }
+    int32_t low = 0;
+    for (int32_t length = npairs; length > 1; length -= length / 2) {
+        int32_t half = length / 2;
+        low = pairs[2 * (low + half)] <= key ? low + half : low;
+    }
+    return pairs[2 * low] == key ? pairs[2 * low + 1] : operands[0];
+}
+
+/**
+ * Allocates a rectangular multi-dimensional array.
+ * The arrays of each dimension are allocated right after their parent array,
+ * so a 2D table's rows are usually adjacent in memory, in row-major order.
+ * If fewer dimensions are given than the array type has,
+ * the innermost allocated arrays are filled with null references.
+ *
+ * @param heap the heap to add the arrays to
+ * @param type the descriptor of the outermost array's type, e.g. "[[I"
+ * @param counts the length of each dimension, outermost first
+ * @param dimensions the number of dimensions to allocate
+ * @param site the allocation site of all the arrays
+ * @return a reference to the outermost array,
+ *   or NULL_REFERENCE if the arrays don't all fit in the heap
+ */
+int32_t allocate_multi_array(heap_t *heap, const char *type, const int32_t *counts,
+                             u1 dimensions, u2 site) {
+    assert(counts[0] >= 0 && "Negative array size");
+    heap_set_allocation_site(heap, site);
+    int32_t array = type[1] == '[' || type[1] == 'L'
+                        ? heap_new_reference_array(heap, counts[0])
+                        : heap_new_array(heap, counts[0]);
+    if (dimensions > 1 && array != NULL_REFERENCE) {
+        // Keep the array alive while its elements are allocated
+        heap_push_roots(heap, &array, 1);
+        for (int32_t i = 1; i <= counts[0]; i++) {
+            int32_t element =
+                allocate_multi_array(heap, &type[1], &counts[1], dimensions - 1, site);
+            if (element == NULL_REFERENCE) {
+                array = NULL_REFERENCE;
+                break;
+            }
+            heap_store_reference(heap, array, i, element);
+        }
+        heap_pop_roots(heap, 1);
+    }
+    return array;
+}
+
+optional_value_t execute(method_t *method, int32_t *locals, class_file_t *class,
+                         class_loader_t *loader, heap_t *heap);
+
+/**
+ * The value of System.out. PrintStream methods don't look at their receiver,
+ * so this is just a placeholder for getstatic to push.
+ */
+int32_t system_out = NULL_REFERENCE;
+
+/**
+ * Calls a method with the arguments on top of the operand stack,
+ * replacing them with the method's return value, if any.
+ *
+ * @param callee the method to call
+ * @param operand_stack the caller's operand stack. The arguments are on top,
+ *   preceded by the receiver if the method isn't static.
+ * @param stack_idx the caller's stack index, which is updated
+ * @return the exception the method threw, or NULL_REFERENCE if it returned
+ */
+int32_t invoke_method(method_t *callee, int32_t *operand_stack, int32_t *stack_idx,
+                      class_loader_t *loader, heap_t *heap) {
+    int32_t num_params = get_number_of_parameters(callee);
+    if ((callee->access_flags & IS_STATIC) == 0) {
+        // The receiver is passed as local 0
+        num_params++;
+    }
+    int32_t *callee_locals = calloc(sizeof(int32_t), callee->code.max_locals);
+    assert(callee_locals != NULL && "Failed to allocate locals");
+    *stack_idx -= num_params;
+    memcpy(callee_locals, &operand_stack[*stack_idx], sizeof(int32_t[num_params]));
+    optional_value_t ret = execute(callee, callee_locals, callee->class, loader, heap);
+    free(callee_locals);
+    if (ret.has_value) {
+        operand_stack[*stack_idx] = ret.value;
+        *stack_idx += 1;
+    }
+    return ret.exception;
+}
+
+/**
+ * Runs a class's static initializer the first time the class is used,
+ * after initializing its superclasses.
+ * An exception thrown by a static initializer ends the program.
+ */
+void initialize_class(class_file_t *class, class_loader_t *loader, heap_t *heap) {
+    if (class->initialized) {
+        return;
+    }
+    // Mark the class first, so the initializer can use the class's own statics
+    class->initialized = true;
+    // Static fields keep the objects they refer to alive
+    heap_add_global_roots(heap, class->statics, class->statics_count);
+    if (class->super_name != NULL) {
+        class_file_t *super_class = load_class(loader, class->super_name);
+        if (super_class != NULL) {
+            initialize_class(super_class, loader, heap);
+        }
+    }
+    method_t *initializer =
+        find_method(CLASS_INITIALIZER, CLASS_INITIALIZER_DESCRIPTOR, class);
+    if (initializer != NULL) {
+        int32_t *locals = calloc(initializer->code.max_locals, sizeof(int32_t));
+        assert(locals != NULL && "Failed to allocate locals");
+        optional_value_t result = execute(initializer, locals, class, loader, heap);
+        free(locals);
+        if (result.exception != NULL_REFERENCE) {
+            print_uncaught_exception(stderr, loader, heap, result.exception);
+            exit(1);
+        }
+    }
+}
+
+/**
+ * Finds where the value of a static field is stored,
+ * initializing the class that declares the field.
+ *
+ * @param ref the names of the field
+ * @return the address of the field's value
+ */
+int32_t *resolve_static_field(member_ref_t ref, class_loader_t *loader, heap_t *heap) {
+    if (strcmp(ref.class_name, "java/lang/System") == 0 && strcmp(ref.name, "out") == 0) {
+        return &system_out;
+    }
+    class_file_t *field_class = load_class(loader, ref.class_name);
+    assert(field_class != NULL && "Class not found");
+    field_t *field = find_inherited_field(loader, field_class, ref.name, ref.descriptor);
+    assert(field != NULL && "Unknown field");
+    initialize_class(field->class, loader, heap);
+    return &field->class->statics[field->slot];
+}
+
+/**
+ * Checks that all the arrays of a multi-dimensional array fit in the heap.
+ * The arrays are counted a dimension at a time, and each dimension's bytes are
+ * compared against what is left by dividing, so the products of the lengths
+ * never overflow.
+ *
+ * @param counts the length of each dimension, none of which is negative
+ * @return the exception to throw, or NULL_REFERENCE if the arrays fit
+ */
+int32_t check_multi_array_size(class_loader_t *loader, heap_t *heap,
+                               const int32_t *counts, u1 dimensions) {
+    uint64_t limit = heap_max_size(heap);
+    uint64_t bytes = 0;
+    // The number of arrays in the current dimension
+    uint64_t arrays = 1;
+    for (u1 dimension = 0; dimension < dimensions && arrays > 0; dimension++) {
+        uint64_t array_bytes = sizeof(int32_t[heap_array_memory_size(counts[dimension])]);
+        if (array_bytes > (limit - bytes) / arrays) {
+            return new_exception(loader, heap, OUT_OF_MEMORY_ERROR, "Java heap space");
+        }
+        bytes += arrays * array_bytes;
+        // Fewer than `limit` arrays fit, and each holds fewer elements than bytes
+        arrays *= (uint64_t) counts[dimension];
+    }
+    return NULL_REFERENCE;
+}
+
+/**
+ * Tears down a frame when its method returns or throws: frees its local arrays
+ * and operand stack, and unregisters its roots.
+ */
+void leave_frame(heap_t *heap, const code_t *code, int32_t *operand_stack) {
+    free_local_arrays(heap, code, &operand_stack[code->max_stack]);
+    heap_pop_roots(heap, 2);
+    free(operand_stack);
+}
+
 /**
  * Runs a method's instructions until the method returns.
+ * If an instruction throws an exception, the method jumps to its handler for
+ * the exception; if it has none, it returns the exception instead of a value.
  *
  * @param method the method to run
  * @param locals the array of local variables, including the method parameters.
  *   Except for parameters, the locals are uninitialized.
  * @param class the class file the method belongs to
+ * @param loader the class loader, which loads the classes the method references
  * @param heap an array of heap-allocated pointers, useful for references
- * @return an optional int containing the method's return value
+ * @return an optional int containing the method's return value,
+ *   or the exception the method threw
  */
 optional_value_t execute(method_t *method, int32_t *locals, class_file_t *class,
-                         heap_t *heap) {
+                         class_loader_t *loader, heap_t *heap) {
+    load_method_code(method);
     size_t pc = 0;
-    int32_t *operand_stack = calloc(method->code.max_stack, sizeof(int32_t));
+    // The frame's local arrays follow the operand stack, starting with their references
+    size_t frame_size = method->code.max_stack + local_arrays_size(&method->code);
+    int32_t *operand_stack = calloc(frame_size, sizeof(int32_t));
+    assert(operand_stack != NULL && "Failed to allocate operand stack");
+    int32_t *local_arrays = &operand_stack[method->code.max_stack];
     int32_t stack_idx = 0;
+    // Any local or stack entry may hold a reference that keeps an object alive
+    heap_push_roots(heap, locals, method->code.max_locals);
+    heap_push_roots(heap, operand_stack,
+                    method->code.max_stack + method->code.local_arrays_count);
+    // The exception being thrown, while unwinding to its handler
+    int32_t exception = NULL_REFERENCE;
     while (pc < method->code.code_length) {
         switch (method->code.code[pc]) {
             case i_bipush: {
@@ -64,16 +310,218 @@ optional_value_t execute(method_t *method, int32_t *locals, class_file_t *class,
             }
             case i_return: {
                 optional_value_t result = {.has_value = false};
-                free(operand_stack);
+                leave_frame(heap, &method->code, operand_stack);
                 return result;
             }
-            case i_getstatic: {
+            case i_getstatic:
+            case i_putstatic: {
+                // Resolve the field to the address of its value, then run the quick form
+                u2 index = read_u2_operand(&method->code, pc + 1);
+                member_ref_t ref = get_field_ref(index, class);
+                class->constant_pool[index - 1].resolved =
+                    resolve_static_field(ref, loader, heap);
+                method->code.code[pc] = method->code.code[pc] == i_getstatic
+                                            ? i_getstatic_quick
+                                            : i_putstatic_quick;
+                break;
+            }
+            case i_getstatic_quick: {
+                u2 index = read_u2_operand(&method->code, pc + 1);
+                const int32_t *address = class->constant_pool[index - 1].resolved;
+                operand_stack[stack_idx] = *address;
+                stack_idx += 1;
+                pc += 3;
+                break;
+            }
+            case i_putstatic_quick: {
+                u2 index = read_u2_operand(&method->code, pc + 1);
+                int32_t *address = (int32_t *) class->constant_pool[index - 1].resolved;
+                stack_idx -= 1;
+                *address = operand_stack[stack_idx];
                 pc += 3;
                 break;
             }
             case i_invokevirtual: {
+                // Resolve the method to its vtable index, then run the quick form
+                u2 index = read_u2_operand(&method->code, pc + 1);
+                member_ref_t ref = get_method_ref(index, class);
+                if (strcmp(ref.class_name, "java/io/PrintStream") == 0) {
+                    assert(strcmp(ref.name, "println") == 0 &&
+                           "Unsupported PrintStream method");
+                    if (strcmp(ref.descriptor, "(Ljava/lang/String;)V") == 0) {
+                        method->code.code[pc] = i_println_string;
+                    }
+                    else {
+                        assert(strcmp(ref.descriptor, "(I)V") == 0 &&
+                               "Unsupported PrintStream method");
+                        method->code.code[pc] = i_println_int;
+                    }
+                    break;
+                }
+                class_file_t *callee_class = load_class(loader, ref.class_name);
+                assert(callee_class != NULL && "Class not found");
+                method_t *callee_method =
+                    find_inherited_method(loader, callee_class, ref.name, ref.descriptor);
+                assert(callee_method != NULL && "Unknown method");
+                // A method declared by an interface is looked up in the receiver's itable
+                link_class(loader, callee_method->class);
+                if ((callee_method->access_flags & IS_PRIVATE) != 0) {
+                    // Private methods can't be overridden, so they're called directly
+                    class->constant_pool[index - 1].resolved = callee_method;
+                    method->code.code[pc] = i_invokespecial_quick;
+                    break;
+                }
+                write_u2_operand(&method->code, pc + 1,
+                                 add_inline_cache(&method->code, callee_method));
+                method->code.code[pc] = i_invokevirtual_quick;
+                break;
+            }
+            case i_invokeinterface: {
+                // Resolve the interface method, then run the quick form
+                u2 index = read_u2_operand(&method->code, pc + 1);
+                member_ref_t ref = get_method_ref(index, class);
+                class_file_t *interface = load_class(loader, ref.class_name);
+                assert(interface != NULL && "Class not found");
+                method_t *callee_method =
+                    find_inherited_method(loader, interface, ref.name, ref.descriptor);
+                assert(callee_method != NULL && "Unknown method");
+                link_class(loader, callee_method->class);
+                write_u2_operand(&method->code, pc + 1,
+                                 add_inline_cache(&method->code, callee_method));
+                method->code.code[pc] = i_invokeinterface_quick;
+                break;
+            }
+            case i_invokevirtual_quick:
+            case i_invokeinterface_quick: {
+                inline_cache_t *cache =
+                    &method->code.inline_caches[read_u2_operand(&method->code, pc + 1)];
+                int32_t receiver = operand_stack[stack_idx - 1 - cache->parameters];
+                if (receiver == NULL_REFERENCE) {
+                    exception = new_exception(loader, heap, NULL_POINTER_EXCEPTION, NULL);
+                    goto throw_exception;
+                }
+                class_file_t *receiver_class =
+                    get_class_by_id(loader, heap_get(heap, receiver)[0]);
+                method_t *callee_method = dispatch_method(loader, cache, receiver_class);
+                // invokeinterface has two more operand bytes, which are unused
+                size_t length = method->code.code[pc] == i_invokevirtual_quick ? 3 : 5;
+                exception =
+                    invoke_method(callee_method, operand_stack, &stack_idx, loader, heap);
+                if (exception != NULL_REFERENCE) {
+                    goto throw_exception;
+                }
+                pc += length;
+                break;
+            }
+            case i_println_int: {
+                // PrintStream.println(int), called on System.out
                 stack_idx -= 1;
                 printf("%d\n", operand_stack[stack_idx]);
+                stack_idx -= 1;
+                pc += 3;
+                break;
+            }
+            case i_println_string: {
+                // PrintStream.println(String), called on System.out
+                stack_idx -= 1;
+                int32_t reference = operand_stack[stack_idx];
+                if (reference == NULL_REFERENCE) {
+                    fputs("null", stdout);
+                }
+                else {
+                    size_t length;
+                    const char *string = get_string(heap, reference, &length);
+                    fwrite(string, 1, length, stdout);
+                }
+                putchar('\n');
+                stack_idx -= 1;
+                pc += 3;
+                break;
+            }
+            case i_new: {
+                // Load, link, and initialize the class, then run the quick form
+                u2 index = read_u2_operand(&method->code, pc + 1);
+                class_file_t *object_class =
+                    load_class(loader, get_class_name(class->constant_pool, index));
+                assert(object_class != NULL && "Class not found");
+                link_class(loader, object_class);
+                initialize_class(object_class, loader, heap);
+                class->constant_pool[index - 1].resolved = object_class;
+                method->code.code[pc] = i_new_quick;
+                break;
+            }
+            case i_new_quick: {
+                u2 index = read_u2_operand(&method->code, pc + 1);
+                const class_file_t *object_class =
+                    class->constant_pool[index - 1].resolved;
+                heap_set_allocation_site(heap, allocation_site(&method->code, pc));
+                int32_t object =
+                    heap_new_object(heap, object_class->id, object_class->instance_size);
+                exception = check_allocation(loader, heap, object);
+                if (exception != NULL_REFERENCE) {
+                    goto throw_exception;
+                }
+                operand_stack[stack_idx] = object;
+                stack_idx += 1;
+                pc += 3;
+                break;
+            }
+            case i_getfield:
+            case i_putfield: {
+                // Resolve the field and replace the operand with the field's offset
+                u2 index = read_u2_operand(&method->code, pc + 1);
+                member_ref_t ref = get_field_ref(index, class);
+                class_file_t *field_class = load_class(loader, ref.class_name);
+                assert(field_class != NULL && "Class not found");
+                field_t *field =
+                    find_inherited_field(loader, field_class, ref.name, ref.descriptor);
+                assert(field != NULL && "Unknown field");
+                link_class(loader, field->class);
+                write_u2_operand(&method->code, pc + 1, field->slot);
+                if (method->code.code[pc] == i_getfield) {
+                    method->code.code[pc] = i_getfield_quick;
+                }
+                else {
+                    // Stores of references go through the write barrier
+                    bool is_reference = field->descriptor[0] == 'L' ||
+                                        field->descriptor[0] == '[';
+                    method->code.code[pc] =
+                        is_reference ? i_putfield_reference : i_putfield_quick;
+                }
+                break;
+            }
+            case i_getfield_quick: {
+                u2 offset = read_u2_operand(&method->code, pc + 1);
+                int32_t object = operand_stack[stack_idx - 1];
+                if (object == NULL_REFERENCE) {
+                    exception = new_exception(loader, heap, NULL_POINTER_EXCEPTION, NULL);
+                    goto throw_exception;
+                }
+                operand_stack[stack_idx - 1] = heap_get(heap, object)[offset];
+                pc += 3;
+                break;
+            }
+            case i_putfield_quick: {
+                u2 offset = read_u2_operand(&method->code, pc + 1);
+                int32_t object = operand_stack[stack_idx - 2];
+                if (object == NULL_REFERENCE) {
+                    exception = new_exception(loader, heap, NULL_POINTER_EXCEPTION, NULL);
+                    goto throw_exception;
+                }
+                heap_get(heap, object)[offset] = operand_stack[stack_idx - 1];
+                stack_idx -= 2;
+                pc += 3;
+                break;
+            }
+            case i_putfield_reference: {
+                u2 offset = read_u2_operand(&method->code, pc + 1);
+                int32_t object = operand_stack[stack_idx - 2];
+                if (object == NULL_REFERENCE) {
+                    exception = new_exception(loader, heap, NULL_POINTER_EXCEPTION, NULL);
+                    goto throw_exception;
+                }
+                heap_store_reference(heap, object, offset, operand_stack[stack_idx - 1]);
+                stack_idx -= 2;
                 pc += 3;
                 break;
             }
@@ -105,18 +553,32 @@ optional_value_t execute(method_t *method, int32_t *locals, class_file_t *class,
                 break;
             }
             case i_idiv: {
-                assert(operand_stack[stack_idx - 1] != 0);
+                if (operand_stack[stack_idx - 1] == 0) {
+                    exception =
+                        new_exception(loader, heap, ARITHMETIC_EXCEPTION, "/ by zero");
+                    goto throw_exception;
+                }
                 stack_idx -= 1;
+                // Dividing INT_MIN by -1 overflows, which traps on x86, so negate instead
                 operand_stack[stack_idx - 1] =
-                    operand_stack[stack_idx - 1] / operand_stack[stack_idx];
+                    operand_stack[stack_idx] == -1
+                        ? (int32_t) (0 - (uint32_t) operand_stack[stack_idx - 1])
+                        : operand_stack[stack_idx - 1] / operand_stack[stack_idx];
                 pc += 1;
                 break;
             }
             case i_irem: {
-                assert(operand_stack[stack_idx - 1] != 0);
+                if (operand_stack[stack_idx - 1] == 0) {
+                    exception =
+                        new_exception(loader, heap, ARITHMETIC_EXCEPTION, "/ by zero");
+                    goto throw_exception;
+                }
                 stack_idx -= 1;
+                // Any int's remainder by -1 is 0, and INT_MIN % -1 traps too
                 operand_stack[stack_idx - 1] =
-                    operand_stack[stack_idx - 1] % operand_stack[stack_idx];
+                    operand_stack[stack_idx] == -1
+                        ? 0
+                        : operand_stack[stack_idx - 1] % operand_stack[stack_idx];
                 pc += 1;
                 break;
             }
@@ -198,13 +660,36 @@ optional_value_t execute(method_t *method, int32_t *locals, class_file_t *class,
                 pc += 3;
                 break;
             }
-            case i_ldc: {
-                int32_t const_idx = (int32_t) method->code.code[pc + 1] - 1;
-                operand_stack[stack_idx] =
-                    ((CONSTANT_Integer_info *) class->constant_pool[const_idx].info)
-                        ->bytes;
+            case i_ldc:
+            case i_ldc_w: {
+                bool wide = method->code.code[pc] == i_ldc_w;
+                u2 index = wide ? read_u2_operand(&method->code, pc + 1)
+                                : method->code.code[pc + 1];
+                cp_info *constant = &class->constant_pool[index - 1];
+                if (constant->tag == CONSTANT_String) {
+                    // Intern the string, then run the quick form
+                    constant->resolved = intern_string(
+                        heap, get_string_constant(class->constant_pool, index));
+                    method->code.code[pc] = wide ? i_ldc_w_string : i_ldc_string;
+                    break;
+                }
+                assert(constant->tag == CONSTANT_Integer && "Unsupported constant");
+                CONSTANT_Integer_info *value = constant->info;
+                operand_stack[stack_idx] = value->bytes;
                 stack_idx += 1;
-                pc += 2;
+                pc += wide ? 3 : 2;
+                break;
+            }
+            case i_ldc_string:
+            case i_ldc_w_string: {
+                bool wide = method->code.code[pc] == i_ldc_w_string;
+                u2 index = wide ? read_u2_operand(&method->code, pc + 1)
+                                : method->code.code[pc + 1];
+                const interned_string_t *string =
+                    class->constant_pool[index - 1].resolved;
+                operand_stack[stack_idx] = string->reference;
+                stack_idx += 1;
+                pc += wide ? 3 : 2;
                 break;
             }
             case i_ifeq: {
@@ -351,62 +836,348 @@ optional_value_t execute(method_t *method, int32_t *locals, class_file_t *class,
                 stack_idx -= 2;
                 break;
             }
+            case i_if_acmpeq: {
+                if (operand_stack[stack_idx - 2] == operand_stack[stack_idx - 1]) {
+                    pc += read_s2_operand(&method->code, pc + 1);
+                }
+                else {
+                    pc += 3;
+                }
+                stack_idx -= 2;
+                break;
+            }
+            case i_if_acmpne: {
+                if (operand_stack[stack_idx - 2] != operand_stack[stack_idx - 1]) {
+                    pc += read_s2_operand(&method->code, pc + 1);
+                }
+                else {
+                    pc += 3;
+                }
+                stack_idx -= 2;
+                break;
+            }
+            case i_ifnull: {
+                stack_idx -= 1;
+                if (operand_stack[stack_idx] == NULL_REFERENCE) {
+                    pc += read_s2_operand(&method->code, pc + 1);
+                }
+                else {
+                    pc += 3;
+                }
+                break;
+            }
+            case i_ifnonnull: {
+                stack_idx -= 1;
+                if (operand_stack[stack_idx] != NULL_REFERENCE) {
+                    pc += read_s2_operand(&method->code, pc + 1);
+                }
+                else {
+                    pc += 3;
+                }
+                break;
+            }
             case i_goto: {
                 int16_t b1 = method->code.code[pc + 1];
                 int8_t b2 = method->code.code[pc + 2];
                 pc += ((b1 << 8) | b2);
                 break;
             }
+            case i_tableswitch: {
+                // Decode the jump table once, then run the quick form
+                int32_t *operands = switch_operands(&method->code, pc);
+                decode_s4_operands(operands, 3);
+                decode_s4_operands(&operands[3], operands[2] - operands[1] + 1);
+                method->code.code[pc] = i_tableswitch_quick;
+                break;
+            }
+            case i_tableswitch_quick: {
+                int32_t *operands = switch_operands(&method->code, pc);
+                stack_idx -= 1;
+                // Unsigned arithmetic checks both low <= key and key <= high
+                uint32_t index =
+                    (uint32_t) operand_stack[stack_idx] - (uint32_t) operands[1];
+                if (index <= (uint32_t) operands[2] - (uint32_t) operands[1]) {
+                    pc += operands[3 + index];
+                }
+                else {
+                    pc += operands[0];
+                }
+                break;
+            }
+            case i_lookupswitch: {
+                // Decode the match-offset pairs once, then run the quick form
+                int32_t *operands = switch_operands(&method->code, pc);
+                decode_s4_operands(operands, 2);
+                decode_s4_operands(&operands[2], 2 * operands[1]);
+                method->code.code[pc] = i_lookupswitch_quick;
+                break;
+            }
+            case i_lookupswitch_quick: {
+                int32_t *operands = switch_operands(&method->code, pc);
+                stack_idx -= 1;
+                pc += lookup_switch_offset(operands, operand_stack[stack_idx]);
+                break;
+            }
             case i_ireturn: {
                 stack_idx -= 1;
                 optional_value_t result = {.has_value = true,
                                            .value = operand_stack[stack_idx]};
-                free(operand_stack);
+                leave_frame(heap, &method->code, operand_stack);
                 return result;
             }
             case i_invokestatic: {
-                int16_t b1 = method->code.code[pc + 1];
-                int8_t b2 = method->code.code[pc + 2];
-                method_t *callee_method = find_method_from_index((b1 << 8) | b2, class);
-                int16_t num_params = get_number_of_parameters(callee_method);
-                int32_t *callee_locals =
-                    calloc(sizeof(int32_t), callee_method->code.max_locals);
-                for (int32_t i = num_params - 1; i >= 0; i--) {
-                    stack_idx -= 1;
-                    callee_locals[i] = operand_stack[stack_idx];
-                }
-                optional_value_t ret = execute(callee_method, callee_locals, class, heap);
-                free(callee_locals);
-                if (ret.has_value) {
-                    operand_stack[stack_idx] = ret.value;
+                // Resolve the call site, then run its quick form
+                u2 index = read_u2_operand(&method->code, pc + 1);
+                cp_info *constant = &class->constant_pool[index - 1];
+                member_ref_t ref = get_method_ref(index, class);
+                const intrinsic_t *intrinsic =
+                    find_intrinsic(ref.class_name, ref.name, ref.descriptor);
+                if (intrinsic != NULL) {
+                    constant->resolved = intrinsic;
+                    method->code.code[pc] = intrinsic->instruction;
+                }
+                else {
+                    // Load the method's class the first time it is referenced
+                    class_file_t *callee_class = load_class(loader, ref.class_name);
+                    assert(callee_class != NULL && "Class not found");
+                    method_t *callee_method = find_inherited_method(
+                        loader, callee_class, ref.name, ref.descriptor);
+                    assert(callee_method != NULL && "Unknown method");
+                    initialize_class(callee_method->class, loader, heap);
+                    constant->resolved = callee_method;
+                    method->code.code[pc] = i_invokestatic_quick;
+                }
+                break;
+            }
+            case i_invokestatic_quick:
+            case i_invokespecial_quick: {
+                u2 index = read_u2_operand(&method->code, pc + 1);
+                method_t *callee_method =
+                    (method_t *) class->constant_pool[index - 1].resolved;
+                exception =
+                    invoke_method(callee_method, operand_stack, &stack_idx, loader, heap);
+                if (exception != NULL_REFERENCE) {
+                    goto throw_exception;
+                }
+                pc += 3;
+                break;
+            }
+            case i_invokespecial: {
+                // Resolve the constructor, private method, or superclass method
+                u2 index = read_u2_operand(&method->code, pc + 1);
+                member_ref_t ref = get_method_ref(index, class);
+                class_file_t *callee_class = load_class(loader, ref.class_name);
+                if (callee_class == NULL) {
+                    // Library classes aren't on the classpath,
+                    // but Object's constructor is empty anyway
+                    assert(strcmp(ref.class_name, "java/lang/Object") == 0 &&
+                           strcmp(ref.name, "<init>") == 0 && "Class not found");
+                    method->code.code[pc] = i_object_init;
+                    break;
+                }
+                method_t *callee_method =
+                    find_inherited_method(loader, callee_class, ref.name, ref.descriptor);
+                assert(callee_method != NULL && "Unknown method");
+                class->constant_pool[index - 1].resolved = callee_method;
+                method->code.code[pc] = i_invokespecial_quick;
+                break;
+            }
+            case i_object_init: {
+                // Pop the receiver
+                stack_idx -= 1;
+                pc += 3;
+                break;
+            }
+            case i_invokestatic_intrinsic: {
+                u2 index = read_u2_operand(&method->code, pc + 1);
+                const intrinsic_t *intrinsic = class->constant_pool[index - 1].resolved;
+                // The arguments are already in order on the operand stack
+                stack_idx -= intrinsic->parameters;
+                int32_t value;
+                exception =
+                    intrinsic->function(&operand_stack[stack_idx], loader, heap, &value);
+                if (exception != NULL_REFERENCE) {
+                    goto throw_exception;
+                }
+                if (intrinsic->has_value) {
+                    operand_stack[stack_idx] = value;
                     stack_idx += 1;
                 }
                 pc += 3;
                 break;
             }
+            case i_math_abs: {
+                // Branchless: flip the bits and add 1 only if negative
+                uint32_t value = operand_stack[stack_idx - 1];
+                uint32_t sign = -(value >> 31);
+                operand_stack[stack_idx - 1] = (value ^ sign) - sign;
+                pc += 3;
+                break;
+            }
+            case i_math_min: {
+                stack_idx -= 1;
+                int32_t a = operand_stack[stack_idx - 1];
+                int32_t b = operand_stack[stack_idx];
+                operand_stack[stack_idx - 1] = a <= b ? a : b;
+                pc += 3;
+                break;
+            }
+            case i_math_max: {
+                stack_idx -= 1;
+                int32_t a = operand_stack[stack_idx - 1];
+                int32_t b = operand_stack[stack_idx];
+                operand_stack[stack_idx - 1] = a >= b ? a : b;
+                pc += 3;
+                break;
+            }
+            case i_integer_bit_count: {
+                operand_stack[stack_idx - 1] =
+                    __builtin_popcount((uint32_t) operand_stack[stack_idx - 1]);
+                pc += 3;
+                break;
+            }
+            case i_integer_trailing_zeros: {
+                // __builtin_ctz() is undefined for 0, but Java defines the result as 32
+                uint32_t value = operand_stack[stack_idx - 1];
+                operand_stack[stack_idx - 1] = value == 0 ? 32 : __builtin_ctz(value);
+                pc += 3;
+                break;
+            }
+            case i_integer_leading_zeros: {
+                uint32_t value = operand_stack[stack_idx - 1];
+                operand_stack[stack_idx - 1] = value == 0 ? 32 : __builtin_clz(value);
+                pc += 3;
+                break;
+            }
+            case i_copy_loop: {
+                const copy_loop_t *loop = get_copy_loop(&method->code, pc);
+                if (run_copy_loop(loop, locals, heap)) {
+                    pc = loop->end;
+                }
+                else {
+                    // Run the loop normally, starting with its original iload of i
+                    operand_stack[stack_idx] = locals[loop->index];
+                    stack_idx += 1;
+                    pc += loop->index_load_length;
+                }
+                break;
+            }
             case i_nop: {
                 pc += 1;
                 break;
             }
+            case i_aconst_null: {
+                operand_stack[stack_idx] = NULL_REFERENCE;
+                stack_idx += 1;
+                pc += 1;
+                break;
+            }
+            case i_pop: {
+                stack_idx -= 1;
+                pc += 1;
+                break;
+            }
             case i_dup: {
                 operand_stack[stack_idx] = operand_stack[stack_idx - 1];
                 stack_idx += 1;
                 pc += 1;
                 break;
             }
+            case i_dup_x1: {
+                // Copy the top value beneath the value below it, e.g. for `return x++;`
+                int32_t top = operand_stack[stack_idx - 1];
+                operand_stack[stack_idx - 1] = operand_stack[stack_idx - 2];
+                operand_stack[stack_idx - 2] = top;
+                operand_stack[stack_idx] = top;
+                stack_idx += 1;
+                pc += 1;
+                break;
+            }
+            case i_newarray_local: {
+                u1 index = method->code.code[pc + 1];
+                int32_t length = method->code.local_arrays[index].length;
+                // Another path can jump to the allocation with a different length
+                if (operand_stack[stack_idx - 1] == length) {
+                    heap_set_allocation_site(heap, allocation_site(&method->code, pc));
+                    operand_stack[stack_idx - 1] =
+                        new_local_array(heap, &method->code, index, local_arrays);
+                    pc += 2;
+                    break;
+                }
+            }
+            // fall through
             case i_newarray: {
-                int32_t *array =
-                    calloc(sizeof(int32_t), operand_stack[stack_idx - 1] + 1);
-                array[0] = operand_stack[stack_idx - 1];
-                for (int i = 1; i <= operand_stack[stack_idx - 1]; i++) {
-                    array[i] = 0;
-                }
-                int32_t ref = heap_add(heap, array);
-                operand_stack[stack_idx - 1] = ref;
+                exception =
+                    check_array_length(loader, heap, operand_stack[stack_idx - 1]);
+                if (exception != NULL_REFERENCE) {
+                    goto throw_exception;
+                }
+                if (allocation_profile.interval != 0) {
+                    size_t ints = heap_array_memory_size(operand_stack[stack_idx - 1]);
+                    profile_allocation(method, pc, sizeof(int32_t[ints]));
+                }
+                heap_set_allocation_site(heap, allocation_site(&method->code, pc));
+                int32_t array = heap_new_array(heap, operand_stack[stack_idx - 1]);
+                exception = check_allocation(loader, heap, array);
+                if (exception != NULL_REFERENCE) {
+                    goto throw_exception;
+                }
+                operand_stack[stack_idx - 1] = array;
                 pc += 2;
                 break;
             }
+            case i_anewarray: {
+                exception =
+                    check_array_length(loader, heap, operand_stack[stack_idx - 1]);
+                if (exception != NULL_REFERENCE) {
+                    goto throw_exception;
+                }
+                // Reference elements start out as null, which is also 0
+                heap_set_allocation_site(heap, allocation_site(&method->code, pc));
+                int32_t array =
+                    heap_new_reference_array(heap, operand_stack[stack_idx - 1]);
+                exception = check_allocation(loader, heap, array);
+                if (exception != NULL_REFERENCE) {
+                    goto throw_exception;
+                }
+                operand_stack[stack_idx - 1] = array;
+                pc += 3;
+                break;
+            }
+            case i_multianewarray: {
+                u1 dimensions = method->code.code[pc + 3];
+                for (u1 dimension = 0; dimension < dimensions; dimension++) {
+                    exception = check_array_length(
+                        loader, heap, operand_stack[stack_idx - dimensions + dimension]);
+                    if (exception != NULL_REFERENCE) {
+                        goto throw_exception;
+                    }
+                }
+                exception = check_multi_array_size(
+                    loader, heap, &operand_stack[stack_idx - dimensions], dimensions);
+                if (exception != NULL_REFERENCE) {
+                    goto throw_exception;
+                }
+                u2 type_index = read_u2_operand(&method->code, pc + 1);
+                const char *type = get_class_name(class->constant_pool, type_index);
+                int32_t array = allocate_multi_array(
+                    heap, type, &operand_stack[stack_idx - dimensions], dimensions,
+                    allocation_site(&method->code, pc));
+                exception = check_allocation(loader, heap, array);
+                if (exception != NULL_REFERENCE) {
+                    goto throw_exception;
+                }
+                stack_idx -= dimensions;
+                operand_stack[stack_idx] = array;
+                stack_idx += 1;
+                pc += 4;
+                break;
+            }
             case i_arraylength: {
+                if (operand_stack[stack_idx - 1] == NULL_REFERENCE) {
+                    exception = new_exception(loader, heap, NULL_POINTER_EXCEPTION, NULL);
+                    goto throw_exception;
+                }
                 int32_t len = heap_get(heap, operand_stack[stack_idx - 1])[0];
                 operand_stack[stack_idx - 1] = len;
                 pc += 1;
@@ -416,10 +1187,15 @@ optional_value_t execute(method_t *method, int32_t *locals, class_file_t *class,
                 stack_idx -= 1;
                 optional_value_t result = {.has_value = true,
                                            .value = operand_stack[stack_idx]};
-                free(operand_stack);
+                leave_frame(heap, &method->code, operand_stack);
                 return result;
             }
             case i_iastore: {
+                exception = check_array_index(loader, heap, operand_stack[stack_idx - 3],
+                                              operand_stack[stack_idx - 2]);
+                if (exception != NULL_REFERENCE) {
+                    goto throw_exception;
+                }
                 heap_get(heap,
                          operand_stack[stack_idx - 3])[operand_stack[stack_idx - 2] + 1] =
                     operand_stack[stack_idx - 1];
@@ -427,7 +1203,26 @@ optional_value_t execute(method_t *method, int32_t *locals, class_file_t *class,
                 pc += 1;
                 break;
             }
-            case i_iaload: {
+            case i_aastore: {
+                exception = check_array_index(loader, heap, operand_stack[stack_idx - 3],
+                                              operand_stack[stack_idx - 2]);
+                if (exception != NULL_REFERENCE) {
+                    goto throw_exception;
+                }
+                heap_store_reference(heap, operand_stack[stack_idx - 3],
+                                     operand_stack[stack_idx - 2] + 1,
+                                     operand_stack[stack_idx - 1]);
+                stack_idx -= 3;
+                pc += 1;
+                break;
+            }
+            case i_iaload:
+            case i_aaload: {
+                exception = check_array_index(loader, heap, operand_stack[stack_idx - 2],
+                                              operand_stack[stack_idx - 1]);
+                if (exception != NULL_REFERENCE) {
+                    goto throw_exception;
+                }
                 stack_idx -= 1;
                 operand_stack[stack_idx - 1] = heap_get(
                     heap, operand_stack[stack_idx - 1])[operand_stack[stack_idx] + 1];
@@ -460,34 +1255,284 @@ optional_value_t execute(method_t *method, int32_t *locals, class_file_t *class,
                 pc += 1;
                 break;
             }
+            case i_athrow: {
+                exception = operand_stack[stack_idx - 1];
+                if (exception == NULL_REFERENCE) {
+                    exception = new_exception(loader, heap, NULL_POINTER_EXCEPTION, NULL);
+                }
+                goto throw_exception;
+            }
+        }
+        continue;
+
+    throw_exception: {
+        // Jump to the method's handler for the exception, if it has one
+        class_file_t *exception_class =
+            get_class_by_id(loader, heap_get(heap, exception)[0]);
+        if (!find_exception_handler(loader, class, &method->code, &pc, exception_class)) {
+            // Otherwise, the caller looks for a handler
+            leave_frame(heap, &method->code, operand_stack);
+            optional_value_t result = {.has_value = false, .exception = exception};
+            return result;
         }
+        // The handler starts with only the exception on the operand stack
+        operand_stack[0] = exception;
+        stack_idx = 1;
     }
-    free(operand_stack);
+    }
+    leave_frame(heap, &method->code, operand_stack);
 
     // Return void
     optional_value_t result = {.has_value = false};
     return result;
 }
 
+/** The file extension of class files */
+const char CLASS_FILE_EXTENSION[] = ".class";
+/** The option that sets the number of threads full collections run on */
+const char GC_THREADS_OPTION[] = "-XX:ParallelGCThreads=";
+/** The option that makes full collections incremental, with a target pause in ms */
+const char PAUSE_TARGET_OPTION[] = "-XX:MaxGCPauseMillis=";
+/** The option that logs collections to a file */
+const char GC_LOG_OPTION[] = "-Xloggc:";
+/** The option that profiles one in every n newarray allocations */
+const char ALLOCATION_PROFILE_OPTION[] = "-XX:AllocationProfileInterval=";
+/** The option that sets the file SIGUSR1 dumps the heap to */
+const char HEAP_DUMP_OPTION[] = "-XX:HeapDumpPath=";
+/** The option that also dumps the heap to that file when main() returns */
+const char HEAP_DUMP_AT_EXIT_OPTION[] = "-XX:+HeapDumpAtExit";
+
+/** The heap that SIGUSR1 dumps */
+heap_t *signal_heap = NULL;
+
+/** Handles SIGUSR1 by asking for a heap dump, which is written at the next allocation */
+void request_heap_dump(int signal) {
+    (void) signal;
+    heap_request_dump(signal_heap);
+}
+
+/**
+ * Parses a size in bytes with an optional k, m, or g suffix, as in -Xmx512m.
+ *
+ * @param string the size
+ * @param size set to the number of bytes
+ * @return whether the size is valid
+ */
+bool parse_size(const char *string, size_t *size) {
+    char *end;
+    unsigned long long value = strtoull(string, &end, 10);
+    if (end == string) {
+        return false;
+    }
+    switch (*end) {
+        case 'g':
+        case 'G':
+            value <<= 10;
+            // fall through
+        case 'm':
+        case 'M':
+            value <<= 10;
+            // fall through
+        case 'k':
+        case 'K':
+            value <<= 10;
+            end++;
+            break;
+    }
+    *size = value;
+    return *end == '\0' && value > 0;
+}
+
+/** The collector's reference map: the reference fields of a class's objects */
+const uint16_t *get_reference_slots(void *context, int32_t class_id, uint16_t *count) {
+    // Strings hold their characters or the index of them, not references
+    if (class_id == STRING_CLASS_ID) {
+        *count = 0;
+        return NULL;
+    }
+    const class_file_t *class = get_class_by_id(context, class_id);
+    *count = class->reference_slots_count;
+    return class->reference_slots;
+}
+
 int main(int argc, char *argv[]) {
-    if (argc != 2) {
-        fprintf(stderr, "USAGE: %s <class file>\n", argv[0]);
+    // Parse the options, which come before the class to run
+    const char *classpath = NULL;
+    bool dump_at_exit = false;
+    bool preload = false;
+    bool stats = false;
+    heap_options_t heap_options = DEFAULT_HEAP_OPTIONS;
+    // Full collections run on every processor by default
+    long processors = sysconf(_SC_NPROCESSORS_ONLN);
+    heap_options.gc_threads = processors > 0 ? (size_t) processors : 1;
+    int arg = 1;
+    for (; arg < argc - 1; arg++) {
+        if (strcmp(argv[arg], "-cp") == 0 && arg + 1 < argc - 1) {
+            arg++;
+            classpath = argv[arg];
+        }
+        else if (strcmp(argv[arg], "-preload") == 0) {
+            preload = true;
+        }
+        else if (strcmp(argv[arg], "-stats") == 0) {
+            stats = true;
+        }
+        else if (strncmp(argv[arg], "-Xmn", 4) == 0) {
+            // The size of each half of the young generation
+            if (!parse_size(&argv[arg][4], &heap_options.young_size)) {
+                break;
+            }
+        }
+        else if (strncmp(argv[arg], "-Xmx", 4) == 0) {
+            if (!parse_size(&argv[arg][4], &heap_options.max_size)) {
+                break;
+            }
+        }
+        else if (strncmp(argv[arg], GC_THREADS_OPTION, strlen(GC_THREADS_OPTION)) == 0) {
+            char *end;
+            long threads = strtol(&argv[arg][strlen(GC_THREADS_OPTION)], &end, 10);
+            if (*end != '\0' || threads < 1) {
+                break;
+            }
+            heap_options.gc_threads = threads;
+        }
+        else if (strncmp(argv[arg], PAUSE_TARGET_OPTION, strlen(PAUSE_TARGET_OPTION)) ==
+                 0) {
+            char *end;
+            double pause = strtod(&argv[arg][strlen(PAUSE_TARGET_OPTION)], &end);
+            if (*end != '\0' || !(pause > 0)) {
+                break;
+            }
+            heap_options.pause_target = pause;
+        }
+        else if (strcmp(argv[arg], "-XX:+UseTransparentHugePages") == 0) {
+            heap_options.large_pages = LARGE_PAGES_TRANSPARENT;
+        }
+        else if (strcmp(argv[arg], "-XX:+UseLargePages") == 0) {
+            heap_options.large_pages = LARGE_PAGES_EXPLICIT;
+        }
+        else if (strcmp(argv[arg], "-XX:+UseNUMA") == 0) {
+            heap_options.numa = true;
+        }
+        else if (strcmp(argv[arg], "-XX:+UseNUMAPinning") == 0) {
+            heap_options.numa = true;
+            heap_options.numa_pinning = true;
+        }
+        else if (strcmp(argv[arg], "-verbose:gc") == 0) {
+            heap_options.log = stderr;
+        }
+        else if (strncmp(argv[arg], GC_LOG_OPTION, strlen(GC_LOG_OPTION)) == 0) {
+            heap_options.log = fopen(&argv[arg][strlen(GC_LOG_OPTION)], "w");
+            if (heap_options.log == NULL) {
+                perror(&argv[arg][strlen(GC_LOG_OPTION)]);
+                return 1;
+            }
+        }
+        else if (strncmp(argv[arg], ALLOCATION_PROFILE_OPTION,
+                         strlen(ALLOCATION_PROFILE_OPTION)) == 0) {
+            char *end;
+            long interval =
+                strtol(&argv[arg][strlen(ALLOCATION_PROFILE_OPTION)], &end, 10);
+            if (*end != '\0' || interval < 1 || interval > UINT32_MAX) {
+                break;
+            }
+            start_allocation_profile(interval);
+        }
+        else if (strncmp(argv[arg], HEAP_DUMP_OPTION, strlen(HEAP_DUMP_OPTION)) == 0) {
+            heap_options.dump_path = &argv[arg][strlen(HEAP_DUMP_OPTION)];
+        }
+        else if (strcmp(argv[arg], HEAP_DUMP_AT_EXIT_OPTION) == 0) {
+            dump_at_exit = true;
+        }
+        else {
+            break;
+        }
+    }
+    if (arg != argc - 1) {
+        fprintf(stderr,
+                "USAGE: %s [-cp <classpath>] [-preload] [-stats] [-Xmn<size>] "
+                "[-Xmx<size>] [%s<n>] [%s<ms>] [-XX:+UseTransparentHugePages] "
+                "[-XX:+UseLargePages] [-XX:+UseNUMA] [-XX:+UseNUMAPinning] "
+                "[-verbose:gc] [%s<file>] [%s<n>] [%s<file>] [%s] "
+                "<class file | class name>\n",
+                argv[0], GC_THREADS_OPTION, PAUSE_TARGET_OPTION, GC_LOG_OPTION,
+                ALLOCATION_PROFILE_OPTION, HEAP_DUMP_OPTION, HEAP_DUMP_AT_EXIT_OPTION);
+        return 1;
+    }
+    if (dump_at_exit && heap_options.dump_path == NULL) {
+        fprintf(stderr, "%s needs %s<file>\n", HEAP_DUMP_AT_EXIT_OPTION,
+                HEAP_DUMP_OPTION);
+        return 1;
+    }
+    if (heap_options.max_size <= 2 * heap_options.young_size) {
+        fprintf(stderr, "The maximum heap size must be more than twice -Xmn\n");
         return 1;
     }
 
-    // Open the class file for reading
-    FILE *class_file = fopen(argv[1], "r");
-    assert(class_file != NULL && "Failed to open file");
+    class_loader_t *loader = class_loader_init();
+    if (classpath != NULL) {
+        class_loader_add_path(loader, classpath);
+    }
+    class_file_t *class;
+    char *main_class = argv[arg];
+    size_t length = strlen(main_class);
+    size_t extension_length = sizeof(CLASS_FILE_EXTENSION) - 1;
+    if (length > extension_length &&
+        strcmp(&main_class[length - extension_length], CLASS_FILE_EXTENSION) == 0) {
+        // Open the class file for reading
+        FILE *class_file = fopen(main_class, "r");
+        assert(class_file != NULL && "Failed to open file");
+
+        // Parse the class file
+        class = get_class(class_file);
+        int error = fclose(class_file);
+        assert(error == 0 && "Failed to close file");
+        assert(class != NULL && "Malformed class file");
 
-    // Parse the class file
-    class_file_t *class = get_class(class_file);
-    int error = fclose(class_file);
-    assert(error == 0 && "Failed to close file");
+        // Other classes can also be loaded from the directory containing the class file
+        char *last_slash = strrchr(main_class, '/');
+        if (last_slash == NULL) {
+            class_loader_add_path(loader, ".");
+        }
+        else {
+            *last_slash = '\0';
+            class_loader_add_path(loader, last_slash == main_class ? "/" : main_class);
+        }
+        class_loader_add(loader, class);
+    }
+    else {
+        // A class name like com.example.Main, which is found on the classpath
+        if (classpath == NULL) {
+            class_loader_add_path(loader, ".");
+        }
+        for (char *c = main_class; *c != '\0'; c++) {
+            if (*c == '.') {
+                *c = '/';
+            }
+        }
+        class = load_class(loader, main_class);
+        assert(class != NULL && "Main class not found");
+    }
+    if (preload) {
+        // Parse the rest of the classpath on every processor before running anything
+        class_loader_preload(loader, processors > 0 ? (size_t) processors : 1);
+    }
 
-    // The heap array is initially allocated to hold zero elements.
-    heap_t *heap = heap_init();
+    // The collector finds the references in objects using their classes' layouts
+    heap_t *heap = heap_init(&heap_options);
+    heap_set_reference_map(heap, get_reference_slots, loader);
+    heap_set_site_names(heap, allocation_site_name, NULL);
+    if (heap_options.dump_path != NULL) {
+        signal_heap = heap;
+        struct sigaction action = {.sa_handler = request_heap_dump,
+                                   .sa_flags = SA_RESTART};
+        sigemptyset(&action.sa_mask);
+        int error = sigaction(SIGUSR1, &action, NULL);
+        assert(error == 0 && "Failed to handle SIGUSR1");
+    }
 
-    // Execute the main method
+    // Execute the main method, after initializing the main class
+    initialize_class(class, loader, heap);
     method_t *main_method = find_method(MAIN_METHOD, MAIN_DESCRIPTOR, class);
     assert(main_method != NULL && "Missing main() method");
     /* In a real JVM, locals[0] would contain a reference to String[] args.
@@ -495,12 +1540,30 @@ int main(int argc, char *argv[]) {
     int32_t locals[main_method->code.max_locals];
     // Initialize all local variables to 0
     memset(locals, 0, sizeof(locals));
-    optional_value_t result = execute(main_method, locals, class, heap);
+    optional_value_t result = execute(main_method, locals, class, loader, heap);
     assert(!result.has_value && "main() should return void");
+    if (result.exception != NULL_REFERENCE) {
+        print_uncaught_exception(stderr, loader, heap, result.exception);
+    }
+    if (dump_at_exit) {
+        heap_dump_now(heap);
+    }
+    if (stats) {
+        print_dispatch_stats(stderr);
+        heap_print_stats(heap, stderr);
+    }
+    print_allocation_profile(stderr);
 
-    // Free the internal data structures
-    free_class(class);
+    // Free the internal data structures, including every loaded class
+    class_loader_free(loader);
+    strings_free();
 
     // Free the heap
     heap_free(heap);
+    if (heap_options.log != NULL && heap_options.log != stderr) {
+        fclose(heap_options.log);
+    }
+    free_allocation_profile();
+    free_allocation_sites();
+    return result.exception == NULL_REFERENCE ? 0 : 1;
 }
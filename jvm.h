@@ -8,6 +8,7 @@
  */
 typedef enum {
     i_nop = 0x0,
+    i_aconst_null = 0x1,
     i_iconst_m1 = 0x2,
     i_iconst_0 = 0x3,
     i_iconst_1 = 0x4,
@@ -18,6 +19,7 @@ typedef enum {
     i_bipush = 0x10,
     i_sipush = 0x11,
     i_ldc = 0x12,
+    i_ldc_w = 0x13,
     i_iload = 0x15,
     i_aload = 0x19,
     i_iload_0 = 0x1a,
@@ -29,6 +31,7 @@ typedef enum {
     i_aload_2 = 0x2c,
     i_aload_3 = 0x2d,
     i_iaload = 0x2e,
+    i_aaload = 0x32,
     i_istore = 0x36,
     i_astore = 0x3a,
     i_istore_0 = 0x3b,
@@ -40,7 +43,10 @@ typedef enum {
     i_astore_2 = 0x4d,
     i_astore_3 = 0x4e,
     i_iastore = 0x4f,
+    i_aastore = 0x53,
+    i_pop = 0x57,
     i_dup = 0x59,
+    i_dup_x1 = 0x5a,
     i_iadd = 0x60,
     i_isub = 0x64,
     i_imul = 0x68,
@@ -66,15 +72,92 @@ typedef enum {
     i_if_icmpge = 0xa2,
     i_if_icmpgt = 0xa3,
     i_if_icmple = 0xa4,
+    i_if_acmpeq = 0xa5,
+    i_if_acmpne = 0xa6,
     i_goto = 0xa7,
+    i_tableswitch = 0xaa,
+    i_lookupswitch = 0xab,
     i_ireturn = 0xac,
     i_areturn = 0xb0,
     i_return = 0xb1,
     i_getstatic = 0xb2,
+    i_putstatic = 0xb3,
+    i_getfield = 0xb4,
+    i_putfield = 0xb5,
     i_invokevirtual = 0xb6,
+    i_invokespecial = 0xb7,
     i_invokestatic = 0xb8,
+    i_invokeinterface = 0xb9,
+    i_new = 0xbb,
     i_newarray = 0xbc,
-    i_arraylength = 0xbe
+    i_anewarray = 0xbd,
+    i_arraylength = 0xbe,
+    i_athrow = 0xbf,
+    i_multianewarray = 0xc5,
+    i_ifnull = 0xc6,
+    i_ifnonnull = 0xc7,
+
+    /*
+     * Internal "quick" opcodes. The JVM specification leaves these unassigned,
+     * so the interpreter rewrites an instruction into its quick form once the
+     * instruction's operands have been decoded the first time it runs.
+     */
+    /** A tableswitch whose jump table has been converted to host byte order */
+    i_tableswitch_quick = 0xcb,
+    /** A lookupswitch whose match-offset pairs have been converted to host byte order */
+    i_lookupswitch_quick = 0xcc,
+    /** An invokestatic whose Methodref has been resolved to a method_t */
+    i_invokestatic_quick = 0xcd,
+    /** An invokestatic whose Methodref has been resolved to an intrinsic_t */
+    i_invokestatic_intrinsic = 0xce,
+    /** The first instruction of an element-copy loop, replaced by one array copy */
+    i_copy_loop = 0xcf,
+    /*
+     * Calls to small library methods, which invokestatic is rewritten into
+     * so that the interpreter computes them inline.
+     */
+    /** Math.abs(int) */
+    i_math_abs = 0xd0,
+    /** Math.min(int, int) */
+    i_math_min = 0xd1,
+    /** Math.max(int, int) */
+    i_math_max = 0xd2,
+    /** Integer.bitCount(int) */
+    i_integer_bit_count = 0xd3,
+    /** Integer.numberOfTrailingZeros(int) */
+    i_integer_trailing_zeros = 0xd4,
+    /** Integer.numberOfLeadingZeros(int) */
+    i_integer_leading_zeros = 0xd5,
+    /** A getstatic whose Fieldref has been resolved to the address of the static */
+    i_getstatic_quick = 0xd6,
+    /** A putstatic whose Fieldref has been resolved to the address of the static */
+    i_putstatic_quick = 0xd7,
+    /** A new whose class has been loaded, laid out, and initialized */
+    i_new_quick = 0xd8,
+    /** A getfield whose operand has been replaced by the field's offset in the object */
+    i_getfield_quick = 0xd9,
+    /** A putfield whose operand has been replaced by the field's offset in the object */
+    i_putfield_quick = 0xda,
+    /** An invokespecial whose Methodref has been resolved to a method_t */
+    i_invokespecial_quick = 0xdb,
+    /** A call to the constructor of java/lang/Object, which does nothing */
+    i_object_init = 0xdc,
+    /** An invokevirtual whose operand has been replaced by its inline cache's index */
+    i_invokevirtual_quick = 0xdd,
+    /** A call to PrintStream.println(int) */
+    i_println_int = 0xde,
+    /** An invokeinterface whose index operand has been replaced by its inline cache's */
+    i_invokeinterface_quick = 0xdf,
+    /** A call to PrintStream.println(String) */
+    i_println_string = 0xe0,
+    /** An ldc of a CONSTANT_String, which has been resolved to an interned_string_t */
+    i_ldc_string = 0xe1,
+    /** An ldc_w of a CONSTANT_String, which has been resolved to an interned_string_t */
+    i_ldc_w_string = 0xe2,
+    /** A putfield_quick of a reference field, which records the store for the GC */
+    i_putfield_reference = 0xe3,
+    /** A newarray of an array that never leaves its method, allocated in the frame */
+    i_newarray_local = 0xe4
 } jvm_instruction_t;
 
 #endif /* JVM_H */
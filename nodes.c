@@ -0,0 +1,106 @@
+// Needed for sched_setaffinity()
+#define _GNU_SOURCE
+#include "nodes.h"
+
+#include <linux/mempolicy.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+/**
+ * Reads a list of ranges like "0-3,8-11" from a file in /sys.
+ *
+ * @param add called with each number in the list
+ * @return whether the file could be read
+ */
+bool read_list(const char *path, void (*add)(int number, void *arg), void *arg) {
+    FILE *file = fopen(path, "r");
+    if (file == NULL) {
+        return false;
+    }
+    int first, last;
+    while (fscanf(file, "%d", &first) == 1) {
+        last = first;
+        int separator = fgetc(file);
+        if (separator == '-') {
+            if (fscanf(file, "%d", &last) != 1) {
+                break;
+            }
+            separator = fgetc(file);
+        }
+        for (int number = first; number <= last; number++) {
+            add(number, arg);
+        }
+        if (separator != ',') {
+            break;
+        }
+    }
+    fclose(file);
+    return true;
+}
+
+/** Raises the count of nodes to include a node */
+void add_node(int node, void *arg) {
+    size_t *count = arg;
+    if (node >= 0 && (size_t) node + 1 > *count) {
+        *count = node + 1;
+    }
+}
+
+size_t count_nodes(void) {
+    size_t count = 0;
+    if (!read_list("/sys/devices/system/node/online", add_node, &count) ||
+        count == 0) {
+        return 1;
+    }
+    return count < MAX_NODES ? count : MAX_NODES;
+}
+
+int current_node(void) {
+    unsigned cpu, node;
+    if (syscall(SYS_getcpu, &cpu, &node, NULL) != 0 || node >= MAX_NODES) {
+        return 0;
+    }
+    return node;
+}
+
+/** Sets the NUMA policy of the pages entirely inside some memory */
+bool set_policy(void *start, size_t bytes, int mode, unsigned long mask,
+                unsigned flags) {
+    uintptr_t page_size = sysconf(_SC_PAGESIZE);
+    uintptr_t first = ((uintptr_t) start + page_size - 1) & ~(page_size - 1);
+    uintptr_t end = ((uintptr_t) start + bytes) & ~(page_size - 1);
+    if (first >= end) {
+        return true;
+    }
+    // The kernel ignores the last bit of the mask
+    return syscall(SYS_mbind, first, end - first, mode, &mask, MAX_NODES + 1, flags) ==
+           0;
+}
+
+bool bind_to_node(void *start, size_t bytes, int node) {
+    return set_policy(start, bytes, MPOL_PREFERRED, 1UL << node, MPOL_MF_MOVE);
+}
+
+bool interleave_nodes(void *start, size_t bytes, size_t nodes) {
+    unsigned long mask = nodes < MAX_NODES ? (1UL << nodes) - 1 : ~0UL;
+    return set_policy(start, bytes, MPOL_INTERLEAVE, mask, 0);
+}
+
+/** Adds a processor to a set of processors */
+void add_cpu(int cpu, void *arg) {
+    if (cpu >= 0 && cpu < CPU_SETSIZE) {
+        CPU_SET(cpu, (cpu_set_t *) arg);
+    }
+}
+
+bool pin_to_node(int node) {
+    char path[64];
+    snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    return read_list(path, add_cpu, &cpus) && CPU_COUNT(&cpus) > 0 &&
+           sched_setaffinity(0, sizeof(cpus), &cpus) == 0;
+}
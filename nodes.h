@@ -0,0 +1,48 @@
+#ifndef NODES_H
+#define NODES_H
+
+/*
+ * The NUMA nodes of the machine: which node a thread runs on, and placing memory
+ * and threads on nodes. Uses the kernel's system calls and /sys directly,
+ * so the VM doesn't depend on libnuma.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/** The most NUMA nodes supported, the number of bits in a node mask */
+#define MAX_NODES 64
+
+/**
+ * Gets the number of NUMA nodes, i.e. one more than the highest online node,
+ * or 1 if the machine has no NUMA nodes or they can't be read.
+ */
+size_t count_nodes(void);
+
+/** Gets the NUMA node the calling thread is running on, or 0 if it isn't known */
+int current_node(void);
+
+/**
+ * Makes memory prefer to be on a NUMA node, moving its pages that are already
+ * elsewhere. Only the pages entirely inside the memory are affected.
+ *
+ * @return whether the kernel accepted the policy
+ */
+bool bind_to_node(void *start, size_t bytes, int node);
+
+/**
+ * Spreads the pages of memory across NUMA nodes 0 to `nodes - 1` as they are
+ * first used, so no one node's memory bandwidth limits it.
+ *
+ * @return whether the kernel accepted the policy
+ */
+bool interleave_nodes(void *start, size_t bytes, size_t nodes);
+
+/**
+ * Makes the calling thread only run on the processors of a NUMA node.
+ *
+ * @return whether the thread was pinned
+ */
+bool pin_to_node(int node);
+
+#endif /* NODES_H */
@@ -0,0 +1,194 @@
+#include "profiler.h"
+
+#include <assert.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdlib.h>
+
+#include "bytecode.h"
+#include "jvm.h"
+
+allocation_profile_t allocation_profile = {0};
+
+/** The number of sites the hash table starts out with room for */
+#define INITIAL_SITES 64
+
+void start_allocation_profile(uint32_t interval) {
+    assert(interval > 0 && "Sampling interval must be positive");
+    allocation_profile.interval = interval;
+    allocation_profile.countdown = interval;
+    allocation_profile.count = 0;
+    allocation_profile.capacity = INITIAL_SITES;
+    allocation_profile.sites = calloc(INITIAL_SITES, sizeof(allocation_site_t));
+    assert(allocation_profile.sites != NULL && "Failed to allocate profile");
+}
+
+/** Finds a site's entry in a hash table, or the unused entry where it belongs */
+allocation_site_t *find_site(allocation_site_t *sites, size_t capacity,
+                             const method_t *method, u2 pc) {
+    size_t hash = ((uintptr_t) method >> 4) * 31 + pc;
+    for (size_t i = hash & (capacity - 1);; i = (i + 1) & (capacity - 1)) {
+        allocation_site_t *site = &sites[i];
+        if (site->method == NULL || (site->method == method && site->pc == pc)) {
+            return site;
+        }
+    }
+}
+
+/** Doubles the capacity of the hash table of sites */
+void grow_sites(void) {
+    size_t capacity = allocation_profile.capacity * 2;
+    allocation_site_t *sites = calloc(capacity, sizeof(allocation_site_t));
+    assert(sites != NULL && "Failed to allocate profile");
+    for (size_t i = 0; i < allocation_profile.capacity; i++) {
+        const allocation_site_t *site = &allocation_profile.sites[i];
+        if (site->method != NULL) {
+            *find_site(sites, capacity, site->method, site->pc) = *site;
+        }
+    }
+    free(allocation_profile.sites);
+    allocation_profile.sites = sites;
+    allocation_profile.capacity = capacity;
+}
+
+void profile_allocation(const method_t *method, u2 pc, size_t bytes) {
+    allocation_profile.countdown--;
+    if (allocation_profile.countdown > 0) {
+        return;
+    }
+    allocation_profile.countdown = allocation_profile.interval;
+
+    // Keep the table at most half full, so probes stay short
+    if (2 * (allocation_profile.count + 1) > allocation_profile.capacity) {
+        grow_sites();
+    }
+    allocation_site_t *site = find_site(allocation_profile.sites,
+                                        allocation_profile.capacity, method, pc);
+    if (site->method == NULL) {
+        *site = (allocation_site_t){.method = method, .pc = pc, .samples = 0, .bytes = 0};
+        allocation_profile.count++;
+    }
+    site->samples++;
+    site->bytes += bytes;
+}
+
+/** Orders sites by the number of bytes they allocated, most first */
+int compare_sites(const void *a, const void *b) {
+    const allocation_site_t *site_a = a;
+    const allocation_site_t *site_b = b;
+    return (site_a->bytes < site_b->bytes) - (site_a->bytes > site_b->bytes);
+}
+
+void print_allocation_profile(FILE *stream) {
+    if (allocation_profile.interval == 0) {
+        return;
+    }
+    // The unused entries have no bytes, so they sort to the end
+    qsort(allocation_profile.sites, allocation_profile.capacity,
+          sizeof(allocation_site_t), compare_sites);
+    uint64_t interval = allocation_profile.interval;
+    for (size_t i = 0; i < allocation_profile.count; i++) {
+        const allocation_site_t *site = &allocation_profile.sites[i];
+        fprintf(stream,
+                "alloc site=%s.%s%s pc=%" PRIu16 " samples=%" PRIu64 " arrays=%" PRIu64
+                " bytes=%" PRIu64 "\n",
+                site->method->class->name, site->method->name, site->method->descriptor,
+                site->pc, site->samples, site->samples * interval,
+                site->bytes * interval);
+    }
+    // The table is no longer hashed, so stop sampling into it
+    allocation_profile.interval = 0;
+}
+
+void free_allocation_profile(void) {
+    free(allocation_profile.sites);
+    allocation_profile = (allocation_profile_t){0};
+}
+
+/** The names of the allocation sites, indexed by site. Site 0 has no name. */
+typedef struct {
+    char **names;
+    size_t count;
+    /** Held while adding sites, since methods can be loaded on several threads */
+    pthread_mutex_t lock;
+} site_table_t;
+
+site_table_t site_table = {.names = NULL, .count = 1, .lock = PTHREAD_MUTEX_INITIALIZER};
+
+/**
+ * Adds an allocation site to `site_table`.
+ *
+ * @return the site, or 0 if there are already as many sites as can be numbered
+ */
+u2 add_allocation_site(const method_t *method, u2 pc) {
+    const char *format = "%s.%s%s:%" PRIu16;
+    int length = snprintf(NULL, 0, format, method->class->name, method->name,
+                          method->descriptor, pc);
+    char *name = malloc(length + 1);
+    assert(name != NULL && "Failed to allocate site name");
+    snprintf(name, length + 1, format, method->class->name, method->name,
+             method->descriptor, pc);
+
+    pthread_mutex_lock(&site_table.lock);
+    u2 site = 0;
+    if (site_table.count <= UINT16_MAX) {
+        site = site_table.count;
+        site_table.names = realloc(site_table.names, sizeof(char *[site + 1]));
+        assert(site_table.names != NULL && "Failed to allocate site names");
+        site_table.names[site] = name;
+        site_table.count++;
+    }
+    pthread_mutex_unlock(&site_table.lock);
+    if (site == 0) {
+        free(name);
+    }
+    return site;
+}
+
+void find_allocation_sites(method_t *method) {
+    code_t *code = &method->code;
+    for (size_t pc = 0; pc < code->code_length;) {
+        size_t length = instruction_length(code, pc);
+        if (length == 0) {
+            return;
+        }
+        switch (code->code[pc]) {
+            case i_new:
+            case i_newarray:
+            case i_newarray_local:
+            case i_anewarray:
+            case i_multianewarray:
+                if (code->allocation_sites == NULL) {
+                    code->allocation_sites = calloc(code->code_length, sizeof(u2));
+                    assert(code->allocation_sites != NULL &&
+                           "Failed to allocate allocation sites");
+                }
+                code->allocation_sites[pc] = add_allocation_site(method, pc);
+                break;
+            default:
+                break;
+        }
+        pc += length;
+    }
+}
+
+u2 allocation_site(const code_t *code, u2 pc) {
+    return code->allocation_sites == NULL ? 0 : code->allocation_sites[pc];
+}
+
+const char *allocation_site_name(void *context, uint16_t site) {
+    (void) context;
+    pthread_mutex_lock(&site_table.lock);
+    const char *name = site_table.names[site];
+    pthread_mutex_unlock(&site_table.lock);
+    return name;
+}
+
+void free_allocation_sites(void) {
+    for (size_t site = 1; site < site_table.count; site++) {
+        free(site_table.names[site]);
+    }
+    free(site_table.names);
+    site_table.names = NULL;
+    site_table.count = 1;
+}
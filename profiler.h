@@ -0,0 +1,98 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "class_file.h"
+
+/**
+ * The allocations sampled at one newarray instruction. Each sample stands for
+ * `interval` allocations, so multiplying by the interval estimates the totals.
+ */
+typedef struct {
+    /** The method containing the instruction, or NULL if the entry is unused */
+    const method_t *method;
+    /** The index of the instruction in the method's bytecode */
+    u2 pc;
+    /** The number of allocations sampled */
+    uint64_t samples;
+    /** The number of heap bytes the sampled allocations took up */
+    uint64_t bytes;
+} allocation_site_t;
+
+/**
+ * Samples which newarray instructions allocate the most.
+ * Only one in every `interval` allocations is recorded,
+ * so the profiler costs little more than a countdown per allocation.
+ */
+typedef struct {
+    /** How many allocations each sample stands for, or 0 if profiling is off */
+    uint32_t interval;
+    /** The number of allocations until the next sample */
+    uint32_t countdown;
+    /** A hash table of the sites that have been sampled, keyed by method and pc */
+    allocation_site_t *sites;
+    /** The number of used entries in `sites` */
+    size_t count;
+    /** The number of entries in `sites`, which is a power of 2 */
+    size_t capacity;
+} allocation_profile_t;
+
+extern allocation_profile_t allocation_profile;
+
+/**
+ * Starts profiling allocations.
+ *
+ * @param interval record one in every this many allocations
+ */
+void start_allocation_profile(uint32_t interval);
+
+/**
+ * Counts an allocation at a newarray instruction, sampling it if it is due.
+ * Should only be called if profiling is on (`allocation_profile.interval != 0`).
+ *
+ * @param method the method containing the instruction
+ * @param pc the index of the instruction in the method's bytecode
+ * @param bytes the number of heap bytes the array takes up
+ */
+void profile_allocation(const method_t *method, u2 pc, size_t bytes);
+
+/**
+ * Prints the estimated allocations of each sampled site, most bytes first,
+ * one line of space-separated key=value fields per site.
+ * Must be called before the methods are freed.
+ */
+void print_allocation_profile(FILE *stream);
+
+/** Frees the profile's sites */
+void free_allocation_profile(void);
+
+/**
+ * Gives each instruction of a method that allocates an object or array
+ * an allocation site, which is recorded in the blocks it allocates so heap
+ * dumps can tell where they came from. Site 0 stands for unknown sites,
+ * e.g. once there are too many to number.
+ * Can be called on several threads at once, e.g. when preloading classes.
+ *
+ * @param method the method, whose `allocation_sites` are set
+ */
+void find_allocation_sites(method_t *method);
+
+/**
+ * Gets the allocation site of an instruction that allocates.
+ * Instructions find_allocation_sites() didn't reach, e.g. past an instruction
+ * it couldn't decode, have the unknown site 0.
+ */
+u2 allocation_site(const code_t *code, u2 pc);
+
+/**
+ * Names an allocation site, e.g. "Foo.bar()V:12" for the instruction at pc 12
+ * of Foo.bar(). Called by heap dumps (see heap_set_site_names()).
+ */
+const char *allocation_site_name(void *context, uint16_t site);
+
+/** Frees the names of the allocation sites */
+void free_allocation_sites(void);
+
+#endif /* PROFILER_H */
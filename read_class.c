@@ -7,22 +7,52 @@
 #include <string.h>
 
 const u4 CLASS_MAGIC = 0xCAFEBABE;
-const u2 IS_STATIC = 0x0008;
+/** The attribute of a static field that gives the field's initial value */
+const char CONSTANT_VALUE_ATTRIBUTE[] = "ConstantValue";
+
+/** A class file being parsed from memory */
+typedef struct {
+    /** The contents of the class file */
+    const u1 *bytes;
+    /** The number of bytes in the class file */
+    size_t length;
+    /** The index of the next byte to read */
+    size_t position;
+    /** Whether the class file is malformed, e.g. it ended prematurely */
+    bool failed;
+    /** The number of constants in the constant pool, once it has been read */
+    u2 constant_pool_count;
+} class_reader_t;
 
 /*
  * Functions for reading unsigned big-endian integers. We can't read directly
  * into a u2 or u4 variable because x86 stores integers in little-endian.
+ * Reading past the end of the file marks it malformed, and once a class file
+ * is malformed, every read gives 0, so the rest of the parsing reads nothing.
  */
-u1 read_u1(FILE *class_file) {
-    int result = fgetc(class_file);
-    assert(result != EOF && "Reached end of file prematurely");
-    return result;
+u1 read_u1(class_reader_t *reader) {
+    if (reader->failed || reader->position >= reader->length) {
+        reader->failed = true;
+        return 0;
+    }
+    return reader->bytes[reader->position++];
+}
+u2 read_u2(class_reader_t *reader) {
+    return (u2) read_u1(reader) << 8 | read_u1(reader);
 }
-u2 read_u2(FILE *class_file) {
-    return (u2) read_u1(class_file) << 8 | read_u1(class_file);
+u4 read_u4(class_reader_t *reader) {
+    return (u4) read_u2(reader) << 16 | read_u2(reader);
 }
-u4 read_u4(FILE *class_file) {
-    return (u4) read_u2(class_file) << 16 | read_u2(class_file);
+
+/** Copies the next `length` bytes of the class file, or zeros if there are too few */
+void read_bytes(class_reader_t *reader, void *destination, size_t length) {
+    if (reader->failed || length > reader->length - reader->position) {
+        reader->failed = true;
+        memset(destination, 0, length);
+        return;
+    }
+    memcpy(destination, &reader->bytes[reader->position], length);
+    reader->position += length;
 }
 
 u2 constant_pool_size(cp_info *constant_pool) {
@@ -40,34 +70,67 @@ cp_info *get_constant(cp_info *constant_pool, u2 index) {
     return &constant_pool[index - 1];
 }
 
-CONSTANT_NameAndType_info *get_method_name_and_type(cp_info *constant_pool, u2 index) {
-    cp_info *method_constant = get_constant(constant_pool, index);
-    assert(method_constant->tag == CONSTANT_Methodref && "Expected a MethodRef");
-    CONSTANT_FieldOrMethodref_info *method_ref = method_constant->info;
+CONSTANT_NameAndType_info *get_member_name_and_type(cp_info *constant_pool, u2 index) {
+    cp_info *member_constant = get_constant(constant_pool, index);
+    assert((member_constant->tag == CONSTANT_Methodref ||
+            member_constant->tag == CONSTANT_InterfaceMethodref ||
+            member_constant->tag == CONSTANT_Fieldref) &&
+           "Expected a FieldRef or MethodRef");
+    CONSTANT_FieldOrMethodref_info *member_ref = member_constant->info;
     cp_info *name_and_type_constant =
-        get_constant(constant_pool, method_ref->name_and_type_index);
+        get_constant(constant_pool, member_ref->name_and_type_index);
     assert(name_and_type_constant->tag == CONSTANT_NameAndType &&
            "Expected a NameAndType");
     return name_and_type_constant->info;
 }
 
-u2 get_number_of_parameters(const method_t *method) {
+const char *get_string_constant(cp_info *constant_pool, u2 index) {
+    cp_info *string_constant = get_constant(constant_pool, index);
+    assert(string_constant->tag == CONSTANT_String && "Expected a String");
+    CONSTANT_String_info *string_info = string_constant->info;
+    cp_info *utf8 = get_constant(constant_pool, string_info->string_index);
+    assert(utf8->tag == CONSTANT_Utf8 && "Expected a UTF8");
+    return utf8->info;
+}
+
+char *get_class_name(cp_info *constant_pool, u2 index) {
+    cp_info *class_constant = get_constant(constant_pool, index);
+    assert(class_constant->tag == CONSTANT_Class && "Expected a Class");
+    CONSTANT_Class_info *class_info = class_constant->info;
+    cp_info *name = get_constant(constant_pool, class_info->string_index);
+    assert(name->tag == CONSTANT_Utf8 && "Expected a UTF8");
+    return name->info;
+}
+
+u2 count_parameters(const char *descriptor) {
     // Type descriptors will always have the length ( + #params + ) + return type
-    char *end = strchr(method->descriptor, ')');
-    char *start = strchr(method->descriptor, '(');
+    const char *end = strchr(descriptor, ')');
+    const char *start = strchr(descriptor, '(');
 
     u2 params = 0;
 
     for (start++; start < end; start++) {
-        if (start[0] == '[') {
+        // Array types are prefixed with one '[' per dimension
+        while (start[0] == '[') {
             start++;
         }
+        // Reference types are written as L<class name>;
+        if (start[0] == 'L') {
+            start = strchr(start, ';');
+            if (start == NULL) {
+                break;
+            }
+        }
         params++;
     }
 
     return params;
 }
 
+u2 get_number_of_parameters(const method_t *method) {
+    return count_parameters(method->descriptor);
+}
+
 method_t *find_method(const char *name, const char *descriptor,
                       const class_file_t *class) {
     for (method_t *method = class->methods; method->name != NULL; method++) {
@@ -79,9 +142,51 @@ method_t *find_method(const char *name, const char *descriptor,
     return NULL;
 }
 
+field_t *find_field(const char *name, const char *descriptor, const class_file_t *class) {
+    for (field_t *field = class->fields; field->name != NULL; field++) {
+        if (strcmp(field->name, name) == 0 &&
+            strcmp(field->descriptor, descriptor) == 0) {
+            return field;
+        }
+    }
+    return NULL;
+}
+
+/** Looks up the names of a Fieldref, Methodref, or InterfaceMethodref */
+member_ref_t get_member_ref(u2 index, const class_file_t *class) {
+    cp_info *member_constant = get_constant(class->constant_pool, index);
+    CONSTANT_FieldOrMethodref_info *member_ref = member_constant->info;
+
+    CONSTANT_NameAndType_info *name_and_type =
+        get_member_name_and_type(class->constant_pool, index);
+    cp_info *name = get_constant(class->constant_pool, name_and_type->name_index);
+    assert(name->tag == CONSTANT_Utf8 && "Expected a UTF8");
+    cp_info *descriptor =
+        get_constant(class->constant_pool, name_and_type->descriptor_index);
+    assert(descriptor->tag == CONSTANT_Utf8 && "Expected a UTF8");
+
+    member_ref_t result = {
+        .class_name = get_class_name(class->constant_pool, member_ref->class_index),
+        .name = name->info, .descriptor = descriptor->info};
+    return result;
+}
+
+member_ref_t get_method_ref(u2 index, const class_file_t *class) {
+    cp_tag_t tag = get_constant(class->constant_pool, index)->tag;
+    assert((tag == CONSTANT_Methodref || tag == CONSTANT_InterfaceMethodref) &&
+           "Expected a MethodRef");
+    return get_member_ref(index, class);
+}
+
+member_ref_t get_field_ref(u2 index, const class_file_t *class) {
+    assert(get_constant(class->constant_pool, index)->tag == CONSTANT_Fieldref &&
+           "Expected a FieldRef");
+    return get_member_ref(index, class);
+}
+
 method_t *find_method_from_index(u2 index, const class_file_t *class) {
     CONSTANT_NameAndType_info *name_and_type =
-        get_method_name_and_type(class->constant_pool, index);
+        get_member_name_and_type(class->constant_pool, index);
     cp_info *name = get_constant(class->constant_pool, name_and_type->name_index);
     assert(name->tag == CONSTANT_Utf8 && "Expected a UTF8");
     cp_info *descriptor =
@@ -90,31 +195,190 @@ method_t *find_method_from_index(u2 index, const class_file_t *class) {
     return find_method(name->info, descriptor->info, class);
 }
 
-class_header_t get_class_header(FILE *class_file) {
+/** Moves past an attribute, marking the class file malformed if it ends first */
+void skip_to(class_reader_t *reader, size_t attribute_end) {
+    if (attribute_end > reader->length) {
+        reader->failed = true;
+        return;
+    }
+    reader->position = attribute_end;
+}
+
+/**
+ * Moves past a field type in a descriptor, e.g. "I", "[[I" or "Ljava/lang/String;".
+ *
+ * @return the character after the type, or NULL if there is no valid type
+ */
+const char *skip_field_type(const char *type) {
+    while (type[0] == '[') {
+        type++;
+    }
+    switch (type[0]) {
+        case 'B':
+        case 'C':
+        case 'D':
+        case 'F':
+        case 'I':
+        case 'J':
+        case 'S':
+        case 'Z':
+            return type + 1;
+        case 'L': {
+            // The class name can't be empty
+            const char *end = strchr(type, ';');
+            return end == NULL || end == type + 1 ? NULL : end + 1;
+        }
+        default:
+            return NULL;
+    }
+}
+
+/**
+ * Checks whether a method descriptor is "(" followed by the parameter types,
+ * then ")" and the return type, so count_parameters() can read it
+ */
+bool is_method_descriptor(const char *descriptor) {
+    if (descriptor[0] != '(') {
+        return false;
+    }
+    const char *type = descriptor + 1;
+    while (type != NULL && type[0] != ')') {
+        type = skip_field_type(type);
+    }
+    if (type == NULL) {
+        return false;
+    }
+    // Then the return type, which ends the descriptor
+    type++;
+    type = type[0] == 'V' ? type + 1 : skip_field_type(type);
+    return type != NULL && type[0] == '\0';
+}
+
+/** Checks whether a constant pool index refers to a constant of the given kind */
+bool is_constant(const class_reader_t *reader, cp_info *constant_pool, u2 index,
+                 cp_tag_t tag) {
+    return 0 < index && index <= reader->constant_pool_count &&
+           constant_pool[index - 1].tag == tag;
+}
+
+/**
+ * Looks up a UTF8 constant, marking the class file malformed if the index
+ * doesn't refer to one.
+ *
+ * @return the constant's characters, or NULL if the class file is malformed
+ */
+char *parse_utf8(class_reader_t *reader, cp_info *constant_pool, u2 index) {
+    if (!is_constant(reader, constant_pool, index, CONSTANT_Utf8)) {
+        reader->failed = true;
+        return NULL;
+    }
+    return constant_pool[index - 1].info;
+}
+
+/**
+ * Looks up the name of a CONSTANT_Class like get_class_name(),
+ * marking the class file malformed if the index doesn't refer to one.
+ *
+ * @return the internal name of the class, or NULL if the class file is malformed
+ */
+char *parse_class_name(class_reader_t *reader, cp_info *constant_pool, u2 index) {
+    if (!is_constant(reader, constant_pool, index, CONSTANT_Class)) {
+        reader->failed = true;
+        return NULL;
+    }
+    return get_class_name(constant_pool, index);
+}
+
+/**
+ * Checks that the constants refer to constants of the right kinds,
+ * so looking them up while the program runs can't fail.
+ */
+void check_constant_references(class_reader_t *reader, cp_info *constant_pool) {
+    for (u2 i = 0; i < reader->constant_pool_count; i++) {
+        cp_info *constant = &constant_pool[i];
+        bool valid = true;
+        switch (constant->tag) {
+            case CONSTANT_Class: {
+                CONSTANT_Class_info *value = constant->info;
+                valid = is_constant(reader, constant_pool, value->string_index,
+                                    CONSTANT_Utf8);
+                break;
+            }
+
+            case CONSTANT_String: {
+                CONSTANT_String_info *value = constant->info;
+                valid = is_constant(reader, constant_pool, value->string_index,
+                                    CONSTANT_Utf8);
+                break;
+            }
+
+            case CONSTANT_Methodref:
+            case CONSTANT_InterfaceMethodref:
+            case CONSTANT_Fieldref: {
+                CONSTANT_FieldOrMethodref_info *value = constant->info;
+                valid = is_constant(reader, constant_pool, value->class_index,
+                                    CONSTANT_Class) &&
+                        is_constant(reader, constant_pool, value->name_and_type_index,
+                                    CONSTANT_NameAndType);
+                // Calls count the parameters in the descriptor of the method they call
+                if (valid && constant->tag != CONSTANT_Fieldref) {
+                    CONSTANT_NameAndType_info *name_and_type =
+                        constant_pool[value->name_and_type_index - 1].info;
+                    u2 descriptor = name_and_type->descriptor_index;
+                    valid = is_constant(reader, constant_pool, descriptor,
+                                        CONSTANT_Utf8) &&
+                            is_method_descriptor(constant_pool[descriptor - 1].info);
+                }
+                break;
+            }
+
+            case CONSTANT_NameAndType: {
+                CONSTANT_NameAndType_info *value = constant->info;
+                valid = is_constant(reader, constant_pool, value->name_index,
+                                    CONSTANT_Utf8) &&
+                        is_constant(reader, constant_pool, value->descriptor_index,
+                                    CONSTANT_Utf8);
+                break;
+            }
+
+            default:
+                break;
+        }
+        if (!valid) {
+            reader->failed = true;
+            return;
+        }
+    }
+}
+
+class_header_t get_class_header(class_reader_t *reader) {
     class_header_t header;
-    header.magic = read_u4(class_file);
-    assert(header.magic == CLASS_MAGIC);
-    header.major_version = read_u2(class_file);
-    header.minor_version = read_u2(class_file);
+    header.magic = read_u4(reader);
+    if (header.magic != CLASS_MAGIC) {
+        reader->failed = true;
+    }
+    header.major_version = read_u2(reader);
+    header.minor_version = read_u2(reader);
     return header;
 }
 
-cp_info *get_constant_pool(FILE *class_file) {
+cp_info *get_constant_pool(class_reader_t *reader) {
     // Constant pool count includes unused constant at index 0
-    u2 constant_pool_count = read_u2(class_file) - 1;
+    u2 constant_pool_count = read_u2(reader);
+    constant_pool_count = constant_pool_count > 0 ? constant_pool_count - 1 : 0;
     cp_info *constant_pool = malloc(sizeof(cp_info[constant_pool_count + 1]));
     assert(constant_pool != NULL && "Failed to allocate constant pool");
 
     cp_info *constant = constant_pool;
-    while (constant_pool_count > 0) {
-        constant->tag = read_u1(class_file);
+    while (constant_pool_count > 0 && !reader->failed) {
+        constant->tag = read_u1(reader);
+        constant->resolved = NULL;
         switch (constant->tag) {
             case CONSTANT_Utf8: {
-                u2 length = read_u2(class_file);
+                u2 length = read_u2(reader);
                 char *info = malloc(length + 1);
                 assert(info != NULL && "Failed to allocate UTF8 constant");
-                size_t bytes_read = fread(info, 1, length, class_file);
-                assert(bytes_read == length && "Failed to read UTF8 constant");
+                read_bytes(reader, info, length);
                 info[length] = '\0';
                 constant->info = info;
                 break;
@@ -123,7 +387,7 @@ cp_info *get_constant_pool(FILE *class_file) {
             case CONSTANT_Integer: {
                 CONSTANT_Integer_info *value = malloc(sizeof(*value));
                 assert(value != NULL && "Failed to allocate integer constant");
-                value->bytes = read_u4(class_file);
+                value->bytes = read_u4(reader);
                 constant->info = value;
                 break;
             }
@@ -131,17 +395,26 @@ cp_info *get_constant_pool(FILE *class_file) {
             case CONSTANT_Class: {
                 CONSTANT_Class_info *value = malloc(sizeof(*value));
                 assert(value != NULL && "Failed to allocate class constant");
-                value->string_index = read_u2(class_file);
+                value->string_index = read_u2(reader);
+                constant->info = value;
+                break;
+            }
+
+            case CONSTANT_String: {
+                CONSTANT_String_info *value = malloc(sizeof(*value));
+                assert(value != NULL && "Failed to allocate string constant");
+                value->string_index = read_u2(reader);
                 constant->info = value;
                 break;
             }
 
             case CONSTANT_Methodref:
+            case CONSTANT_InterfaceMethodref:
             case CONSTANT_Fieldref: {
                 CONSTANT_FieldOrMethodref_info *value = malloc(sizeof(*value));
                 assert(value != NULL && "Failed to allocate FieldRef/MethodRef constant");
-                value->class_index = read_u2(class_file);
-                value->name_and_type_index = read_u2(class_file);
+                value->class_index = read_u2(reader);
+                value->name_and_type_index = read_u2(reader);
                 constant->info = value;
                 break;
             }
@@ -149,15 +422,16 @@ cp_info *get_constant_pool(FILE *class_file) {
             case CONSTANT_NameAndType: {
                 CONSTANT_NameAndType_info *value = malloc(sizeof(*value));
                 assert(value != NULL && "Failed to allocate NameAndType constant");
-                value->name_index = read_u2(class_file);
-                value->descriptor_index = read_u2(class_file);
+                value->name_index = read_u2(reader);
+                value->descriptor_index = read_u2(reader);
                 constant->info = value;
                 break;
             }
 
             default:
-                fprintf(stderr, "Unknown constant type %d\n", constant->tag);
-                assert(false);
+                // Not a kind of constant this VM supports
+                reader->failed = true;
+                continue;
         }
         constant++;
         constant_pool_count--;
@@ -165,77 +439,176 @@ cp_info *get_constant_pool(FILE *class_file) {
 
     // Mark end of array with NULL info
     constant->info = NULL;
+    reader->constant_pool_count = constant - constant_pool;
+    if (!reader->failed) {
+        check_constant_references(reader, constant_pool);
+    }
     return constant_pool;
 }
 
-class_info_t get_class_info(FILE *class_file) {
+class_info_t get_class_info(class_reader_t *reader) {
     class_info_t info;
-    info.access_flags = read_u2(class_file);
-    info.this_class = read_u2(class_file);
-    info.super_class = read_u2(class_file);
-    u2 interfaces_count = read_u2(class_file);
-    assert(interfaces_count == 0 && "This VM does not support interfaces.");
-    u2 fields_count = read_u2(class_file);
-    assert(fields_count == 0 && "This VM does not support fields.");
+    info.access_flags = read_u2(reader);
+    info.this_class = read_u2(reader);
+    info.super_class = read_u2(reader);
     return info;
 }
 
-void read_method_attributes(FILE *class_file, method_info *info, code_t *code,
+/** Reads the names of the interfaces the class implements or the interface extends */
+void get_interfaces(class_reader_t *reader, class_file_t *class) {
+    class->interfaces_count = read_u2(reader);
+    class->interfaces = malloc(sizeof(char *[class->interfaces_count + 1]));
+    assert(class->interfaces != NULL && "Failed to allocate interfaces");
+    for (u2 i = 0; i < class->interfaces_count; i++) {
+        class->interfaces[i] =
+            parse_class_name(reader, class->constant_pool, read_u2(reader));
+    }
+}
+
+/**
+ * Reads the class's fields, giving each static field a slot in the class's
+ * static storage, which holds the field's ConstantValue or else starts as 0.
+ */
+void get_fields(class_reader_t *reader, class_file_t *class) {
+    u2 fields_count = read_u2(reader);
+    class->fields = malloc(sizeof(field_t[fields_count + 1]));
+    assert(class->fields != NULL && "Failed to allocate fields");
+    // There can be at most one static per field
+    class->statics = calloc(fields_count > 0 ? fields_count : 1, sizeof(int32_t));
+    assert(class->statics != NULL && "Failed to allocate static fields");
+
+    u2 statics_count = 0;
+    u2 i = 0;
+    for (; i < fields_count && !reader->failed; i++) {
+        field_t *field = &class->fields[i];
+        field->access_flags = read_u2(reader);
+        field->name = parse_utf8(reader, class->constant_pool, read_u2(reader));
+        field->descriptor = parse_utf8(reader, class->constant_pool, read_u2(reader));
+        // This VM does not support long or double fields
+        if (field->descriptor != NULL &&
+            (field->descriptor[0] == 'J' || field->descriptor[0] == 'D')) {
+            reader->failed = true;
+        }
+        field->class = class;
+        field->slot = 0;
+        bool is_static = (field->access_flags & IS_STATIC) != 0;
+        if (is_static) {
+            field->slot = statics_count;
+            statics_count++;
+        }
+
+        for (u2 attributes = read_u2(reader); attributes > 0 && !reader->failed;
+             attributes--) {
+            char *type = parse_utf8(reader, class->constant_pool, read_u2(reader));
+            u4 attribute_length = read_u4(reader);
+            size_t attribute_end = reader->position + attribute_length;
+            if (is_static && type != NULL &&
+                strcmp(type, CONSTANT_VALUE_ATTRIBUTE) == 0) {
+                u2 value_index = read_u2(reader);
+                if (value_index == 0 || value_index > reader->constant_pool_count) {
+                    reader->failed = true;
+                }
+                else if (is_constant(reader, class->constant_pool, value_index,
+                                     CONSTANT_Integer)) {
+                    CONSTANT_Integer_info *integer =
+                        class->constant_pool[value_index - 1].info;
+                    class->statics[field->slot] = integer->bytes;
+                }
+            }
+            // Skip the rest of the attribute
+            skip_to(reader, attribute_end);
+        }
+    }
+
+    // Mark end of array with NULL name
+    class->fields[i].name = NULL;
+    class->statics_count = statics_count;
+}
+
+void read_method_attributes(class_reader_t *reader, method_info *info, code_t *code,
                             cp_info *constant_pool) {
+    code->max_stack = 0;
+    code->max_locals = 0;
+    code->code_length = 0;
+    code->code = NULL;
+    code->code_offset = 0;
+    code->exception_table = NULL;
+    code->exception_table_length = 0;
+    code->copy_loops = NULL;
+    code->copy_loops_count = 0;
+    code->local_arrays = NULL;
+    code->local_arrays_count = 0;
+    code->local_arrays_memory = 0;
+    code->allocation_sites = NULL;
+    code->inline_caches = NULL;
+    code->inline_caches_count = 0;
     bool found_code = false;
-    for (u2 attributes = info->attributes_count; attributes > 0; attributes--) {
+    for (u2 attributes = info->attributes_count; attributes > 0 && !reader->failed;
+         attributes--) {
         attribute_info ainfo;
-        ainfo.attribute_name_index = read_u2(class_file);
-        ainfo.attribute_length = read_u4(class_file);
-        long attribute_end = ftell(class_file) + ainfo.attribute_length;
-        cp_info *type_constant = get_constant(constant_pool, ainfo.attribute_name_index);
-        assert(type_constant->tag == CONSTANT_Utf8 && "Expected a UTF8");
-        if (strcmp(type_constant->info, "Code") == 0) {
-            assert(!found_code && "Duplicate method code");
+        ainfo.attribute_name_index = read_u2(reader);
+        ainfo.attribute_length = read_u4(reader);
+        size_t attribute_end = reader->position + ainfo.attribute_length;
+        char *type = parse_utf8(reader, constant_pool, ainfo.attribute_name_index);
+        if (type != NULL && strcmp(type, "Code") == 0) {
+            // A method has at most one Code attribute
+            reader->failed |= found_code;
             found_code = true;
 
-            code->max_stack = read_u2(class_file);
-            code->max_locals = read_u2(class_file);
-            code->code_length = read_u4(class_file);
-            code->code = malloc(code->code_length);
-            assert(code->code != NULL && "Failed to allocate method code");
-            size_t bytes_read = fread(code->code, 1, code->code_length, class_file);
-            assert(bytes_read == code->code_length && "Failed to read method code");
+            code->max_stack = read_u2(reader);
+            code->max_locals = read_u2(reader);
+            code->code_length = read_u4(reader);
+            // The bytecode is only copied out if the method is invoked
+            code->code_offset = reader->position;
+            if (code->code_length > reader->length - reader->position) {
+                reader->failed = true;
+                break;
+            }
+            reader->position += code->code_length;
+            // But the exception table is checked now, so decoding it can't fail
+            for (u2 handlers = read_u2(reader); handlers > 0; handlers--) {
+                u2 start_pc = read_u2(reader);
+                u2 end_pc = read_u2(reader);
+                u2 handler_pc = read_u2(reader);
+                read_u2(reader); // catch_type
+                if (!(start_pc < end_pc && end_pc <= code->code_length &&
+                      handler_pc < code->code_length)) {
+                    reader->failed = true;
+                }
+            }
         }
         // Skip the rest of the attribute
-        fseek(class_file, attribute_end, SEEK_SET);
+        skip_to(reader, attribute_end);
+    }
+    // Only abstract and native methods have no code
+    if (!found_code && (info->access_flags & (IS_ABSTRACT | IS_NATIVE)) == 0) {
+        reader->failed = true;
     }
-    assert(found_code && "Missing method code");
 }
 
-method_t *get_methods(FILE *class_file, cp_info *constant_pool) {
-    u2 method_count = read_u2(class_file);
+method_t *get_methods(class_reader_t *reader, cp_info *constant_pool) {
+    u2 method_count = read_u2(reader);
     method_t *methods = malloc(sizeof(method_t[method_count + 1]));
     assert(methods != NULL && "Failed to allocate methods");
 
     method_t *method = methods;
-    while (method_count > 0) {
+    while (method_count > 0 && !reader->failed) {
         method_info info;
-        info.access_flags = read_u2(class_file);
-        info.name_index = read_u2(class_file);
-        info.descriptor_index = read_u2(class_file);
-        info.attributes_count = read_u2(class_file);
-
-        cp_info *name = get_constant(constant_pool, info.name_index);
-        assert(name->tag == CONSTANT_Utf8 && "Expected a UTF8");
-        method->name = name->info;
-        cp_info *descriptor = get_constant(constant_pool, info.descriptor_index);
-        assert(descriptor->tag == CONSTANT_Utf8 && "Expected a UTF8");
-        method->descriptor = descriptor->info;
-
-        /* Our JVM can only execute static methods, so ensure all methods are static.
-         * However, javac creates a constructor method <init> we need to ignore. */
-        if (strcmp(method->name, "<init>") != 0) {
-            assert((info.access_flags & IS_STATIC) != 0 &&
-                   "This VM only supports static methods.");
+        info.access_flags = read_u2(reader);
+        info.name_index = read_u2(reader);
+        info.descriptor_index = read_u2(reader);
+        info.attributes_count = read_u2(reader);
+
+        method->name = parse_utf8(reader, constant_pool, info.name_index);
+        method->descriptor = parse_utf8(reader, constant_pool, info.descriptor_index);
+        // count_parameters() needs every parameter type to be complete
+        if (method->descriptor != NULL && !is_method_descriptor(method->descriptor)) {
+            reader->failed = true;
         }
+        method->access_flags = info.access_flags;
+        method->vtable_index = 0;
 
-        read_method_attributes(class_file, &info, &method->code, constant_pool);
+        read_method_attributes(reader, &info, &method->code, constant_pool);
 
         method++;
         method_count--;
@@ -246,27 +619,142 @@ method_t *get_methods(FILE *class_file, cp_info *constant_pool) {
     return methods;
 }
 
-class_file_t *get_class(FILE *class_file) {
+/**
+ * Parses a class file in memory.
+ * The class keeps `bytes` to decode method bodies from, and frees them
+ * along with the class if `owns_bytes` is set.
+ *
+ * @return the parsed class, or NULL if the class file is malformed,
+ *         in which case `bytes` are freed if `owns_bytes` is set
+ */
+class_file_t *parse_class(const u1 *bytes, size_t length, bool owns_bytes) {
+    class_reader_t reader = {
+        .bytes = bytes,
+        .length = length,
+        .position = 0,
+        .failed = false,
+        .constant_pool_count = 0,
+    };
     class_file_t *class = malloc(sizeof(*class));
     assert(class != NULL && "Failed to allocate class");
+    class->bytes = bytes;
+    class->length = length;
+    class->owns_bytes = owns_bytes;
 
     /* Read the leading header of the class file.
      * We don't need the result, but we need to skip past the header. */
-    get_class_header(class_file);
+    get_class_header(&reader);
 
     // Read the constant pool
-    class->constant_pool = get_constant_pool(class_file);
-
-    /* Read information about the class that was compiled.
-     * We don't need the result, but we need to skip past it. */
-    get_class_info(class_file);
+    class->constant_pool = get_constant_pool(&reader);
+
+    // Read information about the class that was compiled
+    class_info_t info = get_class_info(&reader);
+    class->name = parse_class_name(&reader, class->constant_pool, info.this_class);
+    class->super_name =
+        info.super_class == 0
+            ? NULL
+            : parse_class_name(&reader, class->constant_pool, info.super_class);
+    class->access_flags = info.access_flags;
+    get_interfaces(&reader, class);
+
+    // Read the fields and set up the storage for the static ones
+    get_fields(&reader, class);
+    class->initialized = false;
+    class->id = 0;
+    class->instance_size = 0;
+    class->reference_slots = NULL;
+    class->reference_slots_count = 0;
+    class->vtable = NULL;
+    class->vtable_size = 0;
+    class->itables = NULL;
+    class->itables_count = 0;
+    class->linked = false;
 
     // Read the list of static methods
-    class->methods = get_methods(class_file, class->constant_pool);
+    class->methods = get_methods(&reader, class->constant_pool);
+    for (method_t *method = class->methods; method->name != NULL; method++) {
+        method->class = class;
+    }
 
+    if (reader.failed) {
+        free_class(class);
+        return NULL;
+    }
     return class;
 }
 
+class_file_t *get_class_from_bytes(const u1 *bytes, size_t length) {
+    u1 *copy = malloc(length > 0 ? length : 1);
+    assert(copy != NULL && "Failed to allocate class file");
+    memcpy(copy, bytes, length);
+    return parse_class(copy, length, true);
+}
+
+class_file_t *get_class_in_place(const u1 *bytes, size_t length) {
+    return parse_class(bytes, length, false);
+}
+
+/** Reads the whole of an open file into memory */
+u1 *read_class_bytes(FILE *class_file, size_t *class_length) {
+    size_t length = 0;
+    size_t capacity = 4096;
+    u1 *bytes = malloc(capacity);
+    assert(bytes != NULL && "Failed to allocate class file");
+    while (true) {
+        length += fread(&bytes[length], 1, capacity - length, class_file);
+        if (length < capacity) {
+            break;
+        }
+        capacity *= 2;
+        bytes = realloc(bytes, capacity);
+        assert(bytes != NULL && "Failed to allocate class file");
+    }
+    assert(!ferror(class_file) && "Failed to read class file");
+    *class_length = length;
+    return bytes;
+}
+
+class_file_t *get_class(FILE *class_file) {
+    // Read the whole file into memory and parse it from there
+    size_t length;
+    u1 *bytes = read_class_bytes(class_file, &length);
+    return parse_class(bytes, length, true);
+}
+
+bool read_method_code(method_t *method) {
+    code_t *code = &method->code;
+    if (code->code != NULL) {
+        return false;
+    }
+    class_reader_t reader = {
+        .bytes = method->class->bytes,
+        .length = method->class->length,
+        .position = code->code_offset,
+    };
+    code->code = malloc(code->code_length > 0 ? code->code_length : 1);
+    assert(code->code != NULL && "Failed to allocate method code");
+    read_bytes(&reader, code->code, code->code_length);
+
+    // The exception table follows the bytecode
+    code->exception_table_length = read_u2(&reader);
+    code->exception_table =
+        malloc(sizeof(exception_handler_t[code->exception_table_length + 1]));
+    assert(code->exception_table != NULL && "Failed to allocate exception table");
+    for (u2 i = 0; i < code->exception_table_length; i++) {
+        exception_handler_t *handler = &code->exception_table[i];
+        handler->start_pc = read_u2(&reader);
+        handler->end_pc = read_u2(&reader);
+        handler->handler_pc = read_u2(&reader);
+        handler->catch_type = read_u2(&reader);
+        assert(handler->start_pc < handler->end_pc &&
+               handler->end_pc <= code->code_length &&
+               handler->handler_pc < code->code_length && "Invalid exception handler");
+    }
+    assert(!reader.failed && "Reached end of file prematurely");
+    return true;
+}
+
 void free_class(class_file_t *class) {
     for (cp_info *constant = class->constant_pool; constant->info != NULL; constant++) {
         free(constant->info);
@@ -275,7 +763,24 @@ void free_class(class_file_t *class) {
 
     for (method_t *method = class->methods; method->name != NULL; method++) {
         free(method->code.code);
+        free(method->code.exception_table);
+        free(method->code.copy_loops);
+        free(method->code.local_arrays);
+        free(method->code.allocation_sites);
+        free(method->code.inline_caches);
     }
     free(class->methods);
+    free(class->fields);
+    free(class->statics);
+    free(class->reference_slots);
+    free(class->vtable);
+    for (u2 i = 0; i < class->itables_count; i++) {
+        free(class->itables[i].methods);
+    }
+    free(class->itables);
+    free(class->interfaces);
+    if (class->owns_bytes) {
+        free((u1 *) class->bytes);
+    }
     free(class);
 }
@@ -1,6 +1,7 @@
 #ifndef READ_CLASS_H
 #define READ_CLASS_H
 
+#include <stdbool.h>
 #include <stdio.h>
 #include "class_file.h"
 
@@ -18,6 +19,62 @@
 method_t *find_method(const char *name, const char *descriptor,
                       const class_file_t *class);
 
+/**
+ * Looks up the name of a CONSTANT_Class.
+ *
+ * @param constant_pool the class's constant pool
+ * @param index the constant pool index of the CONSTANT_Class
+ * @return the internal name of the class, e.g. "java/lang/Object"
+ */
+char *get_class_name(cp_info *constant_pool, uint16_t index);
+
+/**
+ * Looks up the characters of a CONSTANT_String.
+ *
+ * @param constant_pool the class's constant pool
+ * @param index the constant pool index of the CONSTANT_String
+ * @return the string's modified UTF-8 characters, which are owned by the constant pool
+ */
+const char *get_string_constant(cp_info *constant_pool, uint16_t index);
+
+/** The names a Fieldref or Methodref constant uses to identify a field or method */
+typedef struct {
+    /** The internal name of the member's class, e.g. "java/lang/System" */
+    char *class_name;
+    /** The member name, e.g. "arraycopy" */
+    char *name;
+    /** The member descriptor, e.g. "(I)I" or "[I" */
+    char *descriptor;
+} member_ref_t;
+
+/**
+ * Looks up the class, name, and descriptor of a Methodref or InterfaceMethodref.
+ *
+ * @param index the constant pool index of the Methodref or InterfaceMethodref
+ * @param class the parsed class file
+ * @return the names, which point into the class's constant pool
+ */
+member_ref_t get_method_ref(uint16_t index, const class_file_t *class);
+
+/**
+ * Looks up the class, name, and descriptor of a Fieldref.
+ *
+ * @param index the constant pool index of the Fieldref
+ * @param class the parsed class file
+ * @return the names, which point into the class's constant pool
+ */
+member_ref_t get_field_ref(uint16_t index, const class_file_t *class);
+
+/**
+ * Finds the field a class declares with the given name and type.
+ *
+ * @param name the field name, e.g. "count"
+ * @param descriptor the field descriptor, e.g. "I"
+ * @param class the parsed class file
+ * @return the field if it was found, NULL otherwise
+ */
+field_t *find_field(const char *name, const char *descriptor, const class_file_t *class);
+
 /**
  * Finds the method corresponding to the given constant pool index.
  *
@@ -33,15 +90,52 @@ method_t *find_method_from_index(uint16_t index, const class_file_t *class);
  */
 uint16_t get_number_of_parameters(const method_t *method);
 
+/**
+ * Gets the number of (integer) parameters in a method descriptor, e.g. 2 for "(I[I)V".
+ */
+uint16_t count_parameters(const char *descriptor);
+
 /**
  * Reads an entire class file.
  * The end of the parsed methods array is marked by a method with a NULL name.
  *
  * @param class_file the open file to read
- * @return the parsed class file, allocated on the heap
+ * @return the parsed class file, allocated on the heap, or NULL if it is malformed
  */
 class_file_t *get_class(FILE *class_file);
 
+/**
+ * Parses a class file that is already in memory, such as a generated one.
+ * The class keeps its own copy of `bytes`, so they can be freed afterwards.
+ *
+ * @param bytes the contents of the class file
+ * @param length the number of bytes in the class file
+ * @return the parsed class file, allocated on the heap, or NULL if it is malformed
+ */
+class_file_t *get_class_from_bytes(const uint8_t *bytes, size_t length);
+
+/**
+ * Parses a class file that is already in memory without copying it,
+ * such as an entry of a JAR, which the JAR keeps until it is closed.
+ * The class borrows `bytes`, so they must stay valid until the class is freed.
+ *
+ * @param bytes the contents of the class file
+ * @param length the number of bytes in the class file
+ * @return the parsed class file, allocated on the heap, or NULL if it is malformed
+ */
+class_file_t *get_class_in_place(const uint8_t *bytes, size_t length);
+
+/**
+ * Decodes a method's bytecode and exception table from its class file,
+ * if they haven't been already.
+ * Parsing a class only records where each method's bytecode is,
+ * so that classes load in proportion to the methods that actually run.
+ *
+ * @param method a method of a parsed class file
+ * @return whether the bytecode was decoded by this call
+ */
+bool read_method_code(method_t *method);
+
 /**
  * Frees the memory used by a parsed class file.
  *
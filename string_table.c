@@ -0,0 +1,122 @@
+#include "string_table.h"
+
+#include <assert.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hash.h"
+
+/**
+ * The number of ints in an interned String object: the header and the index
+ * of its string. A String that isn't interned instead holds -1 - its length,
+ * followed by its characters.
+ */
+const int32_t STRING_OBJECT_SIZE = 2;
+
+/**
+ * The interned strings, in a hash table keyed by their characters that resolves
+ * collisions by linear probing. Each slot holds an index into `strings` plus 1,
+ * or 0 if empty.
+ */
+typedef struct {
+    /** The interned strings, in the order they were interned */
+    interned_string_t **strings;
+    size_t count;
+    /** The hash table over `strings` */
+    size_t *index;
+    /** The number of slots in `index`, which is always 0 or a power of 2 */
+    size_t capacity;
+} string_table_t;
+
+string_table_t string_table = {0};
+
+/** Finds the slot of the hash table that holds a string, or the empty slot for it */
+size_t *find_string_slot(const char *bytes, size_t length) {
+    size_t slot = hash_bytes(bytes, length) & (string_table.capacity - 1);
+    while (string_table.index[slot] != 0) {
+        const interned_string_t *string =
+            string_table.strings[string_table.index[slot] - 1];
+        if (string->length == length && memcmp(string->bytes, bytes, length) == 0) {
+            break;
+        }
+        slot = (slot + 1) & (string_table.capacity - 1);
+    }
+    return &string_table.index[slot];
+}
+
+/** Doubles the size of the hash table, which keeps it at most half full */
+void grow_string_table(void) {
+    free(string_table.index);
+    string_table.capacity = string_table.capacity == 0 ? 64 : 2 * string_table.capacity;
+    string_table.index = calloc(string_table.capacity, sizeof(size_t));
+    assert(string_table.index != NULL && "Failed to allocate string table");
+    for (size_t i = 0; i < string_table.count; i++) {
+        const interned_string_t *string = string_table.strings[i];
+        *find_string_slot(string->bytes, string->length) = i + 1;
+    }
+}
+
+const interned_string_t *intern_string(heap_t *heap, const char *bytes) {
+    if (2 * (string_table.count + 1) > string_table.capacity) {
+        grow_string_table();
+    }
+    size_t length = strlen(bytes);
+    size_t *slot = find_string_slot(bytes, length);
+    if (*slot != 0) {
+        return string_table.strings[*slot - 1];
+    }
+
+    interned_string_t *string = malloc(sizeof(*string));
+    assert(string != NULL && "Failed to allocate string");
+    string->bytes = bytes;
+    string->length = length;
+    string->reference = heap_new_object(heap, STRING_CLASS_ID, STRING_OBJECT_SIZE);
+    assert(string->reference != NULL_REFERENCE && "Out of memory");
+    heap_get(heap, string->reference)[1] = string_table.count;
+    // Interned strings live as long as the VM
+    heap_add_global_roots(heap, &string->reference, 1);
+
+    string_table.strings = realloc(string_table.strings,
+                                   sizeof(interned_string_t *[string_table.count + 1]));
+    assert(string_table.strings != NULL && "Failed to allocate string table");
+    string_table.strings[string_table.count] = string;
+    string_table.count++;
+    *slot = string_table.count;
+    return string;
+}
+
+int32_t new_string(heap_t *heap, const char *bytes) {
+    size_t length = strlen(bytes);
+    assert(length < INT32_MAX - sizeof(int32_t[STRING_OBJECT_SIZE]) &&
+           "String is too long");
+    int32_t characters = (length + sizeof(int32_t) - 1) / sizeof(int32_t);
+    int32_t reference =
+        heap_new_object(heap, STRING_CLASS_ID, STRING_OBJECT_SIZE + characters);
+    assert(reference != NULL_REFERENCE && "Out of memory");
+    int32_t *object = heap_get(heap, reference);
+    object[1] = -1 - (int32_t) length;
+    memcpy(&object[STRING_OBJECT_SIZE], bytes, length);
+    return reference;
+}
+
+const char *get_string(heap_t *heap, int32_t reference, size_t *length) {
+    const int32_t *object = heap_get(heap, reference);
+    assert(object[0] == STRING_CLASS_ID && "Expected a String");
+    if (object[1] < 0) {
+        *length = -1 - object[1];
+        return (const char *) &object[STRING_OBJECT_SIZE];
+    }
+    const interned_string_t *string = string_table.strings[object[1]];
+    *length = string->length;
+    return string->bytes;
+}
+
+void strings_free(void) {
+    for (size_t i = 0; i < string_table.count; i++) {
+        free(string_table.strings[i]);
+    }
+    free(string_table.strings);
+    free(string_table.index);
+    string_table = (string_table_t){0};
+}
@@ -0,0 +1,65 @@
+#ifndef STRING_TABLE_H
+#define STRING_TABLE_H
+
+#include <stddef.h>
+
+#include "heap.h"
+
+/**
+ * The class id in the header of String objects. No class file is loaded for
+ * java/lang/String, so this is not the id of any loaded class.
+ */
+#define STRING_CLASS_ID (-1)
+
+/**
+ * A string constant. Identical string literals, even in different classes,
+ * are interned to the same constant and so share one String object.
+ */
+typedef struct {
+    /**
+     * The string's characters, as modified UTF-8. These are the bytes of the
+     * CONSTANT_Utf8 the string was first loaded from, not a copy.
+     */
+    const char *bytes;
+    /** The number of bytes in `bytes` */
+    size_t length;
+    /** The String object, which holds the index of this constant */
+    int32_t reference;
+} interned_string_t;
+
+/**
+ * Finds the interned string with the given characters,
+ * allocating its String object the first time.
+ *
+ * @param bytes the characters, as a null-terminated modified UTF-8 string,
+ *   which must live as long as the VM runs, e.g. a constant pool entry
+ * @return the interned string, which is never moved or freed until strings_free()
+ */
+const interned_string_t *intern_string(heap_t *heap, const char *bytes);
+
+/**
+ * Allocates a String object that isn't interned, e.g. for an exception's message.
+ * Its characters are copied into the object, so it is garbage collected
+ * like any other object.
+ *
+ * @param bytes the characters, as a null-terminated modified UTF-8 string
+ * @return a reference to the String object
+ */
+int32_t new_string(heap_t *heap, const char *bytes);
+
+/**
+ * Gets the characters of a String object, whether or not it is interned.
+ *
+ * @param reference a reference to a String object
+ * @param length set to the number of bytes in the string
+ * @return the characters, which are only valid until the next allocation
+ */
+const char *get_string(heap_t *heap, int32_t reference, size_t *length);
+
+/**
+ * Frees the interned strings.
+ * Their String objects are freed along with the heap.
+ */
+void strings_free(void);
+
+#endif /* STRING_TABLE_H */
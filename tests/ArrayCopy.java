@@ -0,0 +1,70 @@
+import java.util.Arrays;
+
+public class ArrayCopy {
+    public static void main(String[] args) {
+        int[] a = new int[10];
+        for (int i = 0; i < a.length; i++) {
+            a[i] = i * i;
+        }
+
+        int[] b = new int[6];
+        System.arraycopy(a, 3, b, 1, 5);
+        printArray(b);
+
+        // Overlapping copies behave as if through a temporary array
+        System.arraycopy(a, 0, a, 2, 8);
+        printArray(a);
+        System.arraycopy(a, 4, a, 1, 6);
+        printArray(a);
+
+        Arrays.fill(b, 7);
+        printArray(b);
+        Arrays.fill(b, 2, 4, -1);
+        printArray(b);
+        Arrays.fill(b, 0);
+        printArray(b);
+
+        int[] longer = Arrays.copyOf(a, 12);
+        printArray(longer);
+        int[] shorter = Arrays.copyOf(a, 3);
+        printArray(shorter);
+
+        // Hand-written copy loops
+        int[] c = new int[a.length];
+        for (int i = 0; i < a.length; i++) {
+            c[i] = a[i];
+        }
+        printArray(c);
+        int[] d = new int[4];
+        for (int i = 5; i <= 8; i++) {
+            d[i - 5] = c[i];
+        }
+        printArray(d);
+        // Shifting right within one array re-reads copied elements
+        for (int i = 0; i < 6; i++) {
+            c[i + 1] = c[i];
+        }
+        printArray(c);
+
+        // Ints can't be copied into a reference array, or references into an int array
+        Object[] objects = new Object[4];
+        try {
+            System.arraycopy(a, 0, objects, 0, 4);
+        } catch (ArrayStoreException e) {
+            System.out.println(e.getMessage());
+        }
+        try {
+            System.arraycopy(objects, 0, a, 0, 4);
+        } catch (ArrayStoreException e) {
+            System.out.println(e.getMessage());
+        }
+        // Neither array changed
+        printArray(a);
+    }
+
+    public static void printArray(int[] array) {
+        for (int i = 0; i < array.length; i++) {
+            System.out.println(array[i]);
+        }
+    }
+}
@@ -0,0 +1,247 @@
+import java.util.Arrays;
+
+public class Exceptions {
+    static int finallyCount;
+
+    static int divide(int a, int b) {
+        return a / b;
+    }
+
+    static int remainder(int a, int b) {
+        return a % b;
+    }
+
+    static int safeDivide(int a, int b) {
+        try {
+            return divide(a, b);
+        } catch (ArithmeticException e) {
+            System.out.println(e.getMessage());
+            return -1;
+        }
+    }
+
+    static int element(int[] array, int index) {
+        try {
+            return array[index];
+        } catch (ArrayIndexOutOfBoundsException e) {
+            System.out.println(e.getMessage());
+            return -1;
+        }
+    }
+
+    // Throws from the bottom of a deep recursion
+    static int depth(int n) {
+        if (n == 0) {
+            throw new IllegalStateException("bottom");
+        }
+        return depth(n - 1) + 1;
+    }
+
+    static int withFinally(int n) {
+        int result = 0;
+        try {
+            if (n < 0) {
+                throw new IllegalArgumentException("negative");
+            }
+            result = 100 / n;
+        } catch (IllegalArgumentException e) {
+            result = -1;
+        } finally {
+            finallyCount++;
+        }
+        return result;
+    }
+
+    static void validate(int value) throws ValidationException {
+        if (value % 7 == 0) {
+            throw new ValidationException("multiple of 7", value);
+        }
+    }
+
+    public static void main(String[] args) {
+        System.out.println(safeDivide(84, 4));
+        System.out.println(safeDivide(1, 0));
+        // The one division that overflows doesn't throw
+        System.out.println(divide(Integer.MIN_VALUE, -1));
+        System.out.println(remainder(Integer.MIN_VALUE, -1));
+
+        int[] array = {10, 20, 30};
+        System.out.println(element(array, 2));
+        System.out.println(element(array, 3));
+        System.out.println(element(array, -1));
+
+        // Caught by a handler for a superclass of the exception
+        try {
+            int[] negative = new int[-3];
+            System.out.println(negative.length);
+        } catch (RuntimeException e) {
+            System.out.println(e.getMessage());
+        }
+        try {
+            System.out.println(depth(50));
+        } catch (IllegalStateException e) {
+            System.out.println(e.getMessage());
+        }
+
+        // Null references
+        Link node = new Link(5, null);
+        try {
+            System.out.println(node.next.value);
+        } catch (NullPointerException e) {
+            System.out.println(1);
+        }
+        try {
+            System.out.println(node.next.sum());
+        } catch (NullPointerException e) {
+            System.out.println(2);
+        }
+        int[] missing = null;
+        try {
+            System.out.println(missing.length);
+        } catch (NullPointerException e) {
+            System.out.println(3);
+        }
+
+        // finally runs whether or not the try block throws
+        System.out.println(withFinally(5));
+        System.out.println(withFinally(-5));
+        try {
+            withFinally(0);
+        } catch (ArithmeticException e) {
+            System.out.println(e.getMessage());
+        }
+        System.out.println(finallyCount);
+
+        // A checked exception declared by the program
+        int failures = 0;
+        for (int i = 1; i <= 30; i++) {
+            try {
+                validate(i);
+            } catch (ValidationException e) {
+                failures++;
+                System.out.println(e.value);
+            }
+        }
+        System.out.println(failures);
+
+        // Nested handlers: the innermost one that matches runs
+        try {
+            try {
+                throw new UnsupportedOperationException("inner");
+            } catch (IllegalArgumentException e) {
+                System.out.println(0);
+            }
+        } catch (RuntimeException e) {
+            System.out.println(e.getMessage());
+        }
+        try {
+            throw null;
+        } catch (Exception e) {
+            System.out.println(4);
+        }
+
+        // The library methods the VM implements check their arguments as java does
+        int[] source = {1, 2, 3};
+        int[] target = new int[3];
+        try {
+            System.arraycopy(source, 1, target, 0, 3);
+        } catch (ArrayIndexOutOfBoundsException e) {
+            System.out.println(5);
+        }
+        try {
+            System.arraycopy(source, 0, target, -1, 1);
+        } catch (IndexOutOfBoundsException e) {
+            System.out.println(6);
+        }
+        try {
+            System.arraycopy(null, 0, target, 0, 1);
+        } catch (NullPointerException e) {
+            System.out.println(7);
+        }
+        try {
+            Arrays.fill(missing, 1);
+        } catch (NullPointerException e) {
+            System.out.println(8);
+        }
+        try {
+            Arrays.fill(source, 2, 4, 0);
+        } catch (ArrayIndexOutOfBoundsException e) {
+            System.out.println(e.getMessage());
+        }
+        try {
+            Arrays.fill(source, -1, 2, 0);
+        } catch (ArrayIndexOutOfBoundsException e) {
+            System.out.println(e.getMessage());
+        }
+        try {
+            Arrays.fill(source, 2, 1, 0);
+        } catch (IllegalArgumentException e) {
+            System.out.println(e.getMessage());
+        }
+        try {
+            System.out.println(Arrays.copyOf(missing, 2).length);
+        } catch (NullPointerException e) {
+            System.out.println(9);
+        }
+        try {
+            System.out.println(Arrays.copyOf(source, -2).length);
+        } catch (NegativeArraySizeException e) {
+            System.out.println(e.getMessage());
+        }
+        // The calls that threw didn't change either array
+        System.out.println(source[0] + source[1] + source[2] + target[0]);
+
+        // Arrays too large for the heap throw instead of stopping the VM
+        try {
+            System.out.println(new int[Integer.MAX_VALUE].length);
+        } catch (OutOfMemoryError e) {
+            System.out.println(10);
+        }
+        try {
+            System.out.println(new Link[Integer.MAX_VALUE].length);
+        } catch (OutOfMemoryError e) {
+            System.out.println(11);
+        }
+        try {
+            System.out.println(Arrays.copyOf(source, Integer.MAX_VALUE).length);
+        } catch (OutOfMemoryError e) {
+            System.out.println(12);
+        }
+        // The heap is still usable afterwards
+        System.out.println(Arrays.copyOf(source, 5).length);
+
+        // The non-throwing path of code inside a try block
+        int sum = 0;
+        for (int i = 1; i <= 1000; i++) {
+            try {
+                sum += array[i % 3] / i;
+            } catch (ArithmeticException e) {
+                sum = -1;
+            }
+        }
+        System.out.println(sum);
+    }
+}
+
+class Link {
+    int value;
+    Link next;
+
+    Link(int value, Link next) {
+        this.value = value;
+        this.next = next;
+    }
+
+    int sum() {
+        return next == null ? value : value + next.sum();
+    }
+}
+
+class ValidationException extends Exception {
+    int value;
+
+    ValidationException(String message, int value) {
+        super(message);
+        this.value = value;
+    }
+}
@@ -0,0 +1,123 @@
+public class GarbageCollection {
+    // Survives every collection, so it is moved to the old generation
+    static Cell[] keep;
+
+    // Allocates arrays that die right away
+    static void churn(int count) {
+        for (int i = 0; i < count; i++) {
+            int[] garbage = new int[16];
+            garbage[i & 15] = i;
+        }
+    }
+
+    static int sum(Cell cell) {
+        int sum = 0;
+        while (cell != null) {
+            sum += cell.value;
+            cell = cell.next;
+        }
+        return sum;
+    }
+
+    public static void main(String[] args) {
+        // Short-lived arrays, only one of which is alive at a time
+        int total = 0;
+        for (int i = 0; i < 200000; i++) {
+            int[] array = new int[16];
+            array[i & 15] = i;
+            total += array[i & 15] & 255;
+        }
+        System.out.println(total);
+
+        // A list that stays alive across collections
+        Cell list = null;
+        for (int i = 0; i < 1000; i++) {
+            list = new Cell(i, list);
+        }
+        churn(100000);
+        System.out.println(sum(list));
+        list = null;
+
+        // References from an old array to young objects
+        keep = new Cell[64];
+        for (int round = 0; round < 50; round++) {
+            for (int i = 0; i < 64; i++) {
+                keep[i] = new Cell(round * 64 + i, keep[i]);
+            }
+            churn(3000);
+        }
+        total = 0;
+        for (int i = 0; i < 64; i++) {
+            total += sum(keep[i]);
+        }
+        System.out.println(total);
+
+        // References from an old object's field to young objects
+        Cell anchor = new Cell(0, null);
+        churn(200000);
+        for (int i = 0; i < 500; i++) {
+            anchor.next = new Cell(i, anchor.next);
+            churn(100);
+        }
+        System.out.println(sum(anchor));
+
+        // Large arrays, which are allocated in the old generation
+        int[] large = new int[100000];
+        large[99999] = 7;
+        total = 0;
+        for (int i = 0; i < 40; i++) {
+            int[] huge = new int[262144];
+            huge[i] = i;
+            total += huge[i];
+        }
+        System.out.println(total + large[99999]);
+
+        // Multi-dimensional arrays
+        int[][] grid = new int[300][300];
+        for (int i = 0; i < 300; i++) {
+            for (int j = 0; j < 300; j++) {
+                grid[i][j] = i * j;
+            }
+        }
+        churn(100000);
+        total = 0;
+        for (int i = 0; i < 300; i++) {
+            for (int j = 0; j < 300; j++) {
+                total += grid[i][j];
+            }
+        }
+        System.out.println(total);
+        int[][][] partial = new int[5][6][];
+        churn(100000);
+        System.out.println(partial[4].length);
+        if (partial[4][5] == null) {
+            System.out.println(99);
+        }
+
+        // Exceptions and their messages
+        int caught = 0;
+        String message = null;
+        for (int i = 0; i < 2000; i++) {
+            try {
+                int[] small = new int[3];
+                total = small[i % 5];
+            } catch (ArrayIndexOutOfBoundsException e) {
+                caught++;
+                message = e.getMessage();
+            }
+            churn(50);
+        }
+        System.out.println(caught);
+        System.out.println(message);
+    }
+}
+
+class Cell {
+    int value;
+    Cell next;
+
+    Cell(int value, Cell next) {
+        this.value = value;
+        this.next = next;
+    }
+}
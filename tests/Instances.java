@@ -0,0 +1,114 @@
+public class Instances {
+    public static void main(String[] args) {
+        Point a = new Point(3, 4);
+        Point b = new Point(-1, 7);
+        System.out.println(a.x);
+        System.out.println(a.y);
+        Point c = a.plus(b);
+        System.out.println(c.x);
+        System.out.println(c.y);
+        System.out.println(a.dot(b));
+        a.x = 10;
+        System.out.println(a.manhattan());
+
+        // Fields of a superclass come before the subclass's own
+        Point3D d = new Point3D(1, 2, 3);
+        System.out.println(d.x + d.y + d.z);
+        d.scale(5);
+        System.out.println(d.x);
+        System.out.println(d.z);
+        // A subclass's method overrides its superclass's
+        Point p = d;
+        System.out.println(p.manhattan());
+
+        // Objects can refer to other objects
+        Node list = null;
+        for (int i = 1; i <= 10; i++) {
+            list = new Node(i * i, list);
+        }
+        int sum = 0;
+        for (Node node = list; node != null; node = node.next) {
+            sum += node.value;
+        }
+        System.out.println(sum);
+        System.out.println(Node.length(list));
+        System.out.println(list.next.next.value);
+
+        Point[] points = new Point[5];
+        for (int i = 0; i < points.length; i++) {
+            points[i] = new Point(i, 2 * i);
+        }
+        Point total = new Point(0, 0);
+        for (int i = 0; i < points.length; i++) {
+            total = total.plus(points[i]);
+        }
+        System.out.println(total.x);
+        System.out.println(total.y);
+        if (points[0] != points[1]) {
+            System.out.println(1);
+        }
+        if (points[2] == points[2]) {
+            System.out.println(2);
+        }
+    }
+}
+
+class Point {
+    int x;
+    int y;
+
+    Point(int x, int y) {
+        this.x = x;
+        this.y = y;
+    }
+
+    Point plus(Point other) {
+        return new Point(x + other.x, y + other.y);
+    }
+
+    int dot(Point other) {
+        return x * other.x + y * other.y;
+    }
+
+    int manhattan() {
+        return Math.abs(x) + Math.abs(y);
+    }
+}
+
+class Point3D extends Point {
+    int z;
+
+    Point3D(int x, int y, int z) {
+        super(x, y);
+        this.z = z;
+    }
+
+    void scale(int factor) {
+        x *= factor;
+        y *= factor;
+        z *= factor;
+    }
+
+    int manhattan() {
+        return super.manhattan() + Math.abs(z);
+    }
+}
+
+class Node {
+    int value;
+    Node next;
+
+    Node(int value, Node next) {
+        this.value = value;
+        this.next = next;
+    }
+
+    static int length(Node node) {
+        int length = 0;
+        while (node != null) {
+            length++;
+            node = node.next;
+        }
+        return length;
+    }
+}
@@ -0,0 +1,208 @@
+public class Interfaces {
+    static int sumAll(Sequence sequence) {
+        int sum = 0;
+        sequence.reset();
+        while (sequence.hasNext()) {
+            sum += sequence.next();
+        }
+        return sum;
+    }
+
+    public static void main(String[] args) {
+        Sequence[] sequences = {
+            new Range(1, 10), new SquareNumbers(6), new Countdown(5),
+            new EvenRange(0, 20), new Repeat(7, 3),
+        };
+        for (int i = 0; i < sequences.length; i++) {
+            System.out.println(sumAll(sequences[i]));
+            // Default methods run unless a class overrides them
+            System.out.println(sequences[i].count());
+        }
+
+        // Calls through an interface that extends another
+        Sized[] sized = {new Range(3, 8), new SquareNumbers(4), new Repeat(1, 9)};
+        for (int i = 0; i < sized.length; i++) {
+            System.out.println(sized[i].size());
+            System.out.println(sized[i].next());
+            System.out.println(sized[i].isEmpty() ? 1 : 0);
+        }
+
+        // An interface's static methods and constants
+        System.out.println(Sequence.limit());
+        System.out.println(Sized.LARGE);
+
+        // A class calling a method declared by its interface
+        Range range = new Range(5, 7);
+        System.out.println(range.count());
+        int total = 0;
+        for (int i = 0; i < 100; i++) {
+            Sequence sequence = sequences[i % sequences.length];
+            total += sequence.count() * i;
+        }
+        System.out.println(total);
+    }
+}
+
+interface Sequence {
+    boolean hasNext();
+
+    int next();
+
+    void reset();
+
+    default int count() {
+        reset();
+        int count = 0;
+        while (hasNext()) {
+            next();
+            count++;
+        }
+        reset();
+        return count;
+    }
+
+    static int limit() {
+        return 1000;
+    }
+}
+
+interface Sized extends Sequence {
+    int LARGE = 100;
+
+    int size();
+
+    default boolean isEmpty() {
+        return size() == 0;
+    }
+
+    default int count() {
+        return size();
+    }
+}
+
+class Range implements Sized {
+    int start;
+    int end;
+    int current;
+
+    Range(int start, int end) {
+        this.start = start;
+        this.end = end;
+        this.current = start;
+    }
+
+    public boolean hasNext() {
+        return current < end;
+    }
+
+    public int next() {
+        return current++;
+    }
+
+    public void reset() {
+        current = start;
+    }
+
+    public int size() {
+        return end - start;
+    }
+}
+
+class EvenRange extends Range {
+    EvenRange(int start, int end) {
+        super(start, end);
+    }
+
+    public int next() {
+        int value = current;
+        current += 2;
+        return value;
+    }
+
+    public int size() {
+        return (end - start + 1) / 2;
+    }
+}
+
+class SquareNumbers implements Sized {
+    int n;
+    int i;
+
+    SquareNumbers(int n) {
+        this.n = n;
+    }
+
+    public boolean hasNext() {
+        return i < n;
+    }
+
+    public int next() {
+        i++;
+        return i * i;
+    }
+
+    public void reset() {
+        i = 0;
+    }
+
+    public int size() {
+        return n;
+    }
+
+    public boolean isEmpty() {
+        return n <= 0;
+    }
+}
+
+class Countdown implements Sequence {
+    int from;
+    int current;
+
+    Countdown(int from) {
+        this.from = from;
+    }
+
+    public boolean hasNext() {
+        return current > 0;
+    }
+
+    public int next() {
+        return current--;
+    }
+
+    public void reset() {
+        current = from;
+    }
+}
+
+class Repeat implements Sized {
+    int value;
+    int times;
+    int done;
+
+    Repeat(int value, int times) {
+        this.value = value;
+        this.times = times;
+    }
+
+    public boolean hasNext() {
+        return done < times;
+    }
+
+    public int next() {
+        done++;
+        return value;
+    }
+
+    public void reset() {
+        done = 0;
+    }
+
+    public int size() {
+        return times;
+    }
+
+    public int count() {
+        return -times;
+    }
+}
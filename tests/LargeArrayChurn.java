@@ -0,0 +1,22 @@
+public class LargeArrayChurn {
+    public static void main(String[] args) {
+        // Small arrays that stay alive, so young collections promote them
+        int[][] keep = new int[20000][];
+        int total = 0;
+        for (int i = 0; i < keep.length; i++) {
+            keep[i] = new int[4];
+            keep[i][i & 3] = i;
+
+            // Arrays large enough to get mappings of their own, which die right away
+            if ((i & 63) == 0) {
+                int[] large = new int[65536];
+                large[i & 65535] = i;
+                total += large[i & 65535] & 1;
+            }
+        }
+        for (int i = 0; i < keep.length; i++) {
+            total += keep[i][i & 3];
+        }
+        System.out.println(total);
+    }
+}
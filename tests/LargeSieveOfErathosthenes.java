@@ -0,0 +1,23 @@
+public class LargeSieveOfErathosthenes {
+    public static void main(String[] args) {
+        // count the primes up until 2^24 in a 64 MB array,
+        // which needs far more pages than the TLB has entries for
+        int num = 1 << 24;
+
+        int[] composite = new int[num];
+        for (int i = 2; i * i < num; i++) {
+            if (composite[i] == 0) {
+                for (int j = i * i; j < num; j = j + i) {
+                    composite[j] = 1;
+                }
+            }
+        }
+        int count = 0;
+        for (int i = 2; i < num; i++) {
+            if (composite[i] == 0) {
+                count++;
+            }
+        }
+        System.out.println(count);
+    }
+}
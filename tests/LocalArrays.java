@@ -0,0 +1,52 @@
+public class LocalArrays {
+    static int[] kept;
+
+    // The array never leaves the method, so it is allocated in the frame
+    static int sumOfDigits(int n) {
+        int[] digits = new int[10];
+        int count = 0;
+        while (n > 0 && count < digits.length) {
+            digits[count] = n % 10;
+            n /= 10;
+            count++;
+        }
+        int sum = 0;
+        for (int i = 0; i < count; i++) {
+            sum += digits[i];
+        }
+        return sum;
+    }
+
+    // Each frame of the recursion has its own array
+    static int triangle(int n) {
+        int[] pair = {n, 0};
+        if (n > 0) {
+            int below = triangle(n - 1);
+            pair[1] = below;
+        }
+        return pair[0] + pair[1];
+    }
+
+    // The array escapes to a static field, so it is allocated in the heap
+    static int keep(int n) {
+        int[] array = {n, n + 1};
+        kept = array;
+        return array[1];
+    }
+
+    public static void main(String[] args) {
+        int total = 0;
+        int[] counter = {0};
+        for (int i = 0; i < 100000; i++) {
+            int[] values = {i, i * 2, 7};
+            total += values[0] + values[1] + values[2] + values.length;
+            // Reads the previous array while allocating the next one
+            counter = new int[] {counter[0] + 1};
+            total += sumOfDigits(i) + keep(i);
+        }
+        System.out.println(total);
+        System.out.println(counter[0]);
+        System.out.println(kept[0]);
+        System.out.println(triangle(100));
+    }
+}
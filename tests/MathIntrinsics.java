@@ -0,0 +1,31 @@
+public class MathIntrinsics {
+    public static void main(String[] args) {
+        int[] values = {0, 1, -1, 5, -5, 12, 96, 1 << 30, -2147483648, 2147483647};
+        for (int i = 0; i < values.length; i++) {
+            int x = values[i];
+            System.out.println(Math.abs(x));
+            System.out.println(Integer.bitCount(x));
+            System.out.println(Integer.numberOfTrailingZeros(x));
+            System.out.println(Integer.numberOfLeadingZeros(x));
+            for (int j = 0; j < values.length; j++) {
+                System.out.println(Math.min(x, values[j]) + 3 * Math.max(x, values[j]));
+            }
+        }
+
+        // Manhattan distances between points on a small grid
+        int total = 0;
+        for (int a = -3; a <= 3; a++) {
+            for (int b = -3; b <= 3; b++) {
+                total += Math.abs(a - b) + Math.abs(a + b);
+            }
+        }
+        System.out.println(total);
+
+        // Population count of every subset of 10 bits
+        int bits = 0;
+        for (int mask = 0; mask < 1024; mask++) {
+            bits += Integer.bitCount(mask);
+        }
+        System.out.println(bits);
+    }
+}
@@ -0,0 +1,97 @@
+public class MultiArrays {
+    public static void main(String[] args) {
+        System.out.println(latticePaths(10, 10));
+
+        int[][] triangle = pascal(12);
+        for (int i = 0; i < triangle.length; i++) {
+            System.out.println(triangle[i][i / 2]);
+        }
+
+        int[][][] cube = new int[3][4][5];
+        for (int i = 0; i < cube.length; i++) {
+            for (int j = 0; j < cube[i].length; j++) {
+                for (int k = 0; k < cube[i][j].length; k++) {
+                    cube[i][j][k] = i * 100 + j * 10 + k;
+                }
+            }
+        }
+        int sum = 0;
+        for (int i = 0; i < 3; i++) {
+            for (int j = 0; j < 4; j++) {
+                for (int k = 0; k < 5; k++) {
+                    sum += cube[i][j][k];
+                }
+            }
+        }
+        System.out.println(sum);
+        System.out.println(sumPlane(cube, 2));
+
+        // Rows of a rectangular array can still be replaced and shared
+        int[][] grid = new int[4][6];
+        grid[3][5] = 35;
+        int[] row = grid[0];
+        grid[0] = grid[3];
+        grid[3] = row;
+        grid[1] = new int[2];
+        System.out.println(grid.length);
+        System.out.println(grid[0][5]);
+        System.out.println(grid[1].length);
+        System.out.println(grid[3].length);
+
+        int[][] empty = new int[0][7];
+        System.out.println(empty.length);
+
+        // Too large to allocate, which is noticed before any row is allocated
+        try {
+            int[][] huge = new int[Integer.MAX_VALUE][2];
+            System.out.println(huge.length);
+        } catch (OutOfMemoryError e) {
+            System.out.println(-1);
+        }
+        try {
+            int[][] negative = new int[3][-1];
+            System.out.println(negative.length);
+        } catch (NegativeArraySizeException e) {
+            System.out.println(-2);
+        }
+    }
+
+    public static int latticePaths(int width, int height) {
+        int[][] paths = new int[height + 1][width + 1];
+        for (int i = 0; i <= height; i++) {
+            paths[i][0] = 1;
+        }
+        for (int j = 0; j <= width; j++) {
+            paths[0][j] = 1;
+        }
+        for (int i = 1; i <= height; i++) {
+            for (int j = 1; j <= width; j++) {
+                paths[i][j] = paths[i - 1][j] + paths[i][j - 1];
+            }
+        }
+        return paths[height][width];
+    }
+
+    public static int sumPlane(int[][][] cube, int i) {
+        int sum = 0;
+        for (int j = 0; j < cube[i].length; j++) {
+            for (int k = 0; k < cube[i][j].length; k++) {
+                sum += cube[i][j][k];
+            }
+        }
+        return sum;
+    }
+
+    public static int[][] pascal(int n) {
+        int[][] rows = new int[n][];
+        for (int i = 0; i < n; i++) {
+            rows[i] = new int[i + 1];
+            rows[i][0] = 1;
+            rows[i][i] = 1;
+            for (int j = 1; j < i; j++) {
+                rows[i][j] = rows[i - 1][j - 1] + rows[i - 1][j];
+            }
+        }
+        return rows;
+    }
+}
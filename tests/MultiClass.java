@@ -0,0 +1,51 @@
+public class MultiClass {
+    public static void main(String[] args) {
+        for (int i = 0; i < 10; i++) {
+            System.out.println(Fibonacci.fib(i));
+        }
+        System.out.println(Geometry.area(3, 4));
+        // Inherited static methods are called through the subclass
+        System.out.println(Square.perimeter(5, 5));
+        System.out.println(Square.area(6));
+        System.out.println(Counter.countDown(12));
+    }
+
+    public static int square(int n) {
+        return n * n;
+    }
+}
+
+class Fibonacci {
+    static int fib(int n) {
+        if (n < 2) {
+            return n;
+        }
+        return fib(n - 1) + fib(n - 2);
+    }
+}
+
+class Geometry {
+    static int area(int width, int height) {
+        return width * height;
+    }
+
+    static int perimeter(int width, int height) {
+        return 2 * (width + height);
+    }
+}
+
+class Square extends Geometry {
+    static int area(int side) {
+        // Calls back into the main class
+        return MultiClass.square(side);
+    }
+}
+
+class Counter {
+    static int countDown(int n) {
+        if (n == 0) {
+            return 0;
+        }
+        return 1 + Counter.countDown(n - 1);
+    }
+}
@@ -0,0 +1,72 @@
+public class StaticFields {
+    static final int MAX = 46;
+    static int calls;
+    static int[] memo = new int[MAX];
+    static int seed = 17;
+
+    static int fib(int n) {
+        calls++;
+        if (n < 2) {
+            return n;
+        }
+        if (memo[n] != 0) {
+            return memo[n];
+        }
+        int result = fib(n - 1) + fib(n - 2);
+        memo[n] = result;
+        return result;
+    }
+
+    static int next() {
+        seed = seed * 1103515245 + 12345;
+        return (seed >>> 16) & 0x7fff;
+    }
+
+    public static void main(String[] args) {
+        System.out.println(fib(MAX - 1));
+        System.out.println(calls);
+        // The second time, the answer is already in the memo table
+        calls = 0;
+        System.out.println(fib(MAX - 1));
+        System.out.println(calls);
+        for (int i = 0; i < 5; i++) {
+            System.out.println(next());
+        }
+
+        // Other classes' statics are initialized the first time they are used
+        System.out.println(Tally.total);
+        for (int i = 1; i <= 10; i++) {
+            Tally.add(i);
+        }
+        System.out.println(Tally.total);
+        System.out.println(Tally.count);
+        // A static inherited from a superclass is the same variable
+        SubTally.total = 7;
+        System.out.println(Tally.total);
+        System.out.println(Squares.table[12]);
+    }
+}
+
+class Tally {
+    static int total = 100;
+    static int count;
+
+    static void add(int n) {
+        total += n;
+        count++;
+    }
+}
+
+class SubTally extends Tally {
+}
+
+class Squares {
+    static int[] table;
+
+    static {
+        table = new int[20];
+        for (int i = 0; i < table.length; i++) {
+            table[i] = i * i;
+        }
+    }
+}
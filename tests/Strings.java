@@ -0,0 +1,51 @@
+public class Strings {
+    static String greeting = "Hello, world!";
+
+    static String pick(int n) {
+        switch (n) {
+            case 0:
+                return "zero";
+            case 1:
+                return "one";
+            case 2:
+                return "two";
+            default:
+                return "many";
+        }
+    }
+
+    public static void main(String[] args) {
+        System.out.println(greeting);
+        System.out.println("");
+        System.out.println("Unicode: héllo wörld ✓");
+        for (int i = 0; i < 5; i++) {
+            System.out.println(pick(i));
+        }
+
+        // Identical literals are the same object, even in different classes
+        String a = "shared";
+        String b = "shared";
+        System.out.println(a == b ? 1 : 0);
+        System.out.println(a == Labels.shared() ? 1 : 0);
+        System.out.println(a == Labels.other() ? 1 : 0);
+        System.out.println(pick(7) == "many" ? 1 : 0);
+
+        String[] words = {"the", "quick", "brown", "fox", null};
+        for (int i = 0; i < words.length; i++) {
+            System.out.println(words[i]);
+        }
+        System.out.println(Labels.title);
+    }
+}
+
+class Labels {
+    static String title = "Labels";
+
+    static String shared() {
+        return "shared";
+    }
+
+    static String other() {
+        return "not shared";
+    }
+}
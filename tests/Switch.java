@@ -0,0 +1,86 @@
+public class Switch {
+    public static void main(String[] args) {
+        for (int i = -2; i <= 8; i++) {
+            System.out.println(dense(i));
+        }
+        int[] keys = {-1000000, -1000, -1, 0, 7, 8, 100, 4096, 100000, 2147483647};
+        for (int i = 0; i < keys.length; i++) {
+            System.out.println(sparse(keys[i]));
+        }
+        System.out.println(sparse(-2147483648));
+        for (int i = 0; i < 6; i++) {
+            System.out.println(fallthrough(i));
+        }
+        System.out.println(countWords(1234501234));
+    }
+
+    public static int dense(int n) {
+        switch (n) {
+            case 0: return 10;
+            case 1: return 11;
+            case 2: return 12;
+            case 3: return 13;
+            case 5: return 15;
+            case 6: return 16;
+            default: return -1;
+        }
+    }
+
+    public static int sparse(int n) {
+        switch (n) {
+            case -1000000: return 1;
+            case -1000: return 2;
+            case 7: return 3;
+            case 100: return 4;
+            case 4096: return 5;
+            case 100000: return 6;
+            case 2147483647: return 7;
+            default: return 0;
+        }
+    }
+
+    public static int fallthrough(int n) {
+        int total = 0;
+        switch (n) {
+            case 1:
+                total += 1;
+            case 2:
+                total += 2;
+                break;
+            case 3:
+                total += 3;
+            case 4:
+                total += 4;
+            default:
+                total += 100;
+        }
+        return total;
+    }
+
+    /**
+     * A small state machine over the decimal digits of n:
+     * counts the maximal runs of non-zero digits.
+     */
+    public static int countWords(int n) {
+        int state = 0;
+        int words = 0;
+        while (n > 0) {
+            int digit = n % 10;
+            n /= 10;
+            switch (state) {
+                case 0:
+                    if (digit != 0) {
+                        words++;
+                        state = 1;
+                    }
+                    break;
+                case 1:
+                    if (digit == 0) {
+                        state = 0;
+                    }
+                    break;
+            }
+        }
+        return words;
+    }
+}
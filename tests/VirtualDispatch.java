@@ -0,0 +1,148 @@
+public class VirtualDispatch {
+    static int totalArea(Shape[] shapes, int count) {
+        int total = 0;
+        for (int i = 0; i < count; i++) {
+            total += shapes[i].area();
+        }
+        return total;
+    }
+
+    public static void main(String[] args) {
+        Shape[] shapes = {
+            new SquareShape(3), new Rectangle(2, 5), new Triangle(4, 6),
+            new Cube(2), new Rectangle(7, 1), new SquareShape(10), new Trapezoid(2, 4, 3),
+            new Circle(5),
+        };
+
+        // The call site in totalArea() sees more and more classes
+        for (int count = 1; count <= shapes.length; count++) {
+            System.out.println(totalArea(shapes, count));
+        }
+        for (int i = 0; i < shapes.length; i++) {
+            System.out.println(shapes[i].sides());
+            System.out.println(shapes[i].describe());
+        }
+
+        // A monomorphic call site
+        SquareShape square = new SquareShape(1);
+        int sum = 0;
+        for (int i = 0; i < 1000; i++) {
+            square.grow();
+            sum += square.area();
+        }
+        System.out.println(sum);
+        System.out.println(square.side);
+    }
+}
+
+abstract class Shape {
+    abstract int area();
+
+    int sides() {
+        return 0;
+    }
+
+    // Calls the subclass's methods
+    int describe() {
+        return 1000 * sides() + area();
+    }
+}
+
+class Rectangle extends Shape {
+    int width;
+    int height;
+
+    Rectangle(int width, int height) {
+        this.width = width;
+        this.height = height;
+    }
+
+    int area() {
+        return width * height;
+    }
+
+    int sides() {
+        return 4;
+    }
+}
+
+class SquareShape extends Rectangle {
+    int side;
+
+    SquareShape(int side) {
+        super(side, side);
+        this.side = side;
+    }
+
+    void grow() {
+        side++;
+        width = side;
+        height = side;
+    }
+}
+
+class Cube extends SquareShape {
+    Cube(int side) {
+        super(side);
+    }
+
+    // Surface area
+    int area() {
+        return 6 * super.area();
+    }
+
+    int sides() {
+        return 6 * super.sides();
+    }
+}
+
+class Triangle extends Shape {
+    int base;
+    int height;
+
+    Triangle(int base, int height) {
+        this.base = base;
+        this.height = height;
+    }
+
+    int area() {
+        return base * height / 2;
+    }
+
+    int sides() {
+        return 3;
+    }
+}
+
+class Trapezoid extends Shape {
+    int top;
+    int bottom;
+    int height;
+
+    Trapezoid(int top, int bottom, int height) {
+        this.top = top;
+        this.bottom = bottom;
+        this.height = height;
+    }
+
+    int area() {
+        return (top + bottom) * height / 2;
+    }
+
+    int sides() {
+        return 4;
+    }
+}
+
+class Circle extends Shape {
+    int radius;
+
+    Circle(int radius) {
+        this.radius = radius;
+    }
+
+    // Rounded down
+    int area() {
+        return 314 * radius * radius / 100;
+    }
+}
@@ -0,0 +1,79 @@
+/*
+ * Allocates from several threads attached to one heap at the same time.
+ * Each thread keeps taking more references from the heap's reference table
+ * while the other threads store through the table.
+ * The young generation is large enough that nothing is collected.
+ */
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdlib.h>
+
+#include "../gc.h"
+
+#define THREADS 4
+#define ARRAYS_PER_THREAD 50000
+#define ARRAY_LENGTH 3
+
+typedef struct {
+    heap_t *heap;
+    /** The thread's number, which its arrays' elements are computed from */
+    int32_t number;
+    int32_t refs[ARRAYS_PER_THREAD];
+} allocator_t;
+
+int32_t element(int32_t number, int32_t array, int32_t index) {
+    return number * ARRAYS_PER_THREAD * ARRAY_LENGTH + array * ARRAY_LENGTH + index;
+}
+
+void *allocate_arrays(void *arg) {
+    allocator_t *allocator = arg;
+    heap_t *heap = allocator->heap;
+    heap_attach_thread(heap);
+    for (int32_t i = 0; i < ARRAYS_PER_THREAD; i++) {
+        int32_t ref = heap_new_array(heap, ARRAY_LENGTH);
+        int32_t *array = heap_get(heap, ref);
+        for (int32_t j = 0; j < ARRAY_LENGTH; j++) {
+            array[j + 1] = element(allocator->number, i, j);
+        }
+        allocator->refs[i] = ref;
+    }
+    heap_detach_thread(heap);
+    return NULL;
+}
+
+int main(void) {
+    heap_options_t options = DEFAULT_HEAP_OPTIONS;
+    options.young_size = 32 << 20;
+    options.max_size = 128 << 20;
+    heap_t *heap = heap_init(&options);
+
+    allocator_t *allocators = malloc(sizeof(allocator_t[THREADS]));
+    assert(allocators != NULL && "Failed to allocate threads");
+    pthread_t threads[THREADS];
+    for (int32_t i = 0; i < THREADS; i++) {
+        allocators[i].heap = heap;
+        allocators[i].number = i;
+        int error = pthread_create(&threads[i], NULL, allocate_arrays, &allocators[i]);
+        assert(error == 0 && "Failed to start thread");
+    }
+    for (int32_t i = 0; i < THREADS; i++) {
+        int error = pthread_join(threads[i], NULL);
+        assert(error == 0 && "Failed to join thread");
+    }
+
+    // Every array kept its own reference and the elements its thread stored
+    bool passed = heap->young_collections == 0 && heap->full_collections == 0;
+    for (int32_t i = 0; i < THREADS; i++) {
+        for (int32_t j = 0; j < ARRAYS_PER_THREAD; j++) {
+            int32_t *array = heap_get(heap, allocators[i].refs[j]);
+            passed = passed && array[0] == ARRAY_LENGTH;
+            for (int32_t k = 0; k < ARRAY_LENGTH; k++) {
+                passed = passed && array[k + 1] == element(i, j, k);
+            }
+        }
+    }
+    free(allocators);
+    heap_free(heap);
+    return passed ? 0 : 1;
+}